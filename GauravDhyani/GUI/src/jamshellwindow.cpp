@@ -9,6 +9,7 @@
 #include <QPushButton>
 #include <QPlainTextEdit>
 #include <QLineEdit>
+#include <QMap>
 
 // --- ANSI escape code stripper ---
 static QString stripAnsi(const QString &in) {
@@ -62,6 +63,7 @@ JamShellWindow::JamShellWindow(QWidget *parent)
     // Embedded REPL process
     mainProcess = new QProcess(this);
     mainProcess->setProgram("./jam");
+    mainProcess->setArguments({"-s"}); // Batch mode: no readline, banner or prompt
     mainProcess->setProcessChannelMode(QProcess::MergedChannels);
     connect(mainProcess, &QProcess::readyReadStandardOutput, this, &JamShellWindow::readProcessOutput);
     connect(mainProcess, &QProcess::readyReadStandardError,  this, &JamShellWindow::readProcessError);
@@ -98,13 +100,29 @@ JamShellWindow::~JamShellWindow()
 }
 
 // --- Create menus helper ---
+// Menus are generated from the shell's builtin registry (`jam --builtins`),
+// so a builtin added to the shell shows up here without GUI changes.
 void JamShellWindow::createMenus()
 {
-    addCommandMenu("General", {"help", "exit", "history", "alias name=command"});
-    addCommandMenu("File Operations", {"jcreate <filename>", "jsave <filename>", "jedit <filename>", "jmodify <filename>", "jrename <old> <new>", "jexecute <filename>"});
-    addCommandMenu("Search & Navigation", {"sgown <term>", "locate <term>", "cd <path>"});
-    addCommandMenu("Scheduling", {"jschedule <file> [priority]", "jschedulexecute", "jscheduleview", "jschedulesave <filename>", "jschedulecancel <task_id>", "jschedulemodify <id> <cmd>"});
-    addCommandMenu("Jambo", {"jambo", "jambo -l <filename>", "jambo -p <filename>", "jambo -s <filename>"});
+    QProcess registry;
+    registry.start("./jam", {"--builtins"});
+    if (!registry.waitForFinished(3000) || registry.exitCode() != 0) {
+        outputPane->appendPlainText("[ERROR] Could not read builtin list from ./jam --builtins");
+        return;
+    }
+
+    QStringList categories;
+    QMap<QString, QStringList> commands;
+    const QStringList lines = QString::fromUtf8(registry.readAllStandardOutput()).split('\n', Qt::SkipEmptyParts);
+    for (const QString &line : lines) {
+        const QStringList fields = line.split('\t');
+        if (fields.size() < 2) continue;
+        if (!categories.contains(fields[0])) categories << fields[0];
+        commands[fields[0]] << fields[1];
+    }
+    for (const QString &category : categories) {
+        addCommandMenu(category, commands[category]);
+    }
 }
 
 // --- Add menu with commands ---
@@ -0,0 +1,91 @@
+/**
+ * @file dispatch.cpp
+ * @brief Microbenchmark of builtin lookup in the REPL.
+ *
+ * Times find_builtin() (the registry's compile-time perfect hash) against a
+ * strcmp chain over the same names in registry order, which is how the REPL
+ * dispatched before the registry existed. The names looked up are every
+ * builtin plus common external commands, so misses are measured too.
+ *
+ * Built against the shell's sources, with the shell's main() renamed:
+ *
+ *   g++ -std=c++17 -O2 -Dmain=jam_main dispatch.cpp $(find ../src -name '*.cpp' ! -name jamgen.cpp) \
+ *       -o dispatch -I../JAM -I../src -I../src/include -L../JAM -ljam -lcurl -lreadline -pthread
+ *   ./dispatch [lookups]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include "builtins.h"
+
+#undef main // Renamed for the shell's sources only
+
+// -------------------------
+// Lookups
+// -------------------------
+
+static const char *external_commands[] = {"ls", "grep", "cat", "make", "git", "./run", "python3", "vim"};
+
+/**
+ * @brief Finds a builtin by comparing the name against every entry in turn.
+ */
+static const Builtin *find_builtin_strcmp(const Builtin *list, size_t count, const char *name)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (strcmp(name, list[i].name.data()) == 0)
+            return &list[i];
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Runs `lookups` lookups over `names` and returns nanoseconds per lookup.
+ */
+template <typename Lookup>
+static double time_lookups(const std::vector<const char *> &names, size_t lookups, size_t &found, Lookup lookup)
+{
+    found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; ++i)
+        found += lookup(names[i % names.size()]) != nullptr;
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t lookups = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000000;
+    if (lookups == 0)
+    {
+        fprintf(stderr, "Usage: dispatch [lookups]\n");
+        return 2;
+    }
+
+    size_t count;
+    const Builtin *list = builtin_list(count);
+    std::vector<const char *> names;
+    for (size_t i = 0; i < count; ++i)
+        names.push_back(list[i].name.data());
+    for (const char *name : external_commands)
+        names.push_back(name);
+
+    size_t found_chain, found_hash;
+    double chain_ns = time_lookups(names, lookups, found_chain,
+                                   [&](const char *name) { return find_builtin_strcmp(list, count, name); });
+    double hash_ns = time_lookups(names, lookups, found_hash,
+                                  [](const char *name) { return find_builtin(std::string_view(name)); });
+    if (found_chain != found_hash)
+    {
+        fprintf(stderr, "dispatch: lookups disagree (%zu vs %zu hits)\n", found_chain, found_hash);
+        return 1;
+    }
+
+    printf("%zu lookups over %zu builtins and %zu other names\n", lookups, count,
+           sizeof(external_commands) / sizeof(external_commands[0]));
+    printf("  strcmp chain  %6.1f ns/lookup\n", chain_ns);
+    printf("  perfect hash  %6.1f ns/lookup\n", hash_ns);
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file spawn.cpp
+ * @brief Process launch latency against the launching process's size.
+ *
+ * Starts /bin/true repeatedly with fork_command() + execv (the fork
+ * fallback) and with spawn_command() (posix_spawn), after growing this
+ * process's RSS with touched 4 KiB pages. fork() copies the page tables, so
+ * its cost grows with RSS; posix_spawn() shares the address space until exec.
+ *
+ *   g++ -std=c++17 -O2 spawn.cpp ../src/procspawn.cpp -o spawn -I../src
+ *   ./spawn [-n runs] [rss MiB ...]       # default: -n 200 0 256 1024 4096
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "procspawn.h"
+
+// -------------------------
+// Measurement
+// -------------------------
+
+/**
+ * @brief Grows the RSS by `mib` MiB of touched anonymous pages.
+ *
+ * @return false if the memory could not be mapped.
+ */
+static bool grow_rss(size_t mib)
+{
+    if (mib == 0)
+        return true;
+    size_t bytes = mib << 20;
+    char *block = static_cast<char *>(mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (block == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+    for (size_t offset = 0; offset < bytes; offset += 4096)
+        block[offset] = 1;
+    return true; // Kept mapped for the rest of the run
+}
+
+/**
+ * @brief Starts /bin/true `runs` times and returns the mean microseconds per launch and wait.
+ */
+static double time_launches(int runs, bool use_spawn)
+{
+    static char true_path[] = "/bin/true";
+    char *argv[] = {true_path, nullptr};
+    SpawnOptions options;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i)
+    {
+        pid_t pid = use_spawn ? spawn_command(true_path, argv, options) : fork_command(options, [&]() {
+            execv(true_path, argv);
+            return 127;
+        });
+        if (pid < 0 || waitpid(pid, nullptr, 0) < 0)
+            return -1;
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 200;
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else
+            sizes.push_back(strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes.empty())
+        sizes = {0, 256, 1024, 4096};
+    if (runs < 1)
+    {
+        fprintf(stderr, "Usage: spawn [-n runs] [rss MiB ...]\n");
+        return 2;
+    }
+
+    printf("Launch + wait of /bin/true, mean of %d runs\n", runs);
+    printf("%10s  %12s  %12s\n", "RSS", "fork+exec", "posix_spawn");
+    size_t grown = 0;
+    for (size_t mib : sizes)
+    {
+        if (mib > grown)
+        {
+            if (!grow_rss(mib - grown))
+                return 1;
+            grown = mib;
+        }
+        double fork_us = time_launches(runs, false);
+        double spawn_us = time_launches(runs, true);
+        if (fork_us < 0 || spawn_us < 0)
+        {
+            perror("launch");
+            return 1;
+        }
+        printf("%6zu MiB  %9.0f us  %9.0f us\n", grown, fork_us, spawn_us);
+    }
+    return 0;
+}
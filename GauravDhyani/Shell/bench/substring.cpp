@@ -0,0 +1,152 @@
+/**
+ * @file substring.cpp
+ * @brief Single-thread throughput of sgown's substring scan.
+ *
+ * Builds a text corpus in memory with a needle at three densities and finds
+ * every matching line three ways, best of 5 runs each:
+ *
+ *   per line        std::string::find on a copy of each line (sgown before mmap scanning)
+ *   memmem          glibc memmem over the whole buffer, then the hit's line
+ *   find_substring  the SSE2 first/last-byte filter sgown uses now
+ *
+ * File reading is left out; time the end-to-end search over real files with
+ * `jbench -n 5 'sgown -j 1 <term>'`.
+ *
+ *   g++ -std=c++17 -O2 substring.cpp ../src/search.cpp ../src/matcher.cpp ../src/searchindex.cpp \
+ *       ../src/walk.cpp ../src/wildcard.cpp -o substring -I../src -pthread
+ *   ./substring [corpus MiB]              # default 233
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include "search.h"
+
+// -------------------------
+// Corpus
+// -------------------------
+
+static const char *words[] = {"the", "shell", "reads", "a", "line", "and", "runs", "each", "command",
+                              "with", "its", "own", "pipes", "while", "jobs", "wait", "for", "input"};
+
+/**
+ * @brief Generates `bytes` of text lines; every `every`-th line gets `needle`.
+ */
+static std::string make_corpus(size_t bytes, const char *needle, size_t every)
+{
+    std::mt19937 rng(7);
+    std::string text;
+    text.reserve(bytes + 256);
+    for (size_t line = 1; text.size() < bytes; ++line)
+    {
+        size_t count = 4 + rng() % 12;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i)
+                text.push_back(' ');
+            text += words[rng() % (sizeof(words) / sizeof(words[0]))];
+        }
+        if (line % every == 0)
+            text += std::string(" ") + needle;
+        text.push_back('\n');
+    }
+    return text;
+}
+
+// -------------------------
+// Scanners
+// -------------------------
+
+// Each returns the number of matching lines.
+
+static size_t scan_per_line(const std::string &text, const std::string &needle)
+{
+    size_t hits = 0;
+    for (size_t start = 0; start < text.size();)
+    {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(start, end - start);
+        hits += line.find(needle) != std::string::npos;
+        start = end + 1;
+    }
+    return hits;
+}
+
+template <typename Find>
+static size_t scan_buffer(const std::string &text, const std::string &needle, Find find)
+{
+    size_t hits = 0;
+    const char *pos = text.data(), *end = text.data() + text.size();
+    while (pos < end)
+    {
+        const char *hit = find(pos, end - pos, needle.data(), needle.size());
+        if (!hit)
+            break;
+        hits++;
+        const char *eol = static_cast<const char *>(memchr(hit, '\n', end - hit));
+        pos = eol ? eol + 1 : end;
+    }
+    return hits;
+}
+
+static const char *find_memmem(const char *haystack, size_t size, const char *needle, size_t length)
+{
+    return static_cast<const char *>(memmem(haystack, size, needle, length));
+}
+
+/**
+ * @brief Runs a scan 5 times and returns the best throughput in GB/s.
+ */
+template <typename Scan>
+static double best_gbps(const std::string &text, size_t &hits, Scan scan)
+{
+    double best = 0;
+    for (int run = 0; run < 5; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        hits = scan();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, text.size() / seconds / 1e9);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t mib = argc > 1 ? strtoull(argv[1], nullptr, 10) : 233;
+    if (mib == 0)
+    {
+        fprintf(stderr, "Usage: substring [corpus MiB]\n");
+        return 2;
+    }
+
+    const struct { const char *needle; size_t every; } cases[] = {
+        {"rare_needle", 65536}, {"some_needle", 512}, {"many_needle", 20}};
+    printf("%-24s %10s %12s %12s %16s\n", "corpus", "hits", "per line", "memmem", "find_substring");
+    for (const auto &c : cases)
+    {
+        std::string text = make_corpus(mib << 20, c.needle, c.every);
+        std::string needle = c.needle;
+        size_t line_hits, memmem_hits, sse_hits;
+        double line_gbps = best_gbps(text, line_hits, [&]() { return scan_per_line(text, needle); });
+        double memmem_gbps = best_gbps(text, memmem_hits, [&]() { return scan_buffer(text, needle, find_memmem); });
+        double sse_gbps = best_gbps(text, sse_hits, [&]() { return scan_buffer(text, needle, find_substring); });
+        if (line_hits != memmem_hits || line_hits != sse_hits)
+        {
+            fprintf(stderr, "substring: scans disagree on %s (%zu, %zu, %zu hits)\n", c.needle, line_hits,
+                    memmem_hits, sse_hits);
+            return 1;
+        }
+
+        char label[64];
+        snprintf(label, sizeof(label), "%zu MiB, 1/%zu lines", mib, c.every);
+        printf("%-24s %10zu %7.2f GB/s %7.2f GB/s %11.2f GB/s\n", label, line_hits, line_gbps, memmem_gbps,
+               sse_gbps);
+    }
+    return 0;
+}
@@ -0,0 +1,414 @@
+#include "bench.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include "./include/json.hpp"
+#include "builtins.h"
+#include "shell.h"
+#include "timing.h"
+
+using json = nlohmann::json;
+
+#define BENCH_OUTLIER_Z 3.5 // Modified z-score above which a run is an outlier
+
+// -------------------------
+// Options and Results
+// -------------------------
+
+struct BenchOptions {
+    int runs = 10;
+    int warmup = 0;
+    bool show_output = false;    // Otherwise stdout and stderr go to /dev/null
+    bool ignore_failure = false; // Keep going when a run exits non-zero
+    std::string export_json;
+    std::vector<std::string> commands;
+};
+
+// Shell state a benchmarked line may change (cd, alias, $?), restored after
+// every run so that each run starts from the state the first one saw.
+struct ShellSnapshot {
+    int cwd_fd = -1;
+    std::unordered_map<std::string, std::string> aliases;
+    int last_status = 0;
+};
+
+// Measurements and statistics of one benchmarked command. Times are in seconds.
+struct BenchResult {
+    std::string command;
+    std::vector<double> times;
+    std::vector<int> exit_codes;
+    double user = 0, sys = 0;    // Mean CPU time per run
+    double mean = 0, stddev = 0, median = 0, min = 0, max = 0;
+    size_t outliers = 0;
+};
+
+/**
+ * @brief Prints command-line usage.
+ */
+static void print_jbench_usage()
+{
+    std::cerr << "Usage: jbench [-n runs] [-w warmup] [-i] [--show-output] [--export file.json] <cmd> [<cmd2> ...]\n"
+                 "  Runs each quoted command line `runs` times (default 10) after `warmup` untimed\n"
+                 "  runs, and compares their wall times. Output is discarded unless --show-output.\n"
+                 "  -i keeps going when a command fails. --export writes the results as JSON.\n";
+}
+
+/**
+ * @brief Parses jbench options and commands.
+ *
+ * Options may come before or after the commands.
+ *
+ * @return false (after printing usage) on invalid arguments.
+ */
+static bool parse_jbench_args(int token_count, char *tokens[], BenchOptions &options)
+{
+    for (int i = 1; i < token_count; ++i)
+    {
+        const char *arg = tokens[i];
+        if (arg[0] != '-' || arg[1] == '\0')
+        {
+            options.commands.push_back(arg);
+            continue;
+        }
+        bool needs_value = strcmp(arg, "-n") == 0 || strcmp(arg, "-w") == 0 || strcmp(arg, "--export") == 0;
+        if (needs_value && i + 1 >= token_count)
+        {
+            std::cerr << "jbench: " << arg << " needs a value\n";
+            return false;
+        }
+        if (strcmp(arg, "-n") == 0)
+            options.runs = atoi(tokens[++i]);
+        else if (strcmp(arg, "-w") == 0)
+            options.warmup = atoi(tokens[++i]);
+        else if (strcmp(arg, "--export") == 0)
+            options.export_json = tokens[++i];
+        else if (strcmp(arg, "-i") == 0)
+            options.ignore_failure = true;
+        else if (strcmp(arg, "--show-output") == 0)
+            options.show_output = true;
+        else
+        {
+            print_jbench_usage();
+            return false;
+        }
+    }
+
+    if (options.commands.empty() || options.runs < 2 || options.warmup < 0)
+    {
+        print_jbench_usage();
+        return false;
+    }
+    return true;
+}
+
+// -------------------------
+// Running
+// -------------------------
+
+/**
+ * @brief Records the working directory, aliases and $? of the shell.
+ *
+ * @return false (after printing the error) if the directory cannot be opened.
+ */
+static bool take_snapshot(ShellSnapshot &snapshot)
+{
+    snapshot.cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (snapshot.cwd_fd < 0)
+    {
+        perror("jbench: .");
+        return false;
+    }
+    snapshot.aliases = aliases;
+    snapshot.last_status = shell_last_status;
+    return true;
+}
+
+/**
+ * @brief Puts the shell back into the state recorded by take_snapshot().
+ */
+static void restore_snapshot(const ShellSnapshot &snapshot)
+{
+    if (fchdir(snapshot.cwd_fd) != 0)
+        perror("jbench: fchdir");
+    if (aliases != snapshot.aliases)
+        aliases = snapshot.aliases;
+    shell_last_status = snapshot.last_status;
+}
+
+/**
+ * @brief Runs one command line as the shell would, with isolated streams.
+ *
+ * stdin comes from /dev/null so a command cannot eat the input of a
+ * script, and stdout/stderr go there too unless the output is shown. The
+ * line is copied first since tokenizing rewrites it.
+ *
+ * @param command  Command line.
+ * @param parsed   Token buffers reused across runs.
+ * @param dev_null Open /dev/null descriptor.
+ * @param quiet    Discard stdout and stderr.
+ * @param cost     Receives the measured cost.
+ * @return Exit status.
+ */
+static int run_isolated(const std::string &command, TokenizedLine &parsed, int dev_null, bool quiet, CommandCost &cost)
+{
+    std::vector<char> line(command.begin(), command.end());
+    line.push_back('\0');
+
+    int fds[] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    int saved[3] = {-1, -1, -1};
+    std::cout.flush();
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < (quiet ? 3 : 1); ++i)
+    {
+        saved[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, 10);
+        dup2(dev_null, fds[i]);
+    }
+
+    CostMeter meter = start_measurement();
+    int status = execute_line(line.data(), parsed);
+    cost = finish_measurement(meter);
+
+    std::cout.flush();
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; ++i)
+    {
+        if (saved[i] >= 0)
+        {
+            dup2(saved[i], fds[i]);
+            close(saved[i]);
+        }
+    }
+    return status;
+}
+
+// -------------------------
+// Statistics
+// -------------------------
+
+static double median_of(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+/**
+ * @brief Fills in mean, sample standard deviation, median, range and outliers.
+ *
+ * Outliers use the modified z-score 0.6745 * |x - median| / MAD, which
+ * unlike a mean/stddev test is not itself skewed by the outliers.
+ */
+static void compute_statistics(BenchResult &result)
+{
+    const auto &t = result.times;
+    double sum = 0;
+    for (double x : t)
+        sum += x;
+    result.mean = sum / t.size();
+    double squares = 0;
+    for (double x : t)
+        squares += (x - result.mean) * (x - result.mean);
+    result.stddev = t.size() > 1 ? std::sqrt(squares / (t.size() - 1)) : 0;
+    result.median = median_of(t);
+    result.min = *std::min_element(t.begin(), t.end());
+    result.max = *std::max_element(t.begin(), t.end());
+
+    std::vector<double> deviations;
+    for (double x : t)
+        deviations.push_back(std::fabs(x - result.median));
+    double mad = median_of(deviations);
+    result.outliers = 0;
+    for (double d : deviations)
+        result.outliers += mad > 0 && 0.6745 * d / mad > BENCH_OUTLIER_Z;
+}
+
+/**
+ * @brief Formats a duration in seconds with a unit that suits its size.
+ */
+static std::string format_time(double seconds, double scale_hint)
+{
+    char buf[32];
+    if (scale_hint < 1e-3)
+        snprintf(buf, sizeof(buf), "%.1f us", seconds * 1e6);
+    else if (scale_hint < 1)
+        snprintf(buf, sizeof(buf), "%.3f ms", seconds * 1000);
+    else
+        snprintf(buf, sizeof(buf), "%.3f s", seconds);
+    return buf;
+}
+
+static void print_result(size_t index, const BenchResult &result)
+{
+    double hint = result.mean;
+    printf("Benchmark %zu: %s\n", index + 1, result.command.c_str());
+    printf("  Time (mean +- sd):    %s +- %s    [user: %s, sys: %s]\n", format_time(result.mean, hint).c_str(),
+           format_time(result.stddev, hint).c_str(), format_time(result.user, hint).c_str(),
+           format_time(result.sys, hint).c_str());
+    printf("  Range (min .. max):   %s .. %s    median %s, %zu runs\n", format_time(result.min, hint).c_str(),
+           format_time(result.max, hint).c_str(), format_time(result.median, hint).c_str(), result.times.size());
+    if (result.outliers)
+        printf("  Warning: %zu outlier%s (modified z-score > %.1f); rerun on a quieter system or with more warmup.\n",
+               result.outliers, result.outliers == 1 ? "" : "s", BENCH_OUTLIER_Z);
+    printf("\n");
+}
+
+/**
+ * @brief Prints every command relative to the fastest one.
+ *
+ * The uncertainty of a ratio propagates the relative standard deviations
+ * of both means.
+ */
+static void print_summary(const std::vector<BenchResult> &results, size_t fastest)
+{
+    const BenchResult &base = results[fastest];
+    printf("Summary\n  '%s' ran\n", base.command.c_str());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        if (i == fastest)
+            continue;
+        const BenchResult &r = results[i];
+        double ratio = r.mean / base.mean;
+        double error = ratio * std::sqrt(std::pow(r.stddev / r.mean, 2) + std::pow(base.stddev / base.mean, 2));
+        printf("    %.2f +- %.2f times faster than '%s'\n", ratio, error, r.command.c_str());
+    }
+}
+
+/**
+ * @brief Writes the results as JSON (times in seconds) for CI checks.
+ */
+static bool export_results(const std::string &path, const std::vector<BenchResult> &results, size_t fastest)
+{
+    json out = {{"results", json::array()}};
+    for (const auto &r : results)
+    {
+        out["results"].push_back({
+            {"command", r.command},
+            {"mean", r.mean},
+            {"stddev", r.stddev},
+            {"median", r.median},
+            {"min", r.min},
+            {"max", r.max},
+            {"user", r.user},
+            {"system", r.sys},
+            {"relative", r.mean / results[fastest].mean},
+            {"outliers", r.outliers},
+            {"times", r.times},
+            {"exit_codes", r.exit_codes},
+        });
+    }
+    std::ofstream file(path);
+    file << out.dump(2) << "\n";
+    if (!file)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// -------------------------
+// jbench Builtin
+// -------------------------
+
+/**
+ * @brief Benchmarks one or more command lines against each other.
+ *
+ * Each command line is run through execute_line() exactly as if typed,
+ * with its own token buffers, so builtins, pipelines and in-process fast
+ * paths are measured as the shell really runs them. The working directory,
+ * aliases and $? are restored after every run, so `cd` or `alias` in a
+ * benchmarked line does not leak into the next run or out of jbench.
+ * Commands are measured one after another, warmup runs first.
+ *
+ * @return 0 on success, 1 if a run failed (without -i) or the export
+ *         failed, 2 on usage errors, 130 if interrupted.
+ */
+int handle_jbench_command(int token_count, char *tokens[])
+{
+    BenchOptions options;
+    if (!parse_jbench_args(token_count, tokens, options))
+        return 2;
+
+    int dev_null = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (dev_null < 0)
+    {
+        perror("/dev/null");
+        return 1;
+    }
+    ShellSnapshot snapshot;
+    if (!take_snapshot(snapshot))
+    {
+        close(dev_null);
+        return 1;
+    }
+    bool exit_requested = shell_exit_requested;
+    shell_exit_requested = false;
+
+    std::vector<BenchResult> results;
+    int exit_status = 0;
+    for (const auto &command : options.commands)
+    {
+        BenchResult result;
+        result.command = command;
+        TokenizedLine parsed;
+
+        for (int run = 0; run < options.warmup + options.runs && !exit_status; ++run)
+        {
+            CommandCost cost;
+            int status = run_isolated(command, parsed, dev_null, !options.show_output, cost);
+            restore_snapshot(snapshot);
+            if (shell_exit_requested || status == 130)
+            {
+                std::cerr << "jbench: interrupted\n";
+                exit_status = 130;
+            }
+            else if (status != 0 && !options.ignore_failure)
+            {
+                std::cerr << "jbench: '" << command << "' exited with status " << status
+                          << " (use -i to ignore failures)\n";
+                exit_status = 1;
+            }
+            if (run < options.warmup || exit_status)
+                continue;
+            result.times.push_back(cost.wall_ms / 1000);
+            result.exit_codes.push_back(status);
+            result.user += cost.user_s / options.runs;
+            result.sys += cost.sys_s / options.runs;
+        }
+        if (exit_status)
+            break;
+
+        compute_statistics(result);
+        print_result(results.size(), result);
+        fflush(stdout);
+        results.push_back(std::move(result));
+    }
+    close(dev_null);
+    close(snapshot.cwd_fd);
+    shell_exit_requested = exit_requested;
+    if (exit_status)
+        return exit_status;
+
+    size_t fastest = 0;
+    for (size_t i = 1; i < results.size(); ++i)
+    {
+        if (results[i].mean < results[fastest].mean)
+            fastest = i;
+    }
+    if (results.size() > 1)
+        print_summary(results, fastest);
+    if (!options.export_json.empty() && !export_results(options.export_json, results, fastest))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+int handle_jbench_command(int token_count, char *tokens[]);
+
+#endif // BENCH_H
@@ -0,0 +1,427 @@
+#include "builtins.h"
+#include <iostream>
+#include <string>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include "commands.h"
+#include "history.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "pathcache.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "timing.h"
+#include "bench.h"
+#include "search.h"
+#include "locate.h"
+#include "shell.h"
+using namespace std;
+
+bool shell_exit_requested = false;
+
+// -------------------------
+// Builtin Handlers
+// -------------------------
+
+static int builtin_help(int, char *[])
+{
+    print_help_menu();
+    return 0;
+}
+
+static int builtin_exit(int token_count, char *tokens[])
+{
+    // Like other shells, warn once about stopped jobs before leaving them behind.
+    static bool warned = false;
+    if (has_stopped_jobs() && !warned)
+    {
+        warned = true;
+        cerr << "There are stopped jobs.\n";
+        return 1;
+    }
+    shell_exit_requested = true;
+    return token_count > 1 ? atoi(tokens[1]) & 0xFF : shell_last_status;
+}
+
+static int builtin_history(int token_count, char *tokens[])
+{
+    return handle_history_command(token_count, tokens);
+}
+
+static int builtin_alias(int token_count, char *tokens[])
+{
+    string def_str = tokens[1];
+    for (int i = 2; i < token_count; ++i)
+    {
+        def_str += " ";
+        def_str += tokens[i];
+    }
+    auto eq = def_str.find('=');
+    if (eq == string::npos)
+    {
+        cerr << "Usage: alias name=command\n";
+        return 1;
+    }
+    string key = def_str.substr(0, eq);
+    string val = def_str.substr(eq + 1);
+    aliases[key] = val;
+    cout << "Alias set: " << key << " -> " << val << endl;
+    return 0;
+}
+
+static int builtin_hash(int token_count, char *tokens[])
+{
+    handle_hash_command(token_count, tokens);
+    return 0;
+}
+
+static int builtin_jcreate(int, char *tokens[])
+{
+    create_file(tokens[1]);
+    return 0;
+}
+
+static int builtin_jsave(int, char *tokens[])
+{
+    save_file(tokens[1]);
+    return 0;
+}
+
+static int builtin_jedit(int, char *tokens[])
+{
+    edit_file(tokens[1]);
+    return 0;
+}
+
+static int builtin_jmodify(int, char *tokens[])
+{
+    modify_file(tokens[1]);
+    return 0;
+}
+
+static int builtin_jrename(int, char *tokens[])
+{
+    rename_file(tokens[1], tokens[2]);
+    return 0;
+}
+
+static int builtin_jexecute(int token_count, char *tokens[])
+{
+    if (string_view(tokens[1]) != "--profile")
+    {
+        execute_jam_script(tokens[1]);
+    }
+    else if (token_count > 2)
+    {
+        profile_jam_script(tokens[2], token_count > 3 ? tokens[3] : nullptr);
+    }
+    else
+    {
+        cerr << "Usage: jexecute --profile <filename> [stacks_file]\n";
+        return 2;
+    }
+    return 0;
+}
+
+static int builtin_sgown(int token_count, char *tokens[])
+{
+    return handle_sgown_command(token_count, tokens);
+}
+
+static int builtin_locate(int token_count, char *tokens[])
+{
+    return handle_locate_command(token_count, tokens);
+}
+
+static int builtin_jupdatedb(int token_count, char *tokens[])
+{
+    return handle_jupdatedb_command(token_count, tokens);
+}
+
+static int builtin_cd(int, char *tokens[])
+{
+    change_directory(tokens[1]);
+    return 0;
+}
+
+static int builtin_jschedule(int token_count, char *tokens[])
+{
+    int priority = (token_count > 2) ? atoi(tokens[2]) : 2;
+    jschedule_command(tokens[1], priority);
+    return 0;
+}
+
+static int builtin_jschedulexecute(int, char *[])
+{
+    jschedulexecute_command();
+    return 0;
+}
+
+static int builtin_jscheduleview(int, char *[])
+{
+    print_scheduled_tasks();
+    return 0;
+}
+
+static int builtin_jschedulesave(int, char *tokens[])
+{
+    save_queues_to_file(tokens[1]);
+    return 0;
+}
+
+static int builtin_jschedulecancel(int, char *tokens[])
+{
+    cancel_task(atoi(tokens[1]));
+    return 0;
+}
+
+static int builtin_jschedulemodify(int token_count, char *tokens[])
+{
+    string new_cmd = tokens[2];
+    for (int i = 3; i < token_count; ++i)
+    {
+        new_cmd += " ";
+        new_cmd += tokens[i];
+    }
+    modify_task(atoi(tokens[1]), new_cmd);
+    return 0;
+}
+
+static int builtin_jobs(int token_count, char *tokens[])
+{
+    return handle_jobs_command(token_count, tokens);
+}
+
+static int builtin_fg(int token_count, char *tokens[])
+{
+    return handle_fg_command(token_count, tokens);
+}
+
+static int builtin_bg(int token_count, char *tokens[])
+{
+    return handle_bg_command(token_count, tokens);
+}
+
+static int builtin_wait(int token_count, char *tokens[])
+{
+    return handle_wait_command(token_count, tokens);
+}
+
+static int builtin_kill(int token_count, char *tokens[])
+{
+    return handle_kill_command(token_count, tokens);
+}
+
+static int builtin_jparallel(int token_count, char *tokens[])
+{
+    return handle_jparallel_command(token_count, tokens);
+}
+
+static int builtin_jtime(int token_count, char *tokens[])
+{
+    return handle_jtime_command(token_count, tokens);
+}
+
+static int builtin_jbench(int token_count, char *tokens[])
+{
+    return handle_jbench_command(token_count, tokens);
+}
+
+static int builtin_jambo(int token_count, char *tokens[])
+{
+    return handle_jambo_command(token_count, tokens);
+}
+
+// -------------------------
+// Builtin Registry
+// -------------------------
+
+// The one place to add a builtin. Entries are listed in help-menu order;
+// lookups go through the compile-time perfect hash below.
+static constexpr Builtin builtins[] = {
+    {"help", 0, builtin_help, "General", "help", "Show this help menu"},
+    {"exit", 0, builtin_exit, "General", "exit [status]", "Exit the JAM Shell"},
+    {"history", 0, builtin_history, "General", "history [N]\nhistory -s <text>",
+     "View command history, or the last N commands\nSearch it, most frequently and recently used first"},
+    {"alias", 1, builtin_alias, "General", "alias name=command", "Create an alias"},
+    {"hash", 0, builtin_hash, "General", "hash [-r] [name...]", "Show, reset or prime the command path cache"},
+
+    {"jcreate", 1, builtin_jcreate, "File Operations", "jcreate <filename>", "Create a new file"},
+    {"jsave", 1, builtin_jsave, "File Operations", "jsave <filename>", "Save current content to a file"},
+    {"jedit", 1, builtin_jedit, "File Operations", "jedit <filename>", "Edit a file's contents"},
+    {"jmodify", 1, builtin_jmodify, "File Operations", "jmodify <filename>", "Modify a file interactively"},
+    {"jrename", 2, builtin_jrename, "File Operations", "jrename <old> <new>", "Rename a file"},
+    {"jexecute", 1, builtin_jexecute, "File Operations",
+     "jexecute <filename>\njexecute --profile <file> [out]",
+     "Execute a JAM script\nProfile a JAM script (collapsed stacks to out)"},
+
+    {"sgown", 1, builtin_sgown, "Search & Navigation", "sgown [-j N] [--stable] [--max-count N] [--max-files N] [--hidden] [--no-ignore] [-E] <term>\nsgown [options] [-E] -e <pattern> [-e <pattern> ...]\nsgown --index build|update|drop",
+     "Search for term in all files\nSearch for several patterns in one pass, with counts\nManage the trigram index of this directory"},
+    {"locate", 1, builtin_locate, "Search & Navigation", "locate [--no-db] [--hidden] [--no-ignore] <term>",
+     "Find files/folders with term in name"},
+    {"jupdatedb", 0, builtin_jupdatedb, "Search & Navigation", "jupdatedb [-o db] [--hidden] [--no-ignore] [root]",
+     "Write the locate database for root (default .)"},
+    {"cd", 1, builtin_cd, "Search & Navigation", "cd <path>", "Change working directory"},
+
+    {"jschedule", 1, builtin_jschedule, "Scheduling", "jschedule <file> [priority]", "Schedule a file for execution (1-high, 2-mid, 3-low)"},
+    {"jschedulexecute", 0, builtin_jschedulexecute, "Scheduling", "jschedulexecute", "Execute all scheduled tasks"},
+    {"jscheduleview", 0, builtin_jscheduleview, "Scheduling", "jscheduleview", "View tasks in scheduling queue"},
+    {"jschedulesave", 1, builtin_jschedulesave, "Scheduling", "jschedulesave <filename>", "Save current queues to file"},
+    {"jschedulecancel", 1, builtin_jschedulecancel, "Scheduling", "jschedulecancel <task_id>", "Cancel a scheduled task by ID"},
+    {"jschedulemodify", 2, builtin_jschedulemodify, "Scheduling", "jschedulemodify <id> <cmd>", "Modify a scheduled task's command"},
+
+    {"jobs", 0, builtin_jobs, "Jobs", "jobs [-l]", "List background and stopped jobs"},
+    {"fg", 0, builtin_fg, "Jobs", "fg [%job]", "Continue a job in the foreground"},
+    {"bg", 0, builtin_bg, "Jobs", "bg [%job]", "Continue a stopped job in the background"},
+    {"wait", 0, builtin_wait, "Jobs", "wait [%job|pid...]", "Wait for background jobs to finish"},
+    {"kill", 1, builtin_kill, "Jobs", "kill [-SIG] %job|pid...", "Send a signal to a job or process"},
+    {"jparallel", 1, builtin_jparallel, "Jobs", "jparallel [-j N] [-k] <cmd> [::: args...]",
+     "Run cmd once per argument (or stdin line), N at a time"},
+    {"jtime", 0, builtin_jtime, "Jobs", "jtime <cmd...>\njtime -t <ms>|off",
+     "Report wall/CPU time, max RSS, context switches and faults\nReport every command slower than ms"},
+    {"jbench", 1, builtin_jbench, "Jobs",
+     "jbench [-n runs] [-w warmup] [-i] [--show-output] [--export file.json] <cmd> [<cmd2> ...]",
+     "Benchmark quoted command lines and compare them"},
+
+    {"jambo", 0, builtin_jambo, "Jambo",
+     "jambo\njambo -l <filename>\njambo -p <filename>\njambo -s <filename>\n"
+     "jambo -l|-p|-s <files...> [-j N]\njambo -l|-p|-s <file> --no-ai\njambo --cache [clear]",
+     "Launch interactive JAMBO shell\nPerform lexer analysis on a JAM file\nParse a JAM source file\n"
+     "Run semantic analysis on a JAM file\nAnalyse many files in parallel (no AI)\n"
+     "Analyse without asking the Groq API\nShow (or clear) the parsed module cache"},
+};
+
+static constexpr size_t builtin_count = sizeof(builtins) / sizeof(builtins[0]);
+
+/**
+ * @brief Smallest power of two that leaves the hash table at most a quarter full.
+ *
+ * A sparser table costs a few bytes but keeps the compile-time seed search
+ * short as builtins are added.
+ */
+static constexpr size_t slot_count_for(size_t n)
+{
+    size_t slots = 1;
+    while (slots < 4 * n)
+        slots <<= 1;
+    return slots;
+}
+
+static constexpr size_t builtin_slots = slot_count_for(builtin_count);
+static_assert(builtin_count < 0xFF, "builtin indices are stored as bytes");
+
+/**
+ * @brief Seeded FNV-1a hash used for the builtin perfect hash.
+ */
+static constexpr uint32_t builtin_hash(string_view name, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct BuiltinIndex {
+    uint32_t seed = 0; // 0 means no collision-free seed was found
+    array<uint8_t, builtin_slots> slots{};
+};
+
+/**
+ * @brief Searches, at compile time, for a seed that maps every builtin to its own slot.
+ */
+static constexpr BuiltinIndex make_builtin_index()
+{
+    BuiltinIndex index;
+    for (uint32_t seed = 1; seed < 100000; ++seed)
+    {
+        for (size_t s = 0; s < builtin_slots; ++s)
+            index.slots[s] = 0xFF;
+
+        bool collision = false;
+        for (size_t i = 0; i < builtin_count && !collision; ++i)
+        {
+            size_t slot = builtin_hash(builtins[i].name, seed) & (builtin_slots - 1);
+            collision = index.slots[slot] != 0xFF;
+            index.slots[slot] = static_cast<uint8_t>(i);
+        }
+        if (!collision)
+        {
+            index.seed = seed;
+            return index;
+        }
+    }
+    return BuiltinIndex{};
+}
+
+static constexpr BuiltinIndex builtin_index = make_builtin_index();
+static_assert(builtin_index.seed != 0, "builtin names collide (duplicate name?); no perfect hash seed found");
+
+// -------------------------
+// Registry Access
+// -------------------------
+
+/**
+ * @brief Finds a builtin by name in constant time.
+ *
+ * @param name Command name.
+ * @return Matching registry entry, or nullptr if it is not a builtin.
+ */
+const Builtin *find_builtin(string_view name)
+{
+    uint8_t i = builtin_index.slots[builtin_hash(name, builtin_index.seed) & (builtin_slots - 1)];
+    return i != 0xFF && builtins[i].name == name ? &builtins[i] : nullptr;
+}
+
+/**
+ * @brief Gives access to the registry in help-menu order.
+ *
+ * @param count Receives the number of entries.
+ * @return Pointer to the first entry.
+ */
+const Builtin *builtin_list(size_t &count)
+{
+    count = builtin_count;
+    return builtins;
+}
+
+/**
+ * @brief Checks a builtin's arity and runs its handler.
+ *
+ * @param builtin     Registry entry returned by find_builtin().
+ * @param token_count The number of command-line tokens received.
+ * @param tokens      An array of strings containing the command-line tokens.
+ * @return Exit status of the builtin; 2 on a usage error.
+ */
+int run_builtin(const Builtin &builtin, int token_count, char *tokens[])
+{
+    if (token_count - 1 < builtin.min_args)
+    {
+        cerr << "Usage: " << builtin.usage.substr(0, builtin.usage.find('\n')) << "\n";
+        return 2;
+    }
+    return builtin.handler(token_count, tokens);
+}
+
+/**
+ * @brief Prints every builtin usage as "category<TAB>usage<TAB>help" lines.
+ *
+ * Used by the GUI (`jam --builtins`) to build its command menus.
+ */
+void print_builtin_list()
+{
+    for (const auto &builtin : builtins)
+    {
+        string_view usage = builtin.usage, help = builtin.help;
+        while (!usage.empty())
+        {
+            size_t u = usage.find('\n'), h = help.find('\n');
+            cout << builtin.category << '\t' << usage.substr(0, u) << '\t' << help.substr(0, h) << '\n';
+            usage = u == string_view::npos ? string_view() : usage.substr(u + 1);
+            help = h == string_view::npos ? string_view() : help.substr(h + 1);
+        }
+    }
+}
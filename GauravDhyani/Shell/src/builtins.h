@@ -0,0 +1,28 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <cstddef>
+#include <string_view>
+
+// Handler signature shared by every builtin; tokens[0] is the builtin name.
+typedef int (*BuiltinHandler)(int token_count, char *tokens[]);
+
+// One entry of the builtin registry. `usage` and `help` may hold several
+// '\n'-separated variants of the command, paired line by line.
+struct Builtin {
+    std::string_view name;
+    int min_args;           // Arguments required after the name
+    BuiltinHandler handler;
+    std::string_view category;
+    std::string_view usage;
+    std::string_view help;
+};
+
+const Builtin *find_builtin(std::string_view name);
+const Builtin *builtin_list(size_t &count);
+int run_builtin(const Builtin &builtin, int token_count, char *tokens[]);
+void print_builtin_list();
+
+extern bool shell_exit_requested;
+
+#endif // BUILTINS_H
@@ -7,10 +7,18 @@
 #include <cstring>
 #include "scheduler.h"     
 #include <sstream>         
+#include <vector>
+#include <thread>
+#include <algorithm>
 #include "../JAM/executionengine.h"
 #include "jambo.h"
+#include "modcache.h"
+#include "pathcache.h"
+#include "builtins.h"
 using namespace std;
 
+#define JAMBO_MAX_FAILED_STATUS 125  // Batch exit status cap, below the shell's 126/127 codes
+
 // -------------------------
 // Help Menu
 // -------------------------
@@ -18,52 +26,44 @@ using namespace std;
 /**
  * @brief Displays the list of available JAM Shell commands and their descriptions.
  * 
- * This function prints categorized help information to guide users through 
- * the built-in JAM shell commands.
+ * The builtin sections are generated from the builtin registry, grouped by
+ * category in registry order, followed by the shell syntax reference.
  */
 void print_help_menu() {
-    printf("\n=========== JAM Shell Help Menu ===========\n");
-    printf("General Commands:\n");
-    printf("  help                         - Show this help menu\n");
-    printf("  exit                         - Exit the JAM Shell\n");
-    printf("  history                      - View command history\n");
-    printf("  alias name=command           - Create an alias\n");
-
-    printf("\nFile Operations:\n");
-    printf("  jcreate <filename>           - Create a new file\n");
-    printf("  jsave <filename>             - Save current content to a file\n");
-    printf("  jedit <filename>             - Edit a file's contents\n");
-    printf("  jmodify <filename>           - Modify a file interactively\n");
-    printf("  jrename <old> <new>          - Rename a file\n");
-    printf("  jexecute <filename>          - Execute a JAM script\n");
+    size_t count = 0;
+    const Builtin* builtins = builtin_list(count);
 
-    printf("\nSearch & Navigation:\n");
-    printf("  sgown <term>                 - Search for term in all files\n");
-    printf("  locate <term>                - Find files/folders with term in name\n");
-    printf("  cd <path>                    - Change working directory\n");
-
-    printf("\nScheduling:\n");
-    printf("  jschedule <file> [priority]  - Schedule a file for execution (1-high, 2-mid, 3-low)\n");
-    printf("  jschedulexecute              - Execute all scheduled tasks\n");
-    printf("  jscheduleview                - View tasks in scheduling queue\n");
-    printf("  jschedulesave <filename>     - Save current queues to file\n");
-    printf("  jschedulecancel <task_id>    - Cancel a scheduled task by ID\n");
-    printf("  jschedulemodify <id> <cmd>   - Modify a scheduled task's command\n");
+    printf("\n=========== JAM Shell Help Menu ===========\n");
+    vector<string_view> categories;
+    for (size_t i = 0; i < count; ++i) {
+        if (find(categories.begin(), categories.end(), builtins[i].category) == categories.end())
+            categories.push_back(builtins[i].category);
+    }
+    for (size_t c = 0; c < categories.size(); ++c) {
+        printf("%s%.*s:\n", c ? "\n" : "", (int)categories[c].size(), categories[c].data());
+        for (size_t i = 0; i < count; ++i) {
+            if (builtins[i].category != categories[c]) continue;
+            string_view usage = builtins[i].usage, help = builtins[i].help;
+            while (!usage.empty()) {
+                size_t u = usage.find('\n'), h = help.find('\n');
+                string_view line = usage.substr(0, u), text = help.substr(0, h);
+                printf("  %-33.*s - %.*s\n", (int)line.size(), line.data(), (int)text.size(), text.data());
+                usage = u == string_view::npos ? string_view() : usage.substr(u + 1);
+                help = h == string_view::npos ? string_view() : help.substr(h + 1);
+            }
+        }
+    }
 
     printf("\nPipes & Redirection:\n");
-    printf("  command > file               - Redirect stdout to file (overwrite)\n");
-    printf("  command >> file              - Redirect stdout to file (append)\n");
-    printf("  command < file               - Redirect stdin from file\n");
-    printf("  command1 | command2          - Pipe output of one command into another\n");
+    printf("  command > file                    - Redirect stdout to file (overwrite)\n");
+    printf("  command >> file                   - Redirect stdout to file (append)\n");
+    printf("  command < file                    - Redirect stdin from file\n");
+    printf("  cmd1 | cmd2 | ... | cmdN          - Pipe each command's output into the next\n");
+    printf("  cmd1 < in | cmd2 > out            - Redirections apply to any pipeline stage\n");
 
     printf("\nBackground Execution:\n");
-    printf("  command &                    - Run command in background\n");
-
-    printf("\nJAMBO Command:\n");
-    printf("  jambo                       - Launch interactive JAMBO shell\n");
-    printf("  jambo -l <filename>         - Perform lexer analysis on a JAM file\n");
-    printf("  jambo -p <filename>         - Parse a JAM source file\n");
-    printf("  jambo -s <filename>         - Run semantic analysis on a JAM file\n");
+    printf("  command &                         - Run command in background\n");
+    printf("  Ctrl-Z                            - Stop the foreground job (resume with fg/bg)\n");
 
     printf("===========================================\n\n");
 }
@@ -175,40 +175,13 @@ void change_directory(const char* path) {
 /**
  * @brief Checks if a given string is a valid system shell command.
  * 
+ * Answered from the in-process $PATH table, so no shell is spawned.
+ * 
  * @param input The command to validate.
  * @return true if it is a valid shell command, false otherwise.
  */
 bool is_shell_command(const char* input) {
-    return system((string("command -v ") + input + " > /dev/null 2>&1").c_str()) == 0;
-}
-
-/**
- * @brief Executes a raw shell command using the system() call.
- * 
- * @param input The command to be executed.
- */
-void execute_shell_command(const char* input) {
-    int result = system(input);
-    if (result != 0) {
-        cerr << "Command exited with code: " << result << "\n";
-    }
-}
-
-// -------------------------
-// JAM Script Utilities
-// -------------------------
-
-/**
- * @brief Checks whether a given input string refers to a JAM script.
- * 
- * JAM scripts are identified by the ".jam" file extension.
- * 
- * @param input The input string to evaluate.
- * @return true if the input contains ".jam", false otherwise.
- */
-bool is_jam_script(const char* input) {
-    string str = input;
-    return str.find(".jam") != string::npos;
+    return lookup_executable(input, false) != nullptr;
 }
 
 // -------------------------
@@ -261,33 +234,82 @@ void execute_task(const Task& task) {
  * Prints appropriate status messages for each operation. 
  * Displays an error message if an unrecognized command or insufficient parameters are provided.
  * 
+ * Several files, directories, wildcards or a "-j N" option switch to batch mode,
+ * which analyses the files in parallel without calling the Groq API.
+ * "--no-ai" skips the Groq API for a single file as well, and "--cache [clear]"
+ * reports or resets the parsed module cache.
+ * 
  * @param token_count The number of command-line tokens received.
  * @param tokens      An array of strings containing the command-line tokens.
+ * @return int Exit status: the analysis result for one file, the number of
+ *         failed files (at most JAMBO_MAX_FAILED_STATUS) in batch mode, or 2
+ *         on a usage error.
  */
-void handle_jambo_command(int token_count, char *tokens[])
+int handle_jambo_command(int token_count, char *tokens[])
 {
     if (token_count == 1)
     {
         printf("Jambo invoked.\n");
         run_jambo();
+        return 0;
+    }
+    if (strcmp(tokens[1], "--cache") == 0)
+    {
+        if (token_count > 2 && strcmp(tokens[2], "clear") == 0)
+            clear_module_cache();
+        else
+            print_module_cache_stats();
+        return 0;
     }
-    else if (strcmp(tokens[1], "-l") == 0 && token_count > 2)
+
+    char mode = 0;
+    if (strcmp(tokens[1], "-l") == 0)
+        mode = 'l';
+    else if (strcmp(tokens[1], "-s") == 0)
+        mode = 's';
+    else if (strcmp(tokens[1], "-p") == 0)
+        mode = 'p';
+
+    vector<string> files;
+    int jobs = 0;
+    bool with_ai = true;
+    for (int i = 2; i < token_count; ++i)
     {
-        printf("Loading JAMBO file: %s\n", tokens[2]);
-        analyse_lexer(tokens[2]);
+        if (strcmp(tokens[i], "-j") == 0 && i + 1 < token_count)
+            jobs = atoi(tokens[++i]);
+        else if (strncmp(tokens[i], "-j", 2) == 0 && tokens[i][2] != '\0')
+            jobs = atoi(tokens[i] + 2);
+        else if (strcmp(tokens[i], "--no-ai") == 0)
+            with_ai = false;
+        else
+            files.push_back(tokens[i]);
     }
-    else if (strcmp(tokens[1], "-s") == 0 && token_count > 2)
+
+    if (mode == 0 || files.empty())
     {
-        printf("Saving JAMBO file: %s\n", tokens[2]);
-        analyse_semantics(tokens[2]);
+        printf("Unknown jambo command or missing parameters.\n");
+        return 2;
     }
-    else if (strcmp(tokens[1], "-p") == 0 && token_count > 2)
+
+    struct stat st;
+    bool batch = files.size() > 1 || jobs > 0 || strpbrk(files[0].c_str(), "*?[{") != nullptr ||
+                 (stat(files[0].c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+    if (batch)
     {
-        printf("Parsing JAMBO source: %s\n", tokens[2]);
-        analyse_parser(tokens[2]);
+        if (jobs <= 0)
+            jobs = max(1u, thread::hardware_concurrency());
+        return min(run_jambo_batch(mode, files, jobs), JAMBO_MAX_FAILED_STATUS);
     }
-    else
+    if (mode == 'l')
     {
-        printf("Unknown jambo command or missing parameters.\n");
+        printf("Loading JAMBO file: %s\n", files[0].c_str());
+        return analyse_lexer(files[0].c_str(), with_ai);
+    }
+    if (mode == 's')
+    {
+        printf("Saving JAMBO file: %s\n", files[0].c_str());
+        return analyse_semantics(files[0].c_str(), with_ai);
     }
+    printf("Parsing JAMBO source: %s\n", files[0].c_str());
+    return analyse_parser(files[0].c_str(), with_ai);
 }
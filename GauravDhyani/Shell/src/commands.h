@@ -15,11 +15,9 @@ void save_file(const char* filename);
 void change_directory(const char* path);
 
 bool is_shell_command(const char* input);
-void execute_shell_command(const char* input);
 
-bool is_jam_script(const char* input);
 void execute_jam_script(const char* filename);
 void execute_task(const Task& task);
-void handle_jambo_command(int token_count, char *tokens[]);
+int handle_jambo_command(int token_count, char *tokens[]);
 
 #endif // COMMANDS_H
@@ -0,0 +1,462 @@
+#include "fastpath.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+// -------------------------
+// Output Errors
+// -------------------------
+
+/**
+ * @brief Flushes stdout and reports output that could not be written, as coreutils does.
+ *
+ * @param name Command name for the message.
+ * @return 0, or 1 if writing failed (e.g. ENOSPC on /dev/full).
+ */
+static int finish_output(const char *name)
+{
+    if (fflush(stdout) == 0 && !ferror(stdout))
+        return 0;
+    fprintf(stderr, "%s: write error: %s\n", name, strerror(errno));
+    clearerr(stdout);
+    return 1;
+}
+
+// -------------------------
+// echo, pwd, true, false
+// -------------------------
+
+/**
+ * @brief echo [-n] [-e|-E] args: GNU echo without --help/--version.
+ */
+static int fast_echo(int argc, char *argv[])
+{
+    bool newline = true, escapes = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i)
+    {
+        if (strspn(argv[i] + 1, "neE") != strlen(argv[i] + 1))
+            break; // Not an option; printed as text like GNU echo does
+        for (const char *p = argv[i] + 1; *p; ++p)
+        {
+            if (*p == 'n')
+                newline = false;
+            else
+                escapes = *p == 'e';
+        }
+    }
+
+    for (int first = i; i < argc; ++i)
+    {
+        if (i > first)
+            fputc(' ', stdout);
+        if (!escapes)
+        {
+            fputs(argv[i], stdout);
+            continue;
+        }
+        for (const char *p = argv[i]; *p; ++p)
+        {
+            if (*p != '\\' || p[1] == '\0')
+            {
+                fputc(*p, stdout);
+                continue;
+            }
+            switch (*++p)
+            {
+            case 'n': fputc('\n', stdout); break;
+            case 't': fputc('\t', stdout); break;
+            case 'r': fputc('\r', stdout); break;
+            case 'a': fputc('\a', stdout); break;
+            case 'b': fputc('\b', stdout); break;
+            case 'f': fputc('\f', stdout); break;
+            case 'v': fputc('\v', stdout); break;
+            case 'e': fputc('\033', stdout); break;
+            case '\\': fputc('\\', stdout); break;
+            case 'c': return finish_output("echo"); // Stop output here
+            case '0': // \0nnn: up to three octal digits
+            {
+                int value = 0;
+                for (int digits = 0; digits < 3 && p[1] >= '0' && p[1] <= '7'; ++digits)
+                    value = value * 8 + (*++p - '0');
+                fputc(value & 0xFF, stdout);
+                break;
+            }
+            case 'x': // \xHH: one or two hex digits; a bare \x is printed as is
+            {
+                if (!isxdigit(static_cast<unsigned char>(p[1])))
+                {
+                    fputs("\\x", stdout);
+                    break;
+                }
+                int value = 0;
+                for (int digits = 0; digits < 2 && isxdigit(static_cast<unsigned char>(p[1])); ++digits)
+                {
+                    char c = *++p;
+                    value = value * 16 + (isdigit(static_cast<unsigned char>(c)) ? c - '0' : (c | 0x20) - 'a' + 10);
+                }
+                fputc(value, stdout);
+                break;
+            }
+            default:
+                fputc('\\', stdout);
+                fputc(*p, stdout);
+            }
+        }
+    }
+    if (newline)
+        fputc('\n', stdout);
+    return finish_output("echo");
+}
+
+/**
+ * @brief pwd: prints the working directory.
+ */
+static int fast_pwd(int argc, char *[])
+{
+    if (argc > 1)
+        return FASTPATH_FALLBACK;
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)))
+    {
+        perror("pwd");
+        return 1;
+    }
+    puts(cwd);
+    return finish_output("pwd");
+}
+
+static int fast_true(int, char *[])
+{
+    return 0;
+}
+
+static int fast_false(int, char *[])
+{
+    return 1;
+}
+
+// -------------------------
+// test / [
+// -------------------------
+
+/**
+ * @brief Evaluates a unary file or string test.
+ *
+ * @return 0 if true, 1 if false, FASTPATH_FALLBACK for unknown operators.
+ */
+static int test_unary(const char *op, const char *arg)
+{
+    struct stat st;
+    bool exists = op[1] != 'z' && op[1] != 'n' && stat(arg, &st) == 0;
+    bool result;
+    switch (op[1] != '\0' && op[2] == '\0' ? op[1] : '\0')
+    {
+    case 'e': result = exists; break;
+    case 'f': result = exists && S_ISREG(st.st_mode); break;
+    case 'd': result = exists && S_ISDIR(st.st_mode); break;
+    case 's': result = exists && st.st_size > 0; break;
+    case 'r': result = access(arg, R_OK) == 0; break;
+    case 'w': result = access(arg, W_OK) == 0; break;
+    case 'x': result = access(arg, X_OK) == 0; break;
+    case 'z': result = arg[0] == '\0'; break;
+    case 'n': result = arg[0] != '\0'; break;
+    default: return FASTPATH_FALLBACK;
+    }
+    return result ? 0 : 1;
+}
+
+/**
+ * @brief Evaluates a binary string or integer comparison.
+ *
+ * @return 0 if true, 1 if false, FASTPATH_FALLBACK for unknown operators.
+ */
+static int test_binary(const char *lhs, const char *op, const char *rhs)
+{
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(lhs, rhs) == 0 ? 0 : 1;
+    if (strcmp(op, "!=") == 0)
+        return strcmp(lhs, rhs) != 0 ? 0 : 1;
+
+    static const char *int_ops[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};
+    int which = -1;
+    for (int i = 0; i < 6; ++i)
+    {
+        if (strcmp(op, int_ops[i]) == 0)
+            which = i;
+    }
+    if (which < 0)
+        return FASTPATH_FALLBACK;
+
+    char *end_l, *end_r;
+    long long a = strtoll(lhs, &end_l, 10), b = strtoll(rhs, &end_r, 10);
+    if (*lhs == '\0' || *end_l != '\0' || *rhs == '\0' || *end_r != '\0')
+        return FASTPATH_FALLBACK; // Let the real test report the bad integer
+    bool result[] = {a == b, a != b, a < b, a <= b, a > b, a >= b};
+    return result[which] ? 0 : 1;
+}
+
+/**
+ * @brief test EXPR / [ EXPR ]: the one- to three-argument forms and "!".
+ *
+ * -a, -o and parentheses fall back to the real test.
+ */
+static int fast_test(int argc, char *argv[])
+{
+    if (strcmp(argv[0], "[") == 0)
+    {
+        if (argc < 2 || strcmp(argv[argc - 1], "]") != 0)
+            return FASTPATH_FALLBACK;
+        argc--;
+    }
+    char **args = argv + 1;
+    int n = argc - 1;
+
+    bool negate = false;
+    if (n > 1 && strcmp(args[0], "!") == 0)
+    {
+        negate = true;
+        args++;
+        n--;
+    }
+
+    int result;
+    if (n == 0)
+        result = 1;
+    else if (n == 1)
+        result = args[0][0] != '\0' ? 0 : 1;
+    else if (n == 2 && args[0][0] == '-')
+        result = test_unary(args[0], args[1]);
+    else if (n == 3)
+        result = test_binary(args[0], args[1], args[2]);
+    else
+        result = FASTPATH_FALLBACK;
+
+    if (result == FASTPATH_FALLBACK)
+        return result;
+    return negate ? !result : result;
+}
+
+// -------------------------
+// cat
+// -------------------------
+
+/**
+ * @brief Copies a file descriptor to stdout inside the kernel where possible.
+ *
+ * Uses copy_file_range() when stdout is a regular file and sendfile()
+ * otherwise, falling back to read()/write() when neither applies (a pipe
+ * or terminal as the source, or stdout opened with O_APPEND by ">>").
+ *
+ * @return true on success; errno is set on failure.
+ */
+static bool copy_to_stdout(int in_fd)
+{
+    struct stat out_st;
+    bool out_regular = fstat(STDOUT_FILENO, &out_st) == 0 && S_ISREG(out_st.st_mode) &&
+                       !(fcntl(STDOUT_FILENO, F_GETFL) & O_APPEND);
+    struct stat in_st;
+    bool in_regular = fstat(in_fd, &in_st) == 0 && S_ISREG(in_st.st_mode);
+
+    if (in_regular && out_regular)
+    {
+        ssize_t n;
+        while ((n = copy_file_range(in_fd, nullptr, STDOUT_FILENO, nullptr, 1 << 30, 0)) > 0)
+            ;
+        if (n == 0)
+            return true;
+        if (errno != EXDEV && errno != EINVAL && errno != ENOSYS && errno != EOPNOTSUPP)
+            return false;
+    }
+    if (in_regular)
+    {
+        ssize_t n;
+        while ((n = sendfile(STDOUT_FILENO, in_fd, nullptr, 1 << 30)) > 0)
+            ;
+        if (n == 0)
+            return true;
+        if (errno != EINVAL && errno != ENOSYS)
+            return false;
+    }
+
+    static char buf[1 << 16];
+    ssize_t n;
+    while ((n = read(in_fd, buf, sizeof(buf))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        for (ssize_t done = 0; done < n;)
+        {
+            ssize_t w = write(STDOUT_FILENO, buf + done, n - done);
+            if (w < 0 && errno != EINTR)
+                return false;
+            done += w > 0 ? w : 0;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief cat [file...] without options; "-" or no files means stdin.
+ *
+ * Only regular files are copied in-process. The interactive shell ignores
+ * SIGINT and SIGTSTP, so a copy that may never end (a terminal, pipe or
+ * device such as /dev/zero) runs as the real cat, which C-c and C-z can
+ * stop. Missing files also fall back so cat reports them itself.
+ */
+static int fast_cat(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != '\0')
+            return FASTPATH_FALLBACK;
+    }
+    for (int i = 1; i < argc || (argc == 1 && i == 1); ++i)
+    {
+        struct stat st;
+        bool from_stdin = argc == 1 || strcmp(argv[i], "-") == 0;
+        if ((from_stdin ? fstat(STDIN_FILENO, &st) : stat(argv[i], &st)) != 0 || !S_ISREG(st.st_mode))
+            return FASTPATH_FALLBACK;
+    }
+
+    fflush(stdout);
+    int status = 0;
+    for (int i = 1; i < argc || (argc == 1 && i == 1); ++i)
+    {
+        bool from_stdin = argc == 1 || strcmp(argv[i], "-") == 0;
+        const char *name = from_stdin ? "-" : argv[i];
+        int fd = from_stdin ? STDIN_FILENO : open(name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || !copy_to_stdout(fd))
+        {
+            fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+            status = 1;
+        }
+        if (fd > STDIN_FILENO)
+            close(fd);
+        if (argc == 1)
+            break;
+    }
+    return status;
+}
+
+// -------------------------
+// ls
+// -------------------------
+
+/**
+ * @brief ls [-1aA] [dir]: one entry per line, when stdout is not a terminal.
+ *
+ * Terminal output (columns, colours) and every other option fall back to
+ * the real ls. Names are sorted with the user's collation (LC_COLLATE is
+ * loaded by main()), as ls does.
+ */
+static int fast_ls(int argc, char *argv[])
+{
+    if (isatty(STDOUT_FILENO))
+        return FASTPATH_FALLBACK;
+
+    bool all = false, almost_all = false;
+    const char *dir = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            for (const char *p = argv[i] + 1; *p; ++p)
+            {
+                if (*p == 'a')
+                    all = true;
+                else if (*p == 'A')
+                    almost_all = true;
+                else if (*p != '1')
+                    return FASTPATH_FALLBACK;
+            }
+        }
+        else if (dir)
+        {
+            return FASTPATH_FALLBACK; // Several operands print headers
+        }
+        else
+        {
+            dir = argv[i];
+        }
+    }
+
+    struct stat st;
+    if (dir && (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)))
+        return FASTPATH_FALLBACK; // Files and errors keep ls's exact output
+    DIR *d = opendir(dir ? dir : ".");
+    if (!d)
+        return FASTPATH_FALLBACK;
+
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(d))
+    {
+        const char *name = entry->d_name;
+        bool dot_or_dotdot = strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+        if (name[0] == '.' && !all && (!almost_all || dot_or_dotdot))
+            continue;
+        names.emplace_back(name);
+    }
+    closedir(d);
+
+    std::sort(names.begin(), names.end(),
+              [](const std::string &a, const std::string &b) { return strcoll(a.c_str(), b.c_str()) < 0; });
+    for (const auto &name : names)
+    {
+        fputs(name.c_str(), stdout);
+        fputc('\n', stdout);
+    }
+    return finish_output("ls");
+}
+
+// -------------------------
+// Fast Path Lookup
+// -------------------------
+
+struct FastPath {
+    const char *name;
+    FastPathHandler handler;
+};
+
+static const FastPath fast_paths[] = {
+    {"echo", fast_echo}, {"pwd", fast_pwd}, {"true", fast_true}, {"false", fast_false},
+    {"test", fast_test}, {"[", fast_test}, {"cat", fast_cat}, {"ls", fast_ls},
+};
+
+/**
+ * @brief Finds the in-process implementation of a command, if any.
+ *
+ * Setting JAM_NO_FASTPATH in the environment disables every fast path so
+ * the real executables always run. A command given by path (/bin/echo)
+ * never matches.
+ *
+ * @param name Command name as typed.
+ * @return Handler, or nullptr if the command must be executed.
+ */
+FastPathHandler find_fast_path(const char *name)
+{
+    static const bool disabled = getenv("JAM_NO_FASTPATH") != nullptr;
+    if (disabled)
+        return nullptr;
+    for (const auto &entry : fast_paths)
+    {
+        if (strcmp(entry.name, name) == 0)
+            return entry.handler;
+    }
+    return nullptr;
+}
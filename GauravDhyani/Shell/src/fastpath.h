@@ -0,0 +1,15 @@
+#ifndef FASTPATH_H
+#define FASTPATH_H
+
+// Returned by a fast path that cannot handle its arguments; the caller then
+// runs the real executable. Nothing has been written at that point.
+#define FASTPATH_FALLBACK -1
+
+// In-process replacement for a common external command. Writes to the
+// shell's stdout/stderr and reads its stdin, so the caller applies any
+// redirections to fds 0 and 1 around the call.
+typedef int (*FastPathHandler)(int argc, char *argv[]);
+
+FastPathHandler find_fast_path(const char *name);
+
+#endif // FASTPATH_H
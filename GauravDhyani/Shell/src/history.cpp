@@ -1,72 +1,761 @@
 #include "history.h"
 #include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
 #include <vector>
 #include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <readline/readline.h>
 
-#define HISTORY_FILE ".jam_history"
-#define MAX_HISTORY 100
+#define HISTORY_COMPACT_SLACK (64 * 1024) // File bytes beyond twice the kept commands before compacting
+#define HISTORY_HALF_LIFE (7 * 86400.0)   // Seconds after which a use counts half as much in the ranking
+#define HISTORY_INDEX_MIN_BITS 10         // log2 of the fewest trigram buckets in the search index
+#define HISTORY_INDEX_MAX_BITS 20         // log2 of the most
+#define HISTORY_BUCKETS_PER_COMMAND 4     // Buckets per distinct command before the table doubles
+#define HISTORY_SPARSE_POSTINGS 16384     // Longest trigram list worth checking instead of a ranked scan
+#define HISTORY_RERANK_AFTER 4096         // Commands used since the last sort before sorting again
+#define HISTORY_SEARCH_RESULTS 20         // Matches printed by `history -s`
 
+// -------------------------
+// Ring Buffer
+// -------------------------
+
+/**
+ * @brief Adds a command, overwriting the oldest one when the ring is full.
+ * @param id The command's id among the distinct commands.
+ * @param bytes Length of its line in the history file, newline included.
+ */
+void HistoryRing::push(uint32_t id, uint32_t bytes) {
+    total_bytes += bytes;
+    if (ids.size() < limit) {
+        ids.push_back(id);
+        line_bytes.push_back(bytes);
+        return;
+    }
+    total_bytes -= line_bytes[head];
+    ids[head] = id;
+    line_bytes[head] = bytes;
+    head = (head + 1) % limit;
+}
 
 // -------------------------
 // Internal History Storage
 // -------------------------
 
-static std::vector<std::string> history;
+static HistoryRing history;
+static std::string history_path;
+static int history_fd = -1;   // history_path opened with O_APPEND; -1 without a history file
+static size_t file_bytes = 0; // Size of the file when this shell last looked
+static size_t tail_bytes = 0; // Size of its last capacity() lines at load or the last compaction
+
+// Ranking of one distinct command. `rank` is the log of the sum over its uses
+// of 2^(time / HISTORY_HALF_LIFE): proportional to an exponentially decaying
+// use count at any moment, so uses only ever raise it and commands nobody
+// runs keep their relative order as time passes.
+struct CommandStats {
+    double rank;
+    uint32_t uses;
+};
+
+// Every distinct command seen, by id, and an open-addressed table finding
+// the id of a text. A slot holds the top half of the text's hash above
+// id + 1, so most probes are settled without touching the text; 0 is empty.
+static std::deque<std::string> command_texts;
+static std::vector<CommandStats> command_stats;
+static std::vector<uint64_t> command_slots;
+
+// Trigram index over the distinct commands and their order by rank, both
+// built at the first search and kept up to date from then on.
+struct SearchIndex {
+    std::vector<std::vector<uint32_t>> buckets; // Ids containing a trigram hashing there, ascending
+    unsigned bits = 0;                          // log2 of buckets.size()
+    uint32_t indexed = 0;                       // Commands below this id are in buckets
+    std::vector<uint32_t> ranked;               // Ids best first as of the last sort
+    std::vector<uint32_t> bumped;               // Ids used or added since the sort
+    std::vector<bool> is_bumped;
+    bool sorted = false;
+};
+
+static SearchIndex search_index;
+
+static double use_weight(int64_t when) {
+    return when * (M_LN2 / HISTORY_HALF_LIFE);
+}
+
+/**
+ * @brief Returns log(e^a + e^b) without overflowing.
+ */
+static double log_add(double a, double b) {
+    if (a < b)
+        std::swap(a, b);
+    return a + std::log1p(std::exp(b - a));
+}
+
+static void mark_bumped(uint32_t id) {
+    if (!search_index.sorted)
+        return;
+    if (search_index.is_bumped.size() <= id)
+        search_index.is_bumped.resize(id + 1);
+    if (search_index.is_bumped[id])
+        return;
+    search_index.is_bumped[id] = true;
+    search_index.bumped.push_back(id);
+}
+
+/**
+ * @brief Returns the slot holding `text`, or the empty slot where it belongs.
+ */
+static uint64_t &command_slot(std::string_view text, size_t hash) {
+    size_t mask = command_slots.size() - 1;
+    uint64_t tag = uint64_t(hash) >> 32 << 32;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t &slot = command_slots[i];
+        if (slot == 0 || ((slot >> 32 << 32) == tag && command_texts[uint32_t(slot) - 1] == text))
+            return slot;
+    }
+}
+
+/**
+ * @brief Doubles the table, keeping it at most half full.
+ */
+static void grow_command_slots() {
+    command_slots.assign(std::max<size_t>(1024, command_slots.size() * 2), 0);
+    for (uint32_t id = 0; id < command_texts.size(); ++id) {
+        size_t hash = std::hash<std::string_view>()(command_texts[id]);
+        command_slot(command_texts[id], hash) = uint64_t(hash) >> 32 << 32 | (id + 1);
+    }
+}
+
+/**
+ * @brief Counts one use of a command and returns its id.
+ * @param when Seconds since the epoch, or 0 if unknown.
+ */
+static uint32_t record_use(std::string_view command, int64_t when) {
+    if (2 * (command_texts.size() + 1) > command_slots.size())
+        grow_command_slots();
+    size_t hash = std::hash<std::string_view>()(command);
+    uint64_t &slot = command_slot(command, hash);
+    uint32_t id;
+    if (slot) {
+        id = uint32_t(slot) - 1;
+        CommandStats &stats = command_stats[id];
+        stats.rank = log_add(stats.rank, use_weight(when));
+        stats.uses++;
+    } else {
+        id = command_stats.size();
+        slot = uint64_t(hash) >> 32 << 32 | (id + 1);
+        command_texts.emplace_back(command);
+        command_stats.push_back({use_weight(when), 1});
+    }
+    mark_bumped(id);
+    return id;
+}
+
+/**
+ * @brief Splits a history file line into its command and timestamp.
+ *
+ * Lines are written as ": <epoch>:0;<command>", the format zsh uses for
+ * extended history; lines without that prefix are plain commands from older
+ * files and get time 0.
+ */
+static std::string_view parse_history_line(std::string_view line, int64_t &when) {
+    when = 0;
+    if (line.size() < 5 || line[0] != ':' || line[1] != ' ')
+        return line;
+    size_t i = 2;
+    int64_t seconds = 0;
+    while (i < line.size() && line[i] >= '0' && line[i] <= '9')
+        seconds = seconds * 10 + (line[i++] - '0');
+    if (i == 2 || i == line.size() || line[i++] != ':')
+        return line;
+    while (i < line.size() && line[i] >= '0' && line[i] <= '9')
+        ++i;
+    if (i == line.size() || line[i] != ';')
+        return line;
+    when = seconds;
+    return line.substr(i + 1);
+}
+
+static std::string format_history_line(std::string_view command, int64_t when) {
+    std::string line = ": " + std::to_string(when) + ":0;";
+    line += command;
+    line += '\n';
+    return line;
+}
+
+/**
+ * @brief Records a use of a command and adds it to the ring.
+ *
+ * A command repeating the one before it only counts towards its ranking, so
+ * the ring and navigation do not fill with runs of the same line. The file
+ * still gets every use, so the ranking is the same after a restart.
+ */
+static void remember_command(std::string_view command, int64_t when, uint32_t line_bytes) {
+    uint32_t id = record_use(command, when);
+    if (history.size() == 0 || history[history.size() - 1] != id)
+        history.push(id, line_bytes);
+}
+
+/**
+ * @brief Returns the history file path: $JAM_HISTFILE, else ~/.jam_history.
+ */
+static std::string history_file_path() {
+    const char *env = getenv("JAM_HISTFILE");
+    if (env && *env)
+        return env;
+    const char *home = getenv("HOME");
+    return home && *home ? std::string(home) + "/" + HISTORY_FILE : HISTORY_FILE;
+}
+
+/**
+ * @brief Returns the ring capacity: $JAM_HISTSIZE, else HISTORY_DEFAULT_CAPACITY.
+ */
+static size_t history_capacity() {
+    const char *env = getenv("JAM_HISTSIZE");
+    unsigned long size = env && *env ? strtoul(env, nullptr, 10) : HISTORY_DEFAULT_CAPACITY;
+    if (size == 0)
+        size = HISTORY_DEFAULT_CAPACITY;
+    return size < HISTORY_MAX_CAPACITY ? size : HISTORY_MAX_CAPACITY;
+}
+
+static int open_history_file() {
+    return open(history_path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+}
+
+/**
+ * @brief Whether history_fd is still the file at history_path.
+ *
+ * Compaction replaces the file by renaming a new one over it, so another
+ * shell's compaction leaves this shell's descriptor on the old file.
+ */
+static bool history_fd_current() {
+    struct stat open_st, path_st;
+    return fstat(history_fd, &open_st) == 0 && stat(history_path.c_str(), &path_st) == 0 &&
+           open_st.st_dev == path_st.st_dev && open_st.st_ino == path_st.st_ino;
+}
+
+/**
+ * @brief Locks the history file, reopening it if it was replaced meanwhile.
+ * @param operation LOCK_SH or LOCK_EX.
+ * @return false if there is no usable history file.
+ */
+static bool lock_history_file(int operation) {
+    for (int attempt = 0; attempt < 8 && history_fd >= 0; ++attempt) {
+        if (flock(history_fd, operation) != 0)
+            return false;
+        if (history_fd_current())
+            return true;
+        close(history_fd); // Also drops the lock on the replaced file
+        history_fd = open_history_file();
+    }
+    return false;
+}
+
+// The history file, memory-mapped.
+struct MappedHistory {
+    const char *data = nullptr;
+    size_t size = 0;
+
+    ~MappedHistory() {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+    }
+};
+
+/**
+ * @brief Maps the open history file.
+ * @return false if it could not be read; an empty file maps to nothing.
+ */
+static bool map_history_file(MappedHistory &map) {
+    struct stat st;
+    if (fstat(history_fd, &st) != 0)
+        return false;
+    file_bytes = st.st_size;
+    if (st.st_size == 0)
+        return true;
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, history_fd, 0);
+    if (base == MAP_FAILED) {
+        perror(history_path.c_str());
+        return false;
+    }
+    map.data = static_cast<const char *>(base);
+    map.size = st.st_size;
+    return true;
+}
+
+/**
+ * @brief Finds where the last `limit` non-empty lines of the file start.
+ *
+ * Scans backwards from the end, so only the part that is kept is read.
+ */
+static size_t tail_offset(const MappedHistory &map, size_t limit) {
+    const char *stop = map.data + map.size; // End of the line being looked at
+    size_t found = 0;
+    while (found < limit && stop > map.data) {
+        const char *newline = static_cast<const char *>(memrchr(map.data, '\n', stop - map.data));
+        const char *begin = newline ? newline + 1 : map.data;
+        if (stop > begin && ++found == limit)
+            return begin - map.data;
+        if (!newline)
+            break;
+        stop = newline;
+    }
+    return 0;
+}
+
+/**
+ * @brief Rewrites the history file with only its last capacity() commands.
+ *
+ * Runs under an exclusive lock, so appends from other shells wait and are
+ * kept; the new file is written beside the old one and renamed over it,
+ * so a crash leaves one or the other intact.
+ */
+static void compact_history_file() {
+    if (!lock_history_file(LOCK_EX))
+        return;
+    MappedHistory map;
+    if (!map_history_file(map)) {
+        flock(history_fd, LOCK_UN);
+        return;
+    }
+    size_t start = tail_offset(map, history.capacity());
+    size_t length = map.size - start;
+    bool newline = length == 0 || map.data[map.size - 1] == '\n';
+
+    std::string temp = history_path + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool written = fd >= 0 && write(fd, map.data + start, length) == ssize_t(length) &&
+                   (newline || write(fd, "\n", 1) == 1);
+    if (fd >= 0)
+        close(fd);
+    if (!written || rename(temp.c_str(), history_path.c_str()) != 0) {
+        perror(temp.c_str());
+        unlink(temp.c_str());
+        flock(history_fd, LOCK_UN);
+        return;
+    }
+    close(history_fd);
+    history_fd = open_history_file();
+    file_bytes = tail_bytes = length + !newline;
+}
+
+/**
+ * @brief Compacts the file once it holds more than twice what it would keep.
+ *
+ * The file only grows by one line per command, so this happens about every
+ * capacity() commands and costs O(1) per command amortized.
+ */
+static void compact_if_needed() {
+    size_t kept = std::max(history.bytes(), tail_bytes);
+    if (history_fd >= 0 && file_bytes > 2 * kept + HISTORY_COMPACT_SLACK)
+        compact_history_file();
+}
+
+// -------------------------
+// Search Index
+// -------------------------
+
+static inline uint32_t trigram_bucket(const char *p, unsigned bits) {
+    uint32_t gram = uint32_t(uint8_t(p[0])) << 16 | uint32_t(uint8_t(p[1])) << 8 | uint8_t(p[2]);
+    return (gram * 0x9E3779B1u) >> (32 - bits);
+}
+
+/**
+ * @brief Brings the index up to date with the commands seen so far.
+ *
+ * New commands get ids above every indexed one, so each posting list stays
+ * sorted and a command appears in a list at most once however often the
+ * trigram occurs in it. The bucket table is sized from the number of
+ * distinct commands and rebuilt at twice the size or more when it falls
+ * short, so a small history costs little memory. The ranking is sorted
+ * again once enough commands have moved that scanning them separately
+ * would cost more.
+ */
+static void update_search_index() {
+    SearchIndex &index = search_index;
+    unsigned bits = HISTORY_INDEX_MIN_BITS;
+    size_t wanted = command_texts.size() * HISTORY_BUCKETS_PER_COMMAND;
+    while (bits < HISTORY_INDEX_MAX_BITS && (size_t(1) << bits) < wanted)
+        ++bits;
+    if (bits > index.bits) {
+        index.buckets.clear();
+        index.buckets.resize(size_t(1) << bits);
+        index.bits = bits;
+        index.indexed = 0;
+    }
+    for (uint32_t id = index.indexed; id < command_texts.size(); ++id) {
+        const std::string &text = command_texts[id];
+        for (size_t i = 0; i + 3 <= text.size(); ++i) {
+            std::vector<uint32_t> &list = index.buckets[trigram_bucket(text.data() + i, index.bits)];
+            if (list.empty() || list.back() != id)
+                list.push_back(id);
+        }
+    }
+    index.indexed = command_texts.size();
+
+    if (index.sorted && index.bumped.size() <= HISTORY_RERANK_AFTER)
+        return;
+    auto better = [](uint32_t a, uint32_t b) {
+        return command_stats[a].rank > command_stats[b].rank;
+    };
+    if (!index.sorted) {
+        index.ranked.resize(command_stats.size());
+        for (uint32_t id = 0; id < index.ranked.size(); ++id)
+            index.ranked[id] = id;
+        std::sort(index.ranked.begin(), index.ranked.end(), better);
+    } else {
+        // Only the bumped commands moved: sort those and merge them back in.
+        index.ranked.erase(std::remove_if(index.ranked.begin(), index.ranked.end(),
+                                          [&](uint32_t id) { return index.is_bumped[id]; }),
+                           index.ranked.end());
+        std::sort(index.bumped.begin(), index.bumped.end(), better);
+        size_t middle = index.ranked.size();
+        index.ranked.insert(index.ranked.end(), index.bumped.begin(), index.bumped.end());
+        std::inplace_merge(index.ranked.begin(), index.ranked.begin() + middle, index.ranked.end(), better);
+    }
+    index.bumped.clear();
+    index.is_bumped.assign(command_stats.size(), false);
+    index.sorted = true;
+}
+
+/**
+ * @brief Finds distinct commands containing `query`, highest ranked first.
+ *
+ * A query of three bytes or more is looked up by its rarest trigram, and
+ * only the commands listed there are checked. Shorter queries, or ones
+ * made only of common trigrams, scan commands in rank order instead and
+ * stop after `limit` matches, which for such queries come early.
+ *
+ * @param query Substring to look for; empty matches every command.
+ * @param limit Most matches to return.
+ * @param matches Receives the matches, replacing its contents.
+ */
+void search_history(std::string_view query, size_t limit, std::vector<HistoryMatch> &matches) {
+    matches.clear();
+    if (limit == 0)
+        return;
+    update_search_index();
+    const SearchIndex &index = search_index;
+    auto contains = [&](uint32_t id) {
+        return std::string_view(command_texts[id]).find(query) != std::string_view::npos;
+    };
+    auto better = [](uint32_t a, uint32_t b) {
+        return command_stats[a].rank > command_stats[b].rank;
+    };
+
+    std::vector<uint32_t> found;
+    const std::vector<uint32_t> *rarest = nullptr;
+    for (size_t i = 0; i + 3 <= query.size(); ++i) {
+        const std::vector<uint32_t> &list = index.buckets[trigram_bucket(query.data() + i, index.bits)];
+        if (!rarest || list.size() < rarest->size())
+            rarest = &list;
+    }
+    if (rarest && rarest->size() <= HISTORY_SPARSE_POSTINGS) {
+        for (uint32_t id : *rarest)
+            if (contains(id))
+                found.push_back(id);
+    } else {
+        // Commands not bumped since the sort still have the rank they were
+        // sorted by, so the first `limit` matches among them are their best.
+        for (uint32_t id : index.bumped)
+            if (contains(id))
+                found.push_back(id);
+        size_t taken = 0;
+        for (uint32_t id : index.ranked) {
+            if (index.is_bumped[id] || !contains(id))
+                continue;
+            found.push_back(id);
+            if (++taken == limit)
+                break;
+        }
+    }
+
+    size_t count = std::min(limit, found.size());
+    std::partial_sort(found.begin(), found.begin() + count, found.end(), better);
+    for (size_t i = 0; i < count; ++i)
+        matches.push_back({&command_texts[found[i]], command_stats[found[i]].uses});
+}
+
+// -------------------------
+// Line Editing
+// -------------------------
+
+// Where up/down navigation is. Positions index the ring; history.size()
+// stands for the line being typed, which is kept in nav_pending.
+static size_t nav_position = 0;
+static std::string nav_pending;
+static std::vector<size_t> nav_trail;          // Positions shown on the way up
+static std::unordered_set<uint32_t> nav_shown; // Commands among them
+
+static void show_line(const std::string &text) {
+    rl_replace_line(text.c_str(), 0);
+    rl_point = rl_end;
+}
+
+/**
+ * @brief Moves to the previous command not already shown since navigation began.
+ */
+static int history_previous(int, int) {
+    if (nav_trail.empty())
+        nav_pending.assign(rl_line_buffer, rl_end);
+    size_t position = nav_position;
+    while (position > 0 && nav_shown.count(history[position - 1]))
+        --position;
+    if (position == 0) {
+        rl_ding();
+        return 0;
+    }
+    nav_trail.push_back(nav_position);
+    nav_position = position - 1;
+    nav_shown.insert(history[nav_position]);
+    show_line(command_texts[history[nav_position]]);
+    return 0;
+}
+
+/**
+ * @brief Moves back down towards the line being typed.
+ */
+static int history_next(int, int) {
+    if (nav_trail.empty()) {
+        rl_ding();
+        return 0;
+    }
+    nav_shown.erase(history[nav_position]);
+    nav_position = nav_trail.back();
+    nav_trail.pop_back();
+    show_line(nav_trail.empty() ? nav_pending : command_texts[history[nav_position]]);
+    return 0;
+}
+
+/**
+ * @brief Incremental reverse search over the distinct commands (C-r).
+ *
+ * Each key typed narrows the query and shows the highest ranked command
+ * containing it; C-r again steps to the next match, C-g restores the line,
+ * and any other key accepts the match and then does what it normally does.
+ */
+static int reverse_search(int, int) {
+    std::string original(rl_line_buffer, rl_end);
+    int original_point = rl_point;
+    std::string query;
+    size_t nth = 0;
+    std::vector<HistoryMatch> matches;
+    std::string prompt = rl_prompt ? rl_prompt : "";
+
+    for (;;) {
+        search_history(query, nth + 1, matches);
+        bool failed = matches.size() <= nth;
+        if (failed && nth > 0) {
+            nth = matches.size() ? matches.size() - 1 : 0;
+            rl_ding();
+        }
+        const std::string &shown = matches.empty() ? original : *matches[nth].command;
+        rl_set_prompt(((failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`") + query + "': ").c_str());
+        rl_replace_line(shown.c_str(), 0);
+        size_t at = shown.find(query);
+        rl_point = at == std::string::npos ? rl_end : int(at);
+        rl_redisplay();
+
+        int key = rl_read_key();
+        if (key == CTRL('R')) {
+            if (!failed)
+                ++nth;
+        } else if (key == CTRL('G')) {
+            rl_replace_line(original.c_str(), 0);
+            rl_point = original_point;
+            break;
+        } else if (key == RUBOUT || key == CTRL('H')) {
+            if (!query.empty())
+                query.pop_back();
+            nth = 0;
+        } else if (key >= ' ') {
+            query += char(key);
+            nth = 0;
+        } else {
+            rl_execute_next(key);
+            break;
+        }
+    }
+    rl_set_prompt(prompt.c_str());
+    rl_redisplay();
+    return 0;
+}
+
+/**
+ * @brief Runs before each line is read; resets navigation to the new line.
+ *
+ * The first call also binds the history keys, after readline has read
+ * ~/.inputrc, so the shell's history is what the arrows walk.
+ */
+static int history_line_start() {
+    static bool bound = false;
+    if (!bound) {
+        bound = true;
+        rl_bind_keyseq("\\e[A", history_previous);
+        rl_bind_keyseq("\\eOA", history_previous);
+        rl_bind_keyseq("\\e[B", history_next);
+        rl_bind_keyseq("\\eOB", history_next);
+        rl_bind_key(CTRL('P'), history_previous);
+        rl_bind_key(CTRL('N'), history_next);
+        rl_bind_key(CTRL('R'), reverse_search);
+    }
+    nav_position = history.size();
+    nav_pending.clear();
+    nav_trail.clear();
+    nav_shown.clear();
+    return 0;
+}
 
 // -------------------------
 // History Management
 // -------------------------
 
 /**
- * @brief Adds a command to the history.
- * 
- * If the history exceeds the MAX_HISTORY limit, the oldest entry is removed.
- * 
+ * @brief Adds a command to the history and appends it to the history file.
+ *
+ * The line goes out in one O_APPEND write under a shared lock, so it is on
+ * disk as soon as the command is entered and concurrent shells interleave
+ * whole lines rather than overwrite each other.
+ *
  * @param command The command string to be added to the history.
  */
 void add_to_history(const char* command) {
-    if (history.size() >= MAX_HISTORY) {
-        history.erase(history.begin());
+    int64_t now = time(nullptr);
+    std::string line = format_history_line(command, now);
+    remember_command(command, now, line.size());
+    if (!lock_history_file(LOCK_SH))
+        return;
+    if (write(history_fd, line.data(), line.size()) != ssize_t(line.size()))
+        perror(history_path.c_str());
+    struct stat st;
+    if (fstat(history_fd, &st) == 0)
+        file_bytes = st.st_size;
+    flock(history_fd, LOCK_UN);
+    compact_if_needed();
+}
+
+/**
+ * @brief Prints the last `count` commands with their numbers.
+ */
+static void print_recent(size_t count) {
+    std::string out;
+    for (size_t i = history.size() - std::min(count, history.size()); i < history.size(); ++i) {
+        out += std::to_string(i + 1);
+        out += ": ";
+        out += command_texts[history[i]];
+        out += '\n';
+        if (out.size() >= 65536) {
+            std::cout << out;
+            out.clear();
+        }
     }
-    history.push_back(command);
+    std::cout << out;
 }
 
 /**
  * @brief Prints the current command history to the console.
  */
 void print_history() {
-    for (size_t i = 0; i < history.size(); ++i) {
-        std::cout << i + 1 << ": " << history[i] << "\n";
-    }
+    print_recent(history.size());
 }
 
+/**
+ * @brief Handles the `history` builtin.
+ *
+ * `history` lists every command, `history N` the last N, and
+ * `history -s TEXT...` the distinct commands containing TEXT, most
+ * frequently and recently used first, with their use counts.
+ */
+int handle_history_command(int token_count, char *tokens[]) {
+    if (token_count >= 2 && strcmp(tokens[1], "-s") == 0) {
+        std::string query;
+        for (int i = 2; i < token_count; ++i) {
+            if (i > 2)
+                query += ' ';
+            query += tokens[i];
+        }
+        std::vector<HistoryMatch> matches;
+        search_history(query, HISTORY_SEARCH_RESULTS, matches);
+        for (const HistoryMatch &match : matches)
+            printf("%6u  %s\n", match.uses, match.command->c_str());
+        return 0;
+    }
+    if (token_count > 2) {
+        std::cerr << "Usage: history [N] | history -s <text>\n";
+        return 1;
+    }
+    if (token_count == 2) {
+        char *end;
+        unsigned long count = strtoul(tokens[1], &end, 10);
+        if (*tokens[1] == '\0' || *end != '\0') {
+            std::cerr << "history: " << tokens[1] << ": numeric argument required\n";
+            return 1;
+        }
+        print_recent(count);
+        return 0;
+    }
+    print_history();
+    return 0;
+}
 
 /**
  * @brief Loads command history from the persistent history file.
- * 
- * Reads each line from HISTORY_FILE and adds it to the in-memory history vector.
+ *
+ * The ring holds $JAM_HISTSIZE commands; the file stays open for appends
+ * until save_history(). Readline's own history list is not used: the
+ * arrow keys and C-r are bound to this one.
  */
 void load_history() {
-    std::ifstream file(HISTORY_FILE);
-    std::string line;
-    while (getline(file, line)) {
-        if (!line.empty()) {
-            history.push_back(line);
+    history = HistoryRing(history_capacity());
+    history_path = history_file_path();
+    rl_startup_hook = history_line_start;
+    history_fd = open_history_file();
+    if (history_fd < 0) {
+        perror(history_path.c_str());
+        return;
+    }
+    if (lock_history_file(LOCK_SH)) {
+        MappedHistory map;
+        if (map_history_file(map)) {
+            const char *p = map.data + tail_offset(map, history.capacity());
+            const char *end = map.data + map.size;
+            tail_bytes = end - p;
+            while (p < end) {
+                const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+                const char *stop = newline ? newline : end;
+                if (stop > p) {
+                    int64_t when;
+                    std::string_view command = parse_history_line(std::string_view(p, stop - p), when);
+                    if (!command.empty())
+                        remember_command(command, when, stop - p + 1);
+                }
+                p = stop + 1;
+            }
         }
+        flock(history_fd, LOCK_UN);
     }
-    file.close();
+    compact_if_needed();
 }
 
 /**
- * @brief Saves the current in-memory command history to a persistent file.
- * 
- * Writes each command from the history vector into HISTORY_FILE.
+ * @brief Finishes with the history file at exit.
+ *
+ * Every command is already on disk; this only compacts the file if it is
+ * due and closes it.
  */
 void save_history() {
-    std::ofstream file(HISTORY_FILE);
-    for (const auto& cmd : history) {
-        file << cmd << "\n";
-    }
-    file.close();
+    compact_if_needed();
+    if (history_fd >= 0)
+        close(history_fd);
+    history_fd = -1;
 }
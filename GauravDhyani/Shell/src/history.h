@@ -1,9 +1,48 @@
 #ifndef HISTORY_H
 #define HISTORY_H
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define HISTORY_FILE ".jam_history"      // In $HOME unless JAM_HISTFILE names another file
+#define HISTORY_DEFAULT_CAPACITY 10000   // Commands kept unless JAM_HISTSIZE says otherwise
+#define HISTORY_MAX_CAPACITY (1 << 24)
+
+// The most recent commands in a fixed number of slots, as ids of distinct
+// commands. Once full, a new command overwrites the oldest in O(1); slots
+// are allocated as they are first used, so a large capacity costs nothing
+// until it fills.
+class HistoryRing {
+public:
+    explicit HistoryRing(size_t capacity = HISTORY_DEFAULT_CAPACITY) : limit(capacity) {}
+    void push(uint32_t id, uint32_t line_bytes);
+    size_t size() const { return ids.size(); }
+    size_t capacity() const { return limit; }
+    size_t bytes() const { return total_bytes; } // Of the entries as history file lines
+    uint32_t operator[](size_t i) const { return ids[(head + i) % ids.size()]; } // 0 is oldest
+
+private:
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> line_bytes;
+    size_t limit;
+    size_t head = 0; // Slot of the oldest command once full
+    size_t total_bytes = 0;
+};
+
+// A distinct command found by search_history().
+struct HistoryMatch {
+    const std::string *command;
+    uint32_t uses;
+};
+
 void add_to_history(const char* command);
 void print_history();
+void search_history(std::string_view query, size_t limit, std::vector<HistoryMatch> &matches);
 void load_history();
 void save_history();
+int handle_history_command(int token_count, char *tokens[]);
 
 #endif // HISTORY_H
@@ -12,6 +12,15 @@
 #include <string.h>
 #include "./include/json.hpp"
 #include <regex> 
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cerrno>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <map>
 using json = nlohmann::json;
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +33,9 @@ extern "C" {
 #ifdef __cplusplus
 }
 #endif
+#include "modcache.h"
+#include "wildcard.h"
+#include "jobs.h"
 // -
 // Constants and Globals
 // -
@@ -338,209 +350,454 @@ void run_jambo() {
 }
 
 // -
-// Lexer Analysis Function
+// Analysis Helpers
 // -
 
 /**
- * @brief Analyzes the lexical tokens of the given source file.
- * 
- * Opens the file, reads source code, runs the lexer to produce tokens,
- * prints tokens, sends lexer output and source code to Groq API for analysis,
- * and prints the API response.
+ * @brief Reads a whole JAM source file into a NUL-terminated buffer.
  * 
- * @param filename Path to the source file to analyze.
+ * @param filename Path to the source file.
+ * @return char* File contents (malloc'ed, must be freed), or NULL on error.
  */
-void analyse_lexer(const char* filename) {
+static char* read_source_file(const char* filename) {
     FILE* file = fopen(filename, "r");
-    if (!file) { perror("Script open error"); return; }
+    if (!file) { perror("Script open error"); return NULL; }
     fseek(file, 0, SEEK_END);
     long size = ftell(file);
     rewind(file);
     char* source_code = (char*)malloc(size + 1);
-    fread(source_code, 1, size, file);
-    source_code[size] = '\0';
+    size_t n = fread(source_code, 1, size, file);
+    source_code[n] = '\0';
     fclose(file);
+    return source_code;
+}
+
+/**
+ * @brief Sends analysis output and source code to the Groq API and pretty prints JAMBO's reply.
+ * 
+ * @param stage    Name of the analysis stage, e.g. "Lexer".
+ * @param analysis Output produced by the analysis.
+ * @param filename Path to the analysed source file.
+ */
+static void ask_jambo(const char* stage, const std::string& analysis, const char* filename) {
+    char* source_code = read_source_file(filename);
+    if (!source_code) return;
+    std::string groq_input = std::string("Debug ") + stage + " analysis of file:\n" + analysis + "\n\nSource code:\n" + source_code;
+    free(source_code);
 
-    std::stringstream output;
-    initlexer(source_code);
-    output << "Tokens:\n";
-    while (1) {
-        Token* t = get_next_token();
-        output << "Token(type=" << (int)t->type << ", lexeme='" << t->lexeme
-               << "', line=" << t->line << ", col=" << t->col << ")\n";
-        if (t->type == TOKEN_EOF) {
-            free(t->lexeme);
-            free(t);
-            break;
-        }
-        free(t->lexeme);
-        free(t);
-    }
-    std::cout << "\n===== Lexer Output =====\n" << output.str() << std::endl;
-    std::string groq_input = "Debug Lexer analysis of file:\n" + output.str() + "\n\nSource code:\n" + source_code;
     std::string response = callGroqAPI(groq_input);
-     try {
-            // Sanitize the raw response JSON string
-            std::string sanitizedResponse = sanitizeResponse(response);
+    try {
+        // Sanitize the raw response JSON string
+        std::string sanitizedResponse = sanitizeResponse(response);
 
-            // Parse the sanitized JSON
-            auto jsonResponse = json::parse(sanitizedResponse);
+        // Parse the sanitized JSON
+        auto jsonResponse = json::parse(sanitizedResponse);
 
-            // Extract message content
-            std::string reply = jsonResponse["choices"][0]["message"]["content"];
+        // Extract message content
+        std::string reply = jsonResponse["choices"][0]["message"]["content"];
 
-            // Pretty print the reply
-            std::cout << "\n\033[1;32mJAMBO:\033[0m\n";
-            sanitizeAndPrettyPrintResponse(reply);
+        // Pretty print the reply
+        std::cout << "\n\033[1;32mJAMBO:\033[0m\n";
+        sanitizeAndPrettyPrintResponse(reply);
 
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to parse response:\n" << response << "\n";
-            std::cerr << "Error: " << e.what() << "\n";
-        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to parse response:\n" << response << "\n";
+        std::cerr << "Error: " << e.what() << "\n";
+    }
+}
 
-    free(source_code);
+/**
+ * @brief Prints the modules imported (transitively) by an analysed file.
+ * 
+ * @param modules Module graph as returned by load_module_graph(), root first.
+ */
+static void print_module_imports(const std::vector<std::shared_ptr<const JamModule>>& modules) {
+    if (modules.size() < 2) return;
+    std::cout << "===== Imports =====\n";
+    for (size_t i = 1; i < modules.size(); ++i) {
+        std::cout << modules[i]->path << " (" << modules[i]->token_count - 1 << " tokens)\n";
+    }
+    std::cout << std::endl;
 }
 
 // -
-// Parser Analysis Function
+// Lexer Analysis Function
 // -
 
 /**
- * @brief Analyzes the parser AST of the given source file.
+ * @brief Analyzes the lexical tokens of the given source file.
  * 
- * Reads source code, tokenizes it, parses to an AST,
- * captures the AST print output, sends it with source code to Groq API,
- * then prints the API response.
+ * Loads the file through the module cache, prints the tokens and the
+ * modules it imports (which are named, not loaded), sends lexer output and
+ * source code to Groq API for analysis, and prints the API response.
  * 
  * @param filename Path to the source file to analyze.
+ * @param with_ai  Whether to ask the Groq API about the result.
+ * @return int 0 on success, 1 if the file cannot be read.
  */
-void analyse_parser(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) { perror("Script open error"); return; }
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    rewind(file);
-    char* source_code = (char*)malloc(size + 1);
-    fread(source_code, 1, size, file);
-    source_code[size] = '\0';
-    fclose(file);
+int analyse_lexer(const char* filename, bool with_ai) {
+    auto module = load_module(filename);
+    if (!module) return 1;
 
-    initlexer(source_code);
-    Token** tokens = NULL;
-    int count = 0, cap = 0;
-    while (1) {
-        Token* t = get_next_token();
-        if (count == cap) {
-            cap = cap ? cap * 2 : 8;
-            tokens = (Token**)realloc(tokens, cap * sizeof(Token*));
-        }
-        tokens[count++] = t;
-        if (t->type == TOKEN_EOF) break;
+    std::stringstream output;
+    output << "Tokens:\n";
+    for (int i = 0; i < module->token_count; ++i) {
+        const Token* t = module->tokens[i];
+        output << "Token(type=" << (int)t->type << ", lexeme='" << t->lexeme
+               << "', line=" << t->line << ", col=" << t->col << ")\n";
+    }
+    std::cout << "\n===== Lexer Output =====\n" << output.str() << std::endl;
+    if (!module->imports.empty()) {
+        std::cout << "===== Imports =====\n";
+        for (const auto& path : module->imports) std::cout << path << "\n";
+        std::cout << std::endl;
     }
+    if (with_ai) {
+        ask_jambo("Lexer", output.str(), filename);
+    }
+    return 0;
+}
 
-    Parser parser;
-    initParser(&parser, tokens, count);
-    ASTNode* ast = parseProgram(&parser);
+// -
+// Parser Analysis Function
+// -
+
+/**
+ * @brief Analyzes the parser AST of the given source file.
+ * 
+ * Loads the file and its imports through the module cache (parsing only
+ * what changed), captures the AST print output, sends it with source code
+ * to Groq API, then prints the API response.
+ * 
+ * @param filename Path to the source file to analyze.
+ * @param with_ai  Whether to ask the Groq API about the result.
+ * @return int 0 on success, 1 if the file cannot be read or parsed.
+ */
+int analyse_parser(const char* filename, bool with_ai) {
+    auto modules = load_module_graph(filename);
+    if (modules.empty()) return 1;
 
     // Capture printAST output
-    PrintASTArgs args = { ast, nullptr };
+    PrintASTArgs args = { modules[0]->ast, nullptr };
     char* captured_output = capture_stdout_output(printAST_to_stdout, &args);
 
-    freeAST(ast);
-    for (int i = 0; i < count; i++) {
-        free(tokens[i]->lexeme);
-        free(tokens[i]);
-    }
-    free(tokens);
     std::cout << "\n===== Parser Output =====\n" << captured_output << std::endl;
-    std::string groq_input = std::string("Debug Parser analysis of file:\n") + (captured_output ? captured_output : "") + "\n\nSource code:\n" + source_code;
-    std::string response = callGroqAPI(groq_input);
-     try {
-            // Sanitize the raw response JSON string
-            std::string sanitizedResponse = sanitizeResponse(response);
+    print_module_imports(modules);
+    if (with_ai) {
+        ask_jambo("Parser", captured_output ? captured_output : "", filename);
+    }
 
-            // Parse the sanitized JSON
-            auto jsonResponse = json::parse(sanitizedResponse);
+    free(captured_output);
+    return modules[0]->ast ? 0 : 1;
+}
 
-            // Extract message content
-            std::string reply = jsonResponse["choices"][0]["message"]["content"];
+// -
+// Semantic Analysis Function
+// -
 
-            // Pretty print the reply
-            std::cout << "\n\033[1;32mJAMBO:\033[0m\n";
-            sanitizeAndPrettyPrintResponse(reply);
+/**
+ * @brief Runs semantic analysis on the given source file.
+ * 
+ * @param filename Path to the source file to analyze.
+ * @param with_ai  Whether to ask the Groq API about the result.
+ * @return int 0 on success, 1 if the file cannot be read or parsed.
+ */
+int analyse_semantics(const char* filename, bool with_ai) {
+    auto modules = load_module_graph(filename);
+    if (modules.empty()) return 1;
 
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to parse response:\n" << response << "\n";
-            std::cerr << "Error: " << e.what() << "\n";
-        }
+    // Capture debugTraverse output
+    DebugTraverseArgs args = { modules[0]->ast };
+    char* captured_output = capture_stdout_output(debugTraverse_to_stdout, &args);
+
+    std::cout << "\n=====  Semantic Analyser Output =====\n" << captured_output << std::endl;
+    print_module_imports(modules);
+    if (with_ai) {
+        ask_jambo("Semantic", captured_output ? captured_output : "", filename);
+    }
 
-    free(source_code);
     free(captured_output);
+    return modules[0]->ast ? 0 : 1;
 }
 
 // -
-// Semantic Analysis Function
+// Batch Analysis
 // -
-void analyse_semantics(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) { perror("Script open error"); return; }
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    rewind(file);
-    char* source_code = (char*)malloc(size + 1);
-    fread(source_code, 1, size, file);
-    source_code[size] = '\0';
-    fclose(file);
 
-    initlexer(source_code);
-    Token** tokens = NULL;
-    int count = 0, cap = 0;
-    while (1) {
-        Token* t = get_next_token();
-        if (count == cap) {
-            cap = cap ? cap * 2 : 8;
-            tokens = (Token**)realloc(tokens, cap * sizeof(Token*));
+/**
+ * @brief Outcome of analysing one file in a batch run.
+ */
+struct JamboBatchResult {
+    std::string file;
+    std::string output;
+    int status = 0;
+    double ms = 0;
+    pid_t pid = -1;
+    int fd = -1;  // Read end of the child's output pipe while it runs
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Expands batch arguments into a sorted, de-duplicated list of JAM files.
+ * 
+ * Wildcard and brace patterns are expanded with the shell's own matcher
+ * (see wildcard.cpp), so "**" works too, and directories are searched
+ * recursively for ".jam" files.
+ * 
+ * @param args Files, directories or wildcard patterns.
+ * @return std::vector<std::string> Files to analyse, in path order.
+ */
+static std::vector<std::string> collect_batch_files(const std::vector<std::string>& args) {
+    std::vector<std::string> paths;
+    GlobCache cache;
+    for (const auto& arg : args) {
+        expand_glob(arg, cache, paths);
+    }
+
+    std::vector<std::string> files;
+    for (const auto& path : paths) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(path, ec)) {
+            files.push_back(path);
+            continue;
+        }
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(path, options, ec)) {
+            if (entry.is_regular_file(ec) && entry.path().extension() == ".jam") {
+                files.push_back(entry.path().string());
+            }
         }
-        tokens[count++] = t;
-        if (t->type == TOKEN_EOF) break;
     }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+    return files;
+}
 
-    Parser parser;
-    initParser(&parser, tokens, count);
-    ASTNode* ast = parseProgram(&parser);
+/**
+ * @brief Loads the modules imported by more than one batch file before any child is forked.
+ * 
+ * Children inherit the filled cache, so a shared import is parsed once
+ * instead of once per importer. Everything else is parsed in the children,
+ * in parallel and away from the shell. Imports are found by a text scan, so
+ * no batch file is lexed here. Anything printed while loading a shared
+ * module (unresolved imports, parse errors) starts the output of each file
+ * that imports it.
+ * 
+ * @param mode    Analysis mode; the lexer ('l') never loads imports.
+ * @param results Batch entries; receive the loading output.
+ */
+static void preload_shared_imports(char mode, std::vector<JamboBatchResult>& results) {
+    if (mode == 'l') return;
+
+    std::map<std::string, std::vector<size_t>> importers;
+    for (size_t i = 0; i < results.size(); ++i) {
+        for (const auto& path : scan_module_imports(results[i].file)) {
+            auto& files = importers[path];
+            if (files.empty() || files.back() != i) files.push_back(i);
+        }
+    }
 
-    // Capture debugTraverse output
-    DebugTraverseArgs args = { ast };
-    char* captured_output = capture_stdout_output(debugTraverse_to_stdout, &args);
+    for (const auto& [path, files] : importers) {
+        if (files.size() < 2) continue;
+        std::cout.flush();
+        fflush(stdout);
+        fflush(stderr);
+        FILE* log = tmpfile();
+        int saved_out = -1, saved_err = -1;
+        if (log) {
+            saved_out = dup(STDOUT_FILENO);
+            saved_err = dup(STDERR_FILENO);
+            dup2(fileno(log), STDOUT_FILENO);
+            dup2(fileno(log), STDERR_FILENO);
+        }
 
-    freeAST(ast);
-    for (int i = 0; i < count; i++) {
-        free(tokens[i]->lexeme);
-        free(tokens[i]);
+        load_module_graph(path);
+
+        if (log) {
+            std::cout.flush();
+            fflush(stdout);
+            fflush(stderr);
+            dup2(saved_out, STDOUT_FILENO);
+            dup2(saved_err, STDERR_FILENO);
+            close(saved_out);
+            close(saved_err);
+            rewind(log);
+            std::string output;
+            char buffer[4096];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), log)) > 0) output.append(buffer, n);
+            fclose(log);
+            for (size_t i : files) results[i].output += output;
+        }
     }
-    free(tokens);
-    std::cout << "\n=====  Semantic Analyser Output =====\n" << captured_output << std::endl;
-    std::string groq_input = std::string("Debug Semantic analysis of file:\n") + (captured_output ? captured_output : "") + "\n\nSource code:\n" + source_code;
-    std::string response = callGroqAPI(groq_input);
-     try {
-            // Sanitize the raw response JSON string
-            std::string sanitizedResponse = sanitizeResponse(response);
+}
 
-            // Parse the sanitized JSON
-            auto jsonResponse = json::parse(sanitizedResponse);
+/**
+ * @brief Starts one analysis in a forked child whose output goes to a pipe.
+ * 
+ * The JAM lexer keeps global state and the AST printers write straight to
+ * stdout, so each file is analysed in its own process rather than a thread.
+ * Children are only ever forked from the single-threaded shell, and each
+ * pipe's write end is closed right after its fork, so no child holds a
+ * sibling's pipe open.
+ * 
+ * @param analyse Analysis function to run.
+ * @param result  Batch entry holding the filename; receives pid and pipe, or the error.
+ * @return true if the child is running.
+ */
+static bool start_isolated_analysis(int (*analyse)(const char*, bool), JamboBatchResult& result) {
+    result.start = std::chrono::steady_clock::now();
+    int pipefd[2];
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        result.output = std::string("pipe: ") + strerror(errno) + "\n";
+        result.status = -1;
+        return false;
+    }
 
-            // Extract message content
-            std::string reply = jsonResponse["choices"][0]["message"]["content"];
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        dup2(pipefd[1], STDERR_FILENO);
+        if (access(result.file.c_str(), R_OK) != 0) {
+            perror("Script open error");
+            _exit(1);
+        }
+        int status = analyse(result.file.c_str(), false);
+        std::cout.flush();
+        fflush(stdout);
+        _exit(status);
+    }
+    close(pipefd[1]);
 
-            // Pretty print the reply
-            std::cout << "\n\033[1;32mJAMBO:\033[0m\n";
-            sanitizeAndPrettyPrintResponse(reply);
+    if (pid < 0) {
+        result.output = std::string("fork: ") + strerror(errno) + "\n";
+        result.status = -1;
+        close(pipefd[0]);
+        return false;
+    }
+    result.pid = pid;
+    result.fd = pipefd[0];
+    return true;
+}
 
-        } catch (const std::exception& e) {
-            std::cerr << "Failed to parse response:\n" << response << "\n";
-            std::cerr << "Error: " << e.what() << "\n";
+/**
+ * @brief Reads what a running analysis has printed; reaps the child at EOF.
+ * 
+ * @param result Batch entry of a running child.
+ * @return true once the child has finished.
+ */
+static bool drain_isolated_analysis(JamboBatchResult& result) {
+    char buffer[16384];
+    ssize_t n = read(result.fd, buffer, sizeof(buffer));
+    if (n > 0) {
+        result.output.append(buffer, n);
+        return false;
+    }
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return false;
+
+    close(result.fd);
+    result.fd = -1;
+    int status = 0;
+    struct rusage usage = {};
+    while (wait4(result.pid, &status, 0, &usage) < 0 && errno == EINTR) {}
+    account_child_usage(usage);
+    result.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    result.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - result.start).count();
+    return true;
+}
+
+/**
+ * @brief Analyses many JAM files in parallel and prints an aggregated report.
+ * 
+ * The shell first loads the imports shared by several files into its module
+ * cache, then analyses up to @p jobs files at once, each in an isolated
+ * child process that inherits the cache and whose output is collected with
+ * poll(). Output is
+ * reported per file in path order, followed by the collected diagnostics
+ * and per-file timings. The Groq API is never called in batch mode.
+ * 
+ * @param mode  Analysis to run: 'l' (lexer), 'p' (parser) or 's' (semantics).
+ * @param args  Files, directories or wildcard patterns to analyse.
+ * @param jobs  Number of files analysed at once.
+ * @return int Number of files whose analysis failed.
+ */
+int run_jambo_batch(char mode, const std::vector<std::string>& args, int jobs) {
+    int (*analyse)(const char*, bool) = mode == 'l' ? analyse_lexer
+                                        : mode == 'p' ? analyse_parser
+                                        : analyse_semantics;
+
+    std::vector<std::string> files = collect_batch_files(args);
+    if (files.empty()) {
+        std::cerr << "jambo: no JAM files matched.\n";
+        return 0;
+    }
+
+    std::vector<JamboBatchResult> results(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        results[i].file = files[i];
+    }
+
+    jobs = std::max(1, std::min<int>(jobs, files.size()));
+    std::cout.flush();
+    fflush(stdout);
+
+    auto start = std::chrono::steady_clock::now();
+    preload_shared_imports(mode, results);
+    size_t next = 0;
+    std::vector<size_t> running;
+    while (next < results.size() || !running.empty()) {
+        while (running.size() < static_cast<size_t>(jobs) && next < results.size()) {
+            if (start_isolated_analysis(analyse, results[next])) running.push_back(next);
+            next++;
         }
+        if (running.empty()) continue;
+
+        std::vector<struct pollfd> fds;
+        for (size_t i : running) fds.push_back({results[i].fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+            // Fall back to blocking reads so every child is still reaped.
+            perror("poll");
+            for (auto& pfd : fds) pfd.revents = POLLIN;
+        }
+        for (size_t r = fds.size(); r-- > 0;) {
+            if (fds[r].revents && drain_isolated_analysis(results[running[r]])) {
+                running.erase(running.begin() + r);
+            }
+        }
+    }
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::string> diagnostics;
+    int failed = 0;
+    double total_ms = 0;
+    for (const auto& r : results) {
+        std::cout << "\n\033[95m===== " << r.file << " =====\033[0m\n" << r.output;
+        std::istringstream lines(r.output);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::string lower = line;
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            if (lower.find("error") != std::string::npos || lower.find("warning") != std::string::npos) {
+                diagnostics.push_back(r.file + ": " + line);
+            }
+        }
+        if (r.status != 0) failed++;
+        total_ms += r.ms;
+    }
 
-    free(source_code);
-    free(captured_output);
+    std::cout << "\n===== JAMBO Batch Diagnostics =====\n";
+    if (diagnostics.empty()) std::cout << "No diagnostics.\n";
+    for (const auto& d : diagnostics) std::cout << d << "\n";
+
+    std::cout << "\n===== JAMBO Batch Timings =====\n";
+    for (const auto& r : results) {
+        char row[64];
+        snprintf(row, sizeof(row), "%10.2f ms  %-6s  ", r.ms, r.status == 0 ? "ok" : "FAILED");
+        std::cout << row << r.file << "\n";
+    }
+    char summary[160];
+    snprintf(summary, sizeof(summary), "%zu files, %d failed, %d jobs, %.2f ms wall, %.2f ms summed\n",
+             results.size(), failed, jobs, wall_ms, total_ms);
+    std::cout << summary;
+    return failed;
 }
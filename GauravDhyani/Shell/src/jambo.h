@@ -13,6 +13,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "./include/json.hpp"
 using json = nlohmann::json;
 
@@ -33,13 +34,14 @@ void debugTraverse_to_stdout(void* arg);
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output);
 std::string callGroqAPI(const std::string& userMessage);
 void run_jambo();
+int run_jambo_batch(char mode, const std::vector<std::string>& args, int jobs);
 
 #endif // __cplusplus
 
 // Analysis functions (available in both C and C++)
-void analyse_lexer(const char* filename);
-void analyse_parser(const char* filename);
-void analyse_semantics(const char* filename);
+int analyse_lexer(const char* filename, bool with_ai);
+int analyse_parser(const char* filename, bool with_ai);
+int analyse_semantics(const char* filename, bool with_ai);
 
 // stdout capture utility (available in both C and C++)
 char* capture_stdout_output(void (*func)(void*), void* arg);
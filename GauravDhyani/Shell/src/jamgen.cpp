@@ -0,0 +1,385 @@
+/**
+ * @file jamgen.cpp
+ * @brief Synthetic JAM workload generator for benchmarking the JAM toolchain.
+ *
+ * Emits valid JAM programs of configurable size and shape (functions,
+ * nesting, loops, string literals, arrays, tuples, structs and imports)
+ * from a fixed seed, so the same options always produce the same bytes.
+ * Output is streamed, so sizes from kilobytes to gigabytes are supported.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+// -------------------------
+// Generator Options
+// -------------------------
+
+struct GenOptions {
+    const char* output = nullptr; // nullptr writes to stdout
+    uint64_t seed = 42;
+    uint64_t size = 0;            // Target bytes; 0 means use `functions`
+    int functions = 50;
+    int depth = 3;                // Maximum block nesting depth
+    double loops = 0.3;           // Probability that a statement is a loop
+    double strings = 0.2;         // Probability that a declaration is a String
+    double arrays = 0.15;         // Probability that a declaration is an array
+    double tuples = 0.1;          // Probability that a declaration is a tuple
+    int structs = 4;              // Struct definitions per module
+    int imports = 0;              // Library modules to generate and import
+};
+
+/**
+ * @brief Prints command-line usage.
+ */
+static void print_usage()
+{
+    fprintf(stderr,
+            "Usage: jamgen [options]\n"
+            "  -o <file>          Output file (default stdout; required with --imports)\n"
+            "  --seed <n>         Random seed (default 42)\n"
+            "  --size <n>[K|M|G]  Approximate output size; overrides --functions\n"
+            "  --functions <n>    Number of functions (default 50)\n"
+            "  --depth <n>        Maximum block nesting depth (default 3)\n"
+            "  --loops <p>        Loop density, 0..1 (default 0.3)\n"
+            "  --strings <p>      String literal ratio, 0..1 (default 0.2)\n"
+            "  --arrays <p>       Array declaration ratio, 0..1 (default 0.15)\n"
+            "  --tuples <p>       Tuple declaration ratio, 0..1 (default 0.1)\n"
+            "  --structs <n>      Struct definitions per module (default 4)\n"
+            "  --imports <n>      Library modules to generate and import (default 0)\n");
+}
+
+/**
+ * @brief Parses a byte count with an optional K, M or G suffix.
+ */
+static uint64_t parse_size(const char* text)
+{
+    char* end = nullptr;
+    uint64_t value = strtoull(text, &end, 10);
+    switch (end ? *end : '\0')
+    {
+    case 'k': case 'K': return value << 10;
+    case 'm': case 'M': return value << 20;
+    case 'g': case 'G': return value << 30;
+    default: return value;
+    }
+}
+
+// -------------------------
+// Program Generator
+// -------------------------
+
+/**
+ * @brief Generates one JAM module into an output stream, function by function.
+ *
+ * Functions only call leaf functions (ones that call nothing) defined
+ * before them, and every loop has a bounded counter. A call then costs at
+ * most one leaf body however deep it sits in loops, so running a program
+ * takes time linear in its number of functions rather than exponential.
+ */
+class JamGenerator
+{
+public:
+    JamGenerator(const GenOptions& options, uint64_t seed, std::string prefix)
+        : opt(options), rng(seed), prefix(std::move(prefix)) {}
+
+    /**
+     * @brief Writes a complete module and returns the number of bytes written.
+     *
+     * @param out         Destination stream.
+     * @param functions   Function count (ignored when target_size is non-zero).
+     * @param target_size Approximate size in bytes, or 0.
+     * @param imports     Modules to import, with the functions they export.
+     */
+    uint64_t write_module(FILE* out, int functions, uint64_t target_size,
+                          const std::vector<std::pair<std::string, std::vector<std::string>>>& imports)
+    {
+        buf.clear();
+        uint64_t written = 0;
+        line("** Generated by jamgen");
+        for (const auto& [path, exported] : imports)
+        {
+            line("import \"" + path + "\";");
+            callable.insert(callable.end(), exported.begin(), exported.end());
+        }
+        for (int i = 0; i < opt.structs; ++i)
+        {
+            line("struct " + prefix + "S" + std::to_string(i) + " { name: String, age: Int, score: Float }");
+        }
+        line("");
+
+        for (int i = 0; target_size ? written + buf.size() < target_size : i < functions; ++i)
+        {
+            emit_function(i);
+            if (buf.size() >= (1 << 20))
+                written += flush(out);
+        }
+
+        line("print(\"" + prefix + "done\");");
+        for (size_t i = callable.size() > 3 ? callable.size() - 3 : 0; i < callable.size(); ++i)
+        {
+            line("var r" + std::to_string(i) + ": Int = " + callable[i] + "(1, 2);");
+            line("print(r" + std::to_string(i) + ");");
+        }
+        written += flush(out);
+        return written;
+    }
+
+    /// Functions defined by this module.
+    std::vector<std::string> defined;
+    /// Those of them that call nothing, the only ones importers may call.
+    std::vector<std::string> leaves;
+
+private:
+    const GenOptions& opt;
+    std::mt19937_64 rng;
+    std::string prefix;
+    std::string buf;
+    std::vector<std::string> callable; // Leaf functions defined so far, here or imported
+    std::vector<std::string> ints;     // Int variables in scope
+    int indent = 0;
+    int counter = 0;
+    bool calls = false;                // Whether the current function calls another
+
+    bool chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+    int pick(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); }
+
+    void line(const std::string& text)
+    {
+        buf.append(indent * 4, ' ');
+        buf += text;
+        buf += '\n';
+    }
+
+    uint64_t flush(FILE* out)
+    {
+        fwrite(buf.data(), 1, buf.size(), out);
+        uint64_t n = buf.size();
+        buf.clear();
+        return n;
+    }
+
+    std::string fresh(const char* stem) { return stem + std::to_string(counter++); }
+
+    std::string string_literal()
+    {
+        static const char* words[] = {"alpha", "beta", "gamma", "delta", "jam", "shell", "token", "parse"};
+        std::string s = "\"";
+        for (int i = pick(1, 4); i > 0; --i)
+        {
+            s += words[pick(0, 7)];
+            if (i > 1)
+                s += ' ';
+        }
+        return s + "\"";
+    }
+
+    std::string int_expr(int depth)
+    {
+        if (depth <= 0 || chance(0.4))
+        {
+            if (!ints.empty() && chance(0.7))
+                return ints[pick(0, ints.size() - 1)];
+            return std::to_string(pick(0, 100));
+        }
+        // Operands are generated in separate statements so the RNG is consumed
+        // in a fixed order regardless of the compiler's evaluation order.
+        static const char* ops[] = {"+", "-", "*"};
+        std::string lhs = int_expr(depth - 1);
+        const char* op = ops[pick(0, 2)];
+        std::string rhs = int_expr(depth - 1);
+        return "(" + lhs + " " + op + " " + rhs + ")";
+    }
+
+    void emit_declaration()
+    {
+        if (chance(opt.strings))
+        {
+            std::string name = fresh("s");
+            line("var " + name + ": String = " + string_literal() + ";");
+        }
+        else if (chance(opt.arrays))
+        {
+            std::string items;
+            for (int i = pick(2, 8); i > 0; --i)
+                items += std::to_string(pick(0, 999)) + (i > 1 ? ", " : "");
+            line("var " + fresh("arr") + ": [Int] = [" + items + "];");
+        }
+        else if (chance(opt.tuples))
+        {
+            std::string name = fresh("t");
+            std::string first = int_expr(1);
+            std::string second = string_literal();
+            line("var " + name + ": (Int, String) = (" + first + ", " + second + ");");
+        }
+        else
+        {
+            std::string name = fresh("v");
+            std::string value = int_expr(2);
+            line("var " + name + ": Int = " + value + ";");
+            ints.push_back(name);
+        }
+    }
+
+    void emit_block(int depth)
+    {
+        size_t scope = ints.size();
+        for (int n = pick(2, 5); n > 0; --n)
+        {
+            if (depth < opt.depth && chance(opt.loops))
+            {
+                std::string i = fresh("i");
+                line("var " + i + ": Int = 0;");
+                line("while (" + i + " < " + std::to_string(pick(2, 10)) + ") {");
+                indent++;
+                line(i + " = " + i + " + 1;");
+                emit_block(depth + 1);
+                indent--;
+                line("}");
+            }
+            else if (depth < opt.depth && chance(0.25))
+            {
+                std::string lhs = int_expr(1);
+                std::string rhs = int_expr(1);
+                line("if (" + lhs + " > " + rhs + ") {");
+                indent++;
+                emit_block(depth + 1);
+                indent--;
+                line("} else {");
+                indent++;
+                emit_block(depth + 1);
+                indent--;
+                line("}");
+            }
+            else if (!callable.empty() && chance(0.2))
+            {
+                const std::string& callee = callable[pick(0, callable.size() - 1)];
+                std::string first = int_expr(1);
+                std::string second = int_expr(1);
+                line("print(" + callee + "(" + first + ", " + second + "));");
+                calls = true;
+            }
+            else
+            {
+                emit_declaration();
+            }
+        }
+        ints.resize(scope);
+    }
+
+    void emit_function(int index)
+    {
+        std::string name = prefix + "f" + std::to_string(index);
+        counter = 0;
+        calls = false;
+        ints = {"a", "b"};
+        line("fn " + name + "(a: Int, b: Int) -> Int {");
+        indent++;
+        emit_block(0);
+        line("return " + int_expr(2) + ";");
+        indent--;
+        line("}");
+        line("");
+        defined.push_back(name);
+        if (!calls)
+        {
+            callable.push_back(name);
+            leaves.push_back(name);
+        }
+    }
+};
+
+// -------------------------
+// Main Entry
+// -------------------------
+
+int main(int argc, char* argv[])
+{
+    GenOptions opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0)
+        {
+            print_usage();
+            return 0;
+        }
+        if (!val)
+        {
+            print_usage();
+            return 1;
+        }
+        i++;
+        if (strcmp(arg, "-o") == 0) opt.output = val;
+        else if (strcmp(arg, "--seed") == 0) opt.seed = strtoull(val, nullptr, 10);
+        else if (strcmp(arg, "--size") == 0) opt.size = parse_size(val);
+        else if (strcmp(arg, "--functions") == 0) opt.functions = atoi(val);
+        else if (strcmp(arg, "--depth") == 0) opt.depth = atoi(val);
+        else if (strcmp(arg, "--loops") == 0) opt.loops = atof(val);
+        else if (strcmp(arg, "--strings") == 0) opt.strings = atof(val);
+        else if (strcmp(arg, "--arrays") == 0) opt.arrays = atof(val);
+        else if (strcmp(arg, "--tuples") == 0) opt.tuples = atof(val);
+        else if (strcmp(arg, "--structs") == 0) opt.structs = atoi(val);
+        else if (strcmp(arg, "--imports") == 0) opt.imports = atoi(val);
+        else
+        {
+            fprintf(stderr, "jamgen: unknown option '%s'\n", arg);
+            print_usage();
+            return 1;
+        }
+    }
+    if (opt.imports > 0 && !opt.output)
+    {
+        fprintf(stderr, "jamgen: --imports needs -o so the library modules have a place to go\n");
+        return 1;
+    }
+
+    // Library modules are written next to the main output as <stem>_lib<k>.jam.
+    std::vector<std::pair<std::string, std::vector<std::string>>> imports;
+    std::string stem = opt.output ? opt.output : "";
+    size_t dot = stem.rfind(".jam");
+    if (dot != std::string::npos)
+        stem.erase(dot);
+    for (int k = 0; k < opt.imports; ++k)
+    {
+        std::string lib_path = stem + "_lib" + std::to_string(k) + ".jam";
+        FILE* lib = fopen(lib_path.c_str(), "w");
+        if (!lib)
+        {
+            perror(lib_path.c_str());
+            return 1;
+        }
+        JamGenerator gen(opt, opt.seed + k + 1, "lib" + std::to_string(k) + "_");
+        gen.write_module(lib, std::max(1, opt.functions / 4), 0, {});
+        fclose(lib);
+
+        size_t slash = lib_path.rfind('/');
+        imports.emplace_back(slash == std::string::npos ? lib_path : lib_path.substr(slash + 1), gen.leaves);
+    }
+
+    FILE* out = opt.output ? fopen(opt.output, "w") : stdout;
+    if (!out)
+    {
+        perror(opt.output);
+        return 1;
+    }
+    static char outbuf[1 << 20];
+    setvbuf(out, outbuf, _IOFBF, sizeof(outbuf));
+
+    JamGenerator gen(opt, opt.seed, "");
+    uint64_t written = gen.write_module(out, opt.functions, opt.size, imports);
+    if (out != stdout)
+        fclose(out);
+    else
+        fflush(out);
+
+    fprintf(stderr, "jamgen: %llu bytes, %zu functions, %d imports, seed %llu\n",
+            (unsigned long long)written, gen.defined.size(), opt.imports, (unsigned long long)opt.seed);
+    return 0;
+}
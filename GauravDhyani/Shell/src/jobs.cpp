@@ -0,0 +1,768 @@
+#include "jobs.h"
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cctype>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define JOB_MAX_PROCS 1024
+
+// -------------------------
+// Child Tracking (signal side)
+// -------------------------
+
+// One tracked child. `pid` is written by the shell before `live` is set and
+// only read by the SIGCHLD handler afterwards; the handler reports through
+// the atomics. Only tracked pids are waited for, so children that other
+// code forks and waits for itself (e.g. jambo batch analysis) are left alone.
+struct TrackedChild {
+    pid_t pid = 0;                 // 0 marks a free slot
+    std::atomic<bool> live{false}; // Still worth polling with waitpid()
+    std::atomic<int> status{0};
+    std::atomic<bool> changed{false};
+    struct rusage usage = {};      // From wait4(); valid once the child has terminated
+};
+
+static TrackedChild tracked[JOB_MAX_PROCS];
+static std::atomic<bool> events_pending{false};
+static int wake_pipe[2] = {-1, -1};
+
+/**
+ * @brief Collects state changes of every tracked child without blocking.
+ *
+ * Async-signal-safe; runs from the SIGCHLD handler on whichever thread
+ * received the signal, and from the shell after registering new children.
+ */
+static void poll_tracked_children()
+{
+    for (auto &slot : tracked)
+    {
+        if (!slot.live.load())
+            continue;
+        int status = 0;
+        struct rusage usage;
+        if (wait4(slot.pid, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage) > 0)
+        {
+            // Written before `changed` is published; only meaningful at exit.
+            slot.usage = usage;
+            if (WIFEXITED(status) || WIFSIGNALED(status))
+                slot.live = false;
+            slot.status = status;
+            slot.changed = true;
+            events_pending = true;
+        }
+    }
+}
+
+/**
+ * @brief SIGCHLD handler: reaps tracked children and wakes any waiter.
+ */
+static void on_sigchld(int)
+{
+    int saved_errno = errno;
+    poll_tracked_children();
+    char byte = 0;
+    ssize_t ignored = write(wake_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+// -------------------------
+// Job Table
+// -------------------------
+
+enum ProcState { PROC_RUNNING, PROC_STOPPED, PROC_DONE };
+enum JobState { JOB_RUNNING, JOB_STOPPED, JOB_DONE };
+
+struct JobProcess {
+    pid_t pid;
+    ProcState state = PROC_RUNNING;
+    int status = 0;
+};
+
+struct Job {
+    int id;
+    pid_t pgid;                     // -1 when job control is off
+    std::string command;
+    std::vector<JobProcess> procs;
+    JobState state = JOB_RUNNING;
+    bool notify = false;            // State changed since last reported
+    bool foreground = false;
+    bool has_tmodes = false;        // Terminal modes saved when it stopped
+    struct termios tmodes;
+    struct rusage usage = {};       // Summed over processes that have finished
+};
+
+static std::vector<Job> job_table;  // Ordered by job id
+static std::vector<int> job_recency; // Most recently used job id last
+static bool interactive = false;
+static pid_t shell_pgid = -1;
+static struct termios shell_tmodes;
+static struct rusage waited_usage = {}; // Jobs and children the shell has waited for
+static std::mutex waited_usage_mutex;    // account_child_usage() may run on worker threads
+
+static Job *find_job(int id)
+{
+    for (auto &job : job_table)
+    {
+        if (job.id == id)
+            return &job;
+    }
+    return nullptr;
+}
+
+static void touch_job(int id)
+{
+    job_recency.erase(std::remove(job_recency.begin(), job_recency.end(), id), job_recency.end());
+    job_recency.push_back(id);
+}
+
+static void remove_job(int id)
+{
+    job_recency.erase(std::remove(job_recency.begin(), job_recency.end(), id), job_recency.end());
+    job_table.erase(std::remove_if(job_table.begin(), job_table.end(),
+                                   [id](const Job &job) { return job.id == id; }),
+                    job_table.end());
+}
+
+/**
+ * @brief Recomputes a job's state from its processes.
+ */
+static void update_job_state(Job &job)
+{
+    bool any_running = false, any_stopped = false;
+    for (const auto &proc : job.procs)
+    {
+        any_running |= proc.state == PROC_RUNNING;
+        any_stopped |= proc.state == PROC_STOPPED;
+    }
+    JobState state = any_running ? JOB_RUNNING : any_stopped ? JOB_STOPPED : JOB_DONE;
+    if (state != job.state)
+    {
+        job.state = state;
+        job.notify = true;
+        if (state == JOB_STOPPED)
+            touch_job(job.id);
+    }
+}
+
+/**
+ * @brief Adds one process's resource usage to a total.
+ *
+ * Times and counters are summed; ru_maxrss keeps the largest single
+ * process, since peak memory of different processes does not add up.
+ */
+static void add_usage(struct rusage &total, const struct rusage &usage)
+{
+    timeradd(&total.ru_utime, &usage.ru_utime, &total.ru_utime);
+    timeradd(&total.ru_stime, &usage.ru_stime, &total.ru_stime);
+    total.ru_maxrss = std::max(total.ru_maxrss, usage.ru_maxrss);
+    total.ru_minflt += usage.ru_minflt;
+    total.ru_majflt += usage.ru_majflt;
+    total.ru_inblock += usage.ru_inblock;
+    total.ru_oublock += usage.ru_oublock;
+    total.ru_nvcsw += usage.ru_nvcsw;
+    total.ru_nivcsw += usage.ru_nivcsw;
+}
+
+/**
+ * @brief Moves child state changes reported by the handler into the job table.
+ */
+static void drain_child_events()
+{
+    if (!events_pending.exchange(false))
+        return;
+
+    for (auto &slot : tracked)
+    {
+        if (slot.pid == 0 || !slot.changed.exchange(false))
+            continue;
+        int status = slot.status;
+        pid_t pid = slot.pid;
+        if (!slot.live)
+            slot.pid = 0;
+
+        for (auto &job : job_table)
+        {
+            for (auto &proc : job.procs)
+            {
+                if (proc.pid != pid)
+                    continue;
+                if (WIFSTOPPED(status))
+                {
+                    proc.state = PROC_STOPPED;
+                }
+                else if (WIFCONTINUED(status))
+                {
+                    proc.state = PROC_RUNNING;
+                }
+                else
+                {
+                    proc.state = PROC_DONE;
+                    proc.status = status;
+                    add_usage(job.usage, slot.usage);
+                }
+                update_job_state(job);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Resolves a job spec: %n, %%, %+, %-, %prefix, or a bare job number.
+ *
+ * @param spec Job spec, or nullptr for the current job.
+ * @return Matching job, or nullptr after printing an error.
+ */
+static Job *parse_job_spec(const char *spec)
+{
+    const char *name = spec ? spec : "%+";
+    if (*name == '%')
+        name++;
+
+    int id = 0;
+    if (*name == '\0' || strcmp(name, "%") == 0 || strcmp(name, "+") == 0)
+    {
+        id = job_recency.empty() ? 0 : job_recency.back();
+    }
+    else if (strcmp(name, "-") == 0)
+    {
+        id = job_recency.size() < 2 ? 0 : job_recency[job_recency.size() - 2];
+    }
+    else if (isdigit(static_cast<unsigned char>(*name)))
+    {
+        id = atoi(name);
+    }
+    else
+    {
+        for (auto it = job_recency.rbegin(); it != job_recency.rend() && !id; ++it)
+        {
+            Job *job = find_job(*it);
+            if (job && job->command.compare(0, strlen(name), name) == 0)
+                id = job->id;
+        }
+    }
+
+    Job *job = id ? find_job(id) : nullptr;
+    if (!job)
+        std::cerr << "jam: " << (spec ? spec : "current") << ": no such job\n";
+    return job;
+}
+
+/**
+ * @brief Returns the "+"/"-" marker bash shows for the current and previous job.
+ */
+static char job_marker(int id)
+{
+    size_t n = job_recency.size();
+    if (n >= 1 && job_recency[n - 1] == id)
+        return '+';
+    if (n >= 2 && job_recency[n - 2] == id)
+        return '-';
+    return ' ';
+}
+
+/**
+ * @brief Describes a job's state the way `jobs` prints it.
+ */
+static std::string describe_state(const Job &job)
+{
+    if (job.state == JOB_RUNNING)
+        return "Running";
+    if (job.state == JOB_STOPPED)
+        return "Stopped";
+    int status = job.procs.back().status;
+    if (WIFSIGNALED(status))
+        return strsignal(WTERMSIG(status));
+    if (WEXITSTATUS(status) != 0)
+        return "Exit " + std::to_string(WEXITSTATUS(status));
+    return "Done";
+}
+
+static void print_job(const Job &job, bool with_pids)
+{
+    printf("[%d]%c  ", job.id, job_marker(job.id));
+    if (with_pids)
+        printf("%d ", job.procs.front().pid);
+    printf("%-24s%s%s\n", describe_state(job).c_str(), job.command.c_str(),
+           job.state == JOB_RUNNING ? " &" : "");
+}
+
+// -------------------------
+// Initialization
+// -------------------------
+
+/**
+ * @brief Sets up child reaping and, for an interactive shell, job control.
+ *
+ * When the shell is interactive and stdin is a terminal, it moves into its own process group,
+ * takes the terminal and ignores the job-control signals, so that Ctrl-C
+ * and Ctrl-Z reach only the foreground job. Children get the default
+ * dispositions back when they are spawned.
+ */
+void init_job_control(bool interactive_shell)
+{
+    if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) < 0)
+        perror("pipe");
+
+    struct sigaction action = {};
+    action.sa_handler = on_sigchld;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, nullptr);
+
+    interactive = interactive_shell && isatty(STDIN_FILENO);
+    if (!interactive)
+        return;
+
+    // Wait until we are in the foreground before taking over the terminal.
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp()))
+        kill(-shell_pgid, SIGTTIN);
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    shell_pgid = getpid();
+    if (getpgrp() != shell_pgid && setpgid(shell_pgid, shell_pgid) < 0)
+        perror("setpgid");
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcgetattr(STDIN_FILENO, &shell_tmodes);
+}
+
+/**
+ * @brief Whether new jobs get their own process group and the terminal.
+ */
+bool job_control_enabled()
+{
+    return interactive;
+}
+
+/**
+ * @brief Makes a process group the terminal's foreground group.
+ *
+ * @param pgid Process group to hand the terminal to.
+ */
+void give_terminal_to(pid_t pgid)
+{
+    if (interactive && pgid > 0)
+        tcsetpgrp(STDIN_FILENO, pgid);
+}
+
+// -------------------------
+// Job Lifecycle
+// -------------------------
+
+/**
+ * @brief Registers a started pipeline as a job.
+ *
+ * @param pgid    Process group of the job, or -1 without job control.
+ * @param pids    Processes of the job, last pipeline stage last.
+ * @param command Command line shown by `jobs`.
+ * @return New job id.
+ */
+int add_job(pid_t pgid, const std::vector<pid_t> &pids, const std::string &command)
+{
+    int id = job_table.empty() ? 1 : job_table.back().id + 1;
+    Job job;
+    job.id = id;
+    job.pgid = pgid;
+    job.command = command;
+
+    for (pid_t pid : pids)
+    {
+        job.procs.push_back({pid});
+        auto slot = std::find_if(std::begin(tracked), std::end(tracked),
+                                 [](const TrackedChild &t) { return t.pid == 0; });
+        if (slot == std::end(tracked))
+        {
+            std::cerr << "jam: too many child processes; " << pid << " will not be reaped\n";
+            continue;
+        }
+        slot->pid = pid;
+        slot->changed = false;
+        slot->live = true;
+    }
+    job_table.push_back(std::move(job));
+    touch_job(id);
+
+    // A child may have exited before it was tracked; catch up on it now.
+    poll_tracked_children();
+    return id;
+}
+
+/**
+ * @brief Waits until a job finishes (or, in the foreground, stops).
+ *
+ * A foreground job owns the terminal while it runs. If it is stopped
+ * (Ctrl-Z) it stays in the table and its terminal modes are saved for `fg`.
+ *
+ * @param id         Job to wait for.
+ * @param foreground Whether the job runs in the foreground.
+ * @return Exit status of the job's last process; 128+signal if it was killed
+ *         or 128+SIGTSTP if it stopped.
+ */
+int wait_for_job(int id, bool foreground)
+{
+    Job *job = find_job(id);
+    if (!job)
+        return 127;
+    job->foreground = foreground;
+    if (foreground)
+        give_terminal_to(job->pgid);
+
+    while (true)
+    {
+        drain_child_events();
+        job = find_job(id);
+        if (job->state == JOB_DONE || (foreground && job->state == JOB_STOPPED))
+            break;
+        struct pollfd pfd = {wake_pipe[0], POLLIN, 0};
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+        char buf[64];
+        while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+            ;
+    }
+
+    if (foreground && interactive)
+    {
+        job->has_tmodes = tcgetattr(STDIN_FILENO, &job->tmodes) == 0;
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+    }
+
+    if (job->state == JOB_STOPPED)
+    {
+        job->foreground = false;
+        job->notify = false;
+        printf("\n");
+        print_job(*job, false);
+        return 128 + SIGTSTP;
+    }
+
+    int status = job->procs.back().status;
+    if (foreground && WIFSIGNALED(status) && WTERMSIG(status) == SIGINT)
+        printf("\n");
+    else if (foreground && WIFSIGNALED(status) && WTERMSIG(status) != SIGPIPE)
+        printf("%s\n", strsignal(WTERMSIG(status)));
+    {
+        std::lock_guard<std::mutex> lock(waited_usage_mutex);
+        add_usage(waited_usage, job->usage);
+    }
+    remove_job(id);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * @brief Reports background jobs that finished or stopped since the last prompt.
+ *
+ * Called before each prompt (and silently between script commands);
+ * finished jobs are dropped from the table, which together with the
+ * SIGCHLD handler keeps `cmd &` from leaving zombies. Cheap when nothing
+ * has changed.
+ *
+ * @param report Whether to print the changes.
+ */
+void notify_jobs(bool report)
+{
+    drain_child_events();
+    std::vector<int> finished;
+    for (auto &job : job_table)
+    {
+        if (!job.notify || job.foreground)
+            continue;
+        job.notify = false;
+        if (report)
+            print_job(job, false);
+        if (job.state == JOB_DONE)
+            finished.push_back(job.id);
+    }
+    for (int id : finished)
+        remove_job(id);
+    if (report)
+        fflush(stdout);
+}
+
+/**
+ * @brief Records the usage of a child that was reaped outside the job table.
+ *
+ * For code that waits for its own children with wait4() (jparallel and
+ * jambo batch workers), so that jtime still sees them. Thread-safe.
+ */
+void account_child_usage(const struct rusage &usage)
+{
+    std::lock_guard<std::mutex> lock(waited_usage_mutex);
+    add_usage(waited_usage, usage);
+}
+
+/**
+ * @brief Usage of every job and child the shell has waited for so far.
+ *
+ * Collected with wait4() per process, so background jobs that finish on
+ * their own (and are only reaped) do not count. The counters only grow,
+ * so a measurement takes the difference across a command (measurements
+ * may nest). ru_maxrss is instead the largest process since the last
+ * call with `reset_peak` set.
+ *
+ * @param reset_peak Start a new max-RSS window after reading.
+ */
+struct rusage waited_child_usage(bool reset_peak)
+{
+    drain_child_events();
+    std::lock_guard<std::mutex> lock(waited_usage_mutex);
+    struct rusage usage = waited_usage;
+    if (reset_peak)
+        waited_usage.ru_maxrss = 0;
+    return usage;
+}
+
+/**
+ * @brief Whether any job is stopped (used to warn before exiting).
+ */
+bool has_stopped_jobs()
+{
+    drain_child_events();
+    return std::any_of(job_table.begin(), job_table.end(),
+                       [](const Job &job) { return job.state == JOB_STOPPED; });
+}
+
+/**
+ * @brief Sends a signal to every process of a job.
+ */
+static int signal_job(const Job &job, int sig)
+{
+    if (job.pgid > 0)
+        return kill(-job.pgid, sig);
+    int result = 0;
+    for (const auto &proc : job.procs)
+    {
+        if (proc.state != PROC_DONE && kill(proc.pid, sig) < 0)
+            result = -1;
+    }
+    return result;
+}
+
+// -------------------------
+// Job Builtins
+// -------------------------
+
+/**
+ * @brief Implements `jobs [-l]`: lists jobs with their state.
+ */
+int handle_jobs_command(int token_count, char *tokens[])
+{
+    bool with_pids = token_count > 1 && strcmp(tokens[1], "-l") == 0;
+    drain_child_events();
+    std::vector<int> finished;
+    for (auto &job : job_table)
+    {
+        print_job(job, with_pids);
+        job.notify = false;
+        if (job.state == JOB_DONE)
+            finished.push_back(job.id);
+    }
+    for (int id : finished)
+        remove_job(id);
+    return 0;
+}
+
+/**
+ * @brief Implements `fg [%job]`: continues a job in the foreground.
+ */
+int handle_fg_command(int token_count, char *tokens[])
+{
+    drain_child_events();
+    Job *job = parse_job_spec(token_count > 1 ? tokens[1] : nullptr);
+    if (!job)
+        return 1;
+
+    printf("%s\n", job->command.c_str());
+    fflush(stdout);
+    touch_job(job->id);
+    give_terminal_to(job->pgid);
+    if (interactive && job->has_tmodes)
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &job->tmodes);
+    if (job->state == JOB_STOPPED)
+    {
+        for (auto &proc : job->procs)
+        {
+            if (proc.state == PROC_STOPPED)
+                proc.state = PROC_RUNNING;
+        }
+        update_job_state(*job);
+        signal_job(*job, SIGCONT);
+    }
+    return wait_for_job(job->id, true);
+}
+
+/**
+ * @brief Implements `bg [%job]`: continues a stopped job in the background.
+ */
+int handle_bg_command(int token_count, char *tokens[])
+{
+    drain_child_events();
+    Job *job = parse_job_spec(token_count > 1 ? tokens[1] : nullptr);
+    if (!job)
+        return 1;
+    if (job->state != JOB_STOPPED)
+    {
+        std::cerr << "jam: bg: job " << job->id << " already in background\n";
+        return 0;
+    }
+
+    for (auto &proc : job->procs)
+    {
+        if (proc.state == PROC_STOPPED)
+            proc.state = PROC_RUNNING;
+    }
+    update_job_state(*job);
+    job->notify = false;
+    touch_job(job->id);
+    signal_job(*job, SIGCONT);
+    printf("[%d]%c %s &\n", job->id, job_marker(job->id), job->command.c_str());
+    return 0;
+}
+
+/**
+ * @brief Implements `wait [%job|pid ...]`: waits for jobs to finish.
+ *
+ * Without arguments waits for every background job.
+ *
+ * @return Status of the last job waited for.
+ */
+int handle_wait_command(int token_count, char *tokens[])
+{
+    std::vector<int> ids;
+    for (int i = 1; i < token_count; ++i)
+    {
+        if (tokens[i][0] == '%')
+        {
+            Job *job = parse_job_spec(tokens[i]);
+            if (!job)
+                return 127;
+            ids.push_back(job->id);
+            continue;
+        }
+
+        pid_t pid = atoi(tokens[i]);
+        auto it = std::find_if(job_table.begin(), job_table.end(), [pid](const Job &job) {
+            return std::any_of(job.procs.begin(), job.procs.end(),
+                               [pid](const JobProcess &proc) { return proc.pid == pid; });
+        });
+        if (it == job_table.end())
+        {
+            std::cerr << "jam: wait: pid " << tokens[i] << " is not a child of this shell\n";
+            return 127;
+        }
+        ids.push_back(it->id);
+    }
+    if (token_count == 1)
+    {
+        for (const auto &job : job_table)
+        {
+            if (job.state != JOB_STOPPED)
+                ids.push_back(job.id);
+        }
+    }
+
+    int status = 0;
+    for (int id : ids)
+    {
+        if (find_job(id))
+            status = wait_for_job(id, false);
+    }
+    return status;
+}
+
+/**
+ * @brief Parses a signal given as a number or a name (with or without "SIG").
+ *
+ * @return Signal number, or -1 if unknown.
+ */
+static int parse_signal(const char *name)
+{
+    static const struct { const char *name; int sig; } signals[] = {
+        {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+        {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"PIPE", SIGPIPE}, {"ALRM", SIGALRM},
+        {"TERM", SIGTERM}, {"CHLD", SIGCHLD}, {"CONT", SIGCONT}, {"STOP", SIGSTOP},
+        {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU}, {"WINCH", SIGWINCH},
+    };
+    if (isdigit(static_cast<unsigned char>(*name)))
+        return atoi(name);
+    if (strncasecmp(name, "SIG", 3) == 0)
+        name += 3;
+    for (const auto &entry : signals)
+    {
+        if (strcasecmp(name, entry.name) == 0)
+            return entry.sig;
+    }
+    return -1;
+}
+
+/**
+ * @brief Implements `kill [-SIG | -s SIG] %job|pid ...`.
+ */
+int handle_kill_command(int token_count, char *tokens[])
+{
+    int sig = SIGTERM;
+    int i = 1;
+    if (i < token_count && strcmp(tokens[i], "-s") == 0 && i + 1 < token_count)
+    {
+        sig = parse_signal(tokens[i + 1]);
+        i += 2;
+    }
+    else if (i < token_count && tokens[i][0] == '-' && tokens[i][1] != '\0')
+    {
+        sig = parse_signal(tokens[i] + 1);
+        i++;
+    }
+    if (sig < 0)
+    {
+        std::cerr << "jam: kill: invalid signal specification\n";
+        return 1;
+    }
+    if (i == token_count)
+    {
+        std::cerr << "Usage: kill [-SIG | -s SIG] %job|pid ...\n";
+        return 2;
+    }
+
+    drain_child_events();
+    int result = 0;
+    for (; i < token_count; ++i)
+    {
+        if (tokens[i][0] == '%')
+        {
+            Job *job = parse_job_spec(tokens[i]);
+            if (!job || signal_job(*job, sig) < 0)
+                result = 1;
+            // A stopped job only sees the signal once it runs again.
+            if (job && job->state == JOB_STOPPED && sig != SIGCONT && sig != SIGKILL && sig != SIGSTOP)
+                signal_job(*job, SIGCONT);
+        }
+        else if (kill(atoi(tokens[i]), sig) < 0)
+        {
+            std::cerr << "jam: kill: (" << tokens[i] << ") - " << strerror(errno) << "\n";
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,26 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+void init_job_control(bool interactive_shell);
+bool job_control_enabled();
+void give_terminal_to(pid_t pgid);
+
+int add_job(pid_t pgid, const std::vector<pid_t> &pids, const std::string &command);
+int wait_for_job(int id, bool foreground);
+void notify_jobs(bool report);
+bool has_stopped_jobs();
+void account_child_usage(const struct rusage &usage);
+struct rusage waited_child_usage(bool reset_peak);
+
+int handle_jobs_command(int token_count, char *tokens[]);
+int handle_fg_command(int token_count, char *tokens[]);
+int handle_bg_command(int token_count, char *tokens[]);
+int handle_wait_command(int token_count, char *tokens[]);
+int handle_kill_command(int token_count, char *tokens[]);
+
+#endif // JOBS_H
@@ -0,0 +1,876 @@
+#include "locate.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <climits>
+#include <cctype>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "walk.h"
+
+#define LOCATE_DB_MAGIC "JAMLDB1"
+#define LOCATE_DB_VERSION 2
+#define LOCATE_BLOCK_ENTRIES 64  // Entries per block; each block starts with a full path
+#define LOCATE_RACY_NS 10000000  // Directories modified this close to the last update are re-read
+#define LOCATE_RULES_RACY UINT64_MAX // Stamp of ignore files too new to trust; never matches
+
+// -------------------------
+// Live Walk
+// -------------------------
+
+/**
+ * @brief Finds paths containing the search term in their names.
+ *
+ * Unreadable directories are listed but not entered.
+ *
+ * @param root   Directory to search from.
+ * @param term   Search term.
+ * @param policy Hidden and ignored paths.
+ * @return Vector of matched file/directory paths, sorted and highlighted.
+ */
+std::vector<std::string> find_paths_containing(const std::string &root, const std::string &term,
+                                               const WalkPolicy &policy)
+{
+    std::vector<std::pair<std::string, size_t>> matches;
+    walk_tree(root, policy, [&](const std::string &path_str, const WalkEntry &) {
+        size_t pos = path_str.find(term);
+        if (pos != std::string::npos)
+            matches.emplace_back(path_str, pos);
+    });
+    std::sort(matches.begin(), matches.end());
+
+    std::vector<std::string> found;
+    found.reserve(matches.size());
+    for (auto &[path_str, pos] : matches)
+    {
+        path_str.insert(pos + term.length(), "\033[0m");
+        path_str.insert(pos, "\033[31m");
+        found.push_back(std::move(path_str));
+    }
+    return found;
+}
+
+/**
+ * @brief Outputs the found paths.
+ * @param paths Vector of colored, matched paths.
+ */
+void show_found_paths(const std::vector<std::string> &paths)
+{
+    for (const auto &p : paths)
+    {
+        std::cout << p << '\n';
+    }
+    std::cout.flush();
+}
+
+// -------------------------
+// Database Format
+// -------------------------
+//
+// The database lists every path below one root, relative to it, sorted
+// bytewise so that each directory's subtree is one contiguous run:
+//
+//   LocateHeader
+//   root                       absolute, not NUL-terminated
+//   uint64_t[block_count]      offset in data of each block's first entry
+//   data                       the entries, front-coded
+//
+// An entry is varint(bytes shared with the previous path), varint(length
+// of the rest), the rest, a flags byte and, for directories, varint mtime
+// seconds and nanoseconds and the varint stamp of its ignore files. The
+// first entry of each block shares nothing, so a block can be decoded on
+// its own and its first path read in place. Integers are in host byte
+// order; the database is a local cache.
+
+enum LocateEntryFlags : uint8_t {
+    LOCATE_DIR = 1,
+};
+
+// The walk policy a database was built with; it answers only queries with the same one.
+enum LocatePolicyFlags : uint32_t {
+    LOCATE_HIDDEN = 1,
+    LOCATE_NO_IGNORE = 2,
+};
+
+struct LocateHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_entries;
+    uint64_t entry_count;
+    uint64_t block_count;
+    int64_t built_sec; // When the walk that produced the database started
+    int64_t built_nsec;
+    int64_t root_mtime_sec;
+    int64_t root_mtime_nsec;
+    uint64_t root_offset;
+    uint64_t root_length;
+    uint64_t blocks_offset;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t data_hash; // FNV-1a of data, checked before reusing listings
+    uint64_t root_rules;  // Stamp of the root's ignore files
+    uint64_t above_rules; // Stamp of the ignore files above the root that apply to it
+    uint32_t policy;      // LocatePolicyFlags
+    uint32_t reserved;
+};
+
+// A database entry while building.
+struct LocateEntry {
+    std::string path;
+    uint8_t flags = 0;
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+    uint64_t rules = 0; // Directories: stamp of their ignore files
+};
+
+/**
+ * @brief Returns the LocatePolicyFlags of a walk policy.
+ */
+static uint32_t policy_flags(const WalkPolicy &policy)
+{
+    uint32_t flags = 0;
+    if (policy.hidden)
+        flags |= LOCATE_HIDDEN;
+    if (!policy.ignore_files)
+        flags |= LOCATE_NO_IGNORE;
+    return flags;
+}
+
+/**
+ * @brief Returns the database path: $JAM_LOCATEDB, else ~/.jam_locatedb.
+ */
+static std::string default_db_path()
+{
+    const char *env = getenv("JAM_LOCATEDB");
+    if (env && *env)
+        return env;
+    const char *home = getenv("HOME");
+    return home && *home ? std::string(home) + "/" + LOCATE_DB_FILE : LOCATE_DB_FILE;
+}
+
+static void put_varint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of a buffer.
+ */
+static uint64_t fnv1a(const char *data, size_t size)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Reads a varint; false if it runs past end.
+ */
+static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// -------------------------
+// Reading
+// -------------------------
+
+// A validated, memory-mapped database.
+struct MappedDb {
+    const char *base = nullptr;
+    size_t size = 0;
+    const LocateHeader *header = nullptr;
+    const uint64_t *blocks = nullptr;
+    const uint8_t *data = nullptr;
+    std::string_view root;
+
+    ~MappedDb()
+    {
+        if (base)
+            munmap(const_cast<char *>(base), size);
+    }
+};
+
+/**
+ * @brief Maps a database and checks that its sections lie inside it.
+ * @param quiet Do not complain about a missing file.
+ */
+static bool open_db(const std::string &path, MappedDb &db, bool quiet)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (!quiet)
+            perror(path.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(LocateHeader))
+    {
+        close(fd);
+        std::cerr << "locate: " << path << " is not a locate database\n";
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    db.base = static_cast<const char *>(map);
+    db.size = st.st_size;
+
+    const LocateHeader *h = reinterpret_cast<const LocateHeader *>(db.base);
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset <= db.size && count <= (db.size - offset) / width;
+    };
+    if (memcmp(h->magic, LOCATE_DB_MAGIC, sizeof(h->magic)) != 0 || h->version != LOCATE_DB_VERSION ||
+        !fits(h->root_offset, h->root_length, 1) || !fits(h->blocks_offset, h->block_count, sizeof(uint64_t)) ||
+        !fits(h->data_offset, h->data_size, 1))
+    {
+        std::cerr << "locate: " << path << " is not a valid database; rerun jupdatedb\n";
+        return false;
+    }
+    db.header = h;
+    db.blocks = reinterpret_cast<const uint64_t *>(db.base + h->blocks_offset);
+    db.data = reinterpret_cast<const uint8_t *>(db.base + h->data_offset);
+    db.root = std::string_view(db.base + h->root_offset, h->root_length);
+    return true;
+}
+
+// Sequential decoder over the entries, starting at a block.
+struct EntryCursor {
+    const uint8_t *p = nullptr;
+    const uint8_t *end = nullptr;
+    std::string path;
+    size_t shared = 0; // Bytes of path kept from the previous entry
+    uint8_t flags = 0;
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+    uint64_t rules = 0;
+
+    /**
+     * @brief Decodes the next entry; false at the end or on damaged data.
+     */
+    bool next()
+    {
+        uint64_t keep, length;
+        if (p >= end || !get_varint(p, end, keep) || !get_varint(p, end, length) || keep > path.size() ||
+            length >= uint64_t(end - p))
+            return false;
+        path.resize(keep);
+        path.append(reinterpret_cast<const char *>(p), length);
+        p += length;
+        shared = keep;
+        flags = *p++;
+        mtime_sec = mtime_nsec = 0;
+        rules = 0;
+        if (flags & LOCATE_DIR)
+        {
+            uint64_t sec, nsec;
+            if (!get_varint(p, end, sec) || !get_varint(p, end, nsec) || !get_varint(p, end, rules))
+                return false;
+            mtime_sec = int64_t(sec);
+            mtime_nsec = int64_t(nsec);
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief Positions a cursor at the start of block `index`.
+ */
+static EntryCursor cursor_at(const MappedDb &db, uint64_t index)
+{
+    EntryCursor cursor;
+    cursor.end = db.data + db.header->data_size;
+    uint64_t offset = index < db.header->block_count ? db.blocks[index] : db.header->data_size;
+    cursor.p = db.data + std::min(offset, db.header->data_size);
+    return cursor;
+}
+
+/**
+ * @brief Returns the first path of a block in place, without copying.
+ */
+static std::string_view block_first_path(const MappedDb &db, uint64_t index)
+{
+    EntryCursor cursor = cursor_at(db, index);
+    uint64_t keep, length;
+    if (!get_varint(cursor.p, cursor.end, keep) || !get_varint(cursor.p, cursor.end, length) || keep != 0 ||
+        length > uint64_t(cursor.end - cursor.p))
+        return {};
+    return std::string_view(reinterpret_cast<const char *>(cursor.p), length);
+}
+
+/**
+ * @brief Prints the database entries below `prefix` whose ./-relative path contains term.
+ *
+ * The subtree is found by binary search over the blocks' first paths.
+ * Consecutive paths share most of their bytes, so the search for the term
+ * resumes where the shared part ends: a first match inside the shared
+ * part carries over from the previous path, and otherwise only the new
+ * bytes (and term-length - 1 before them) are scanned.
+ *
+ * @param db     Database.
+ * @param prefix Path of the current directory relative to the root, with
+ *               a trailing '/', or empty for the root itself.
+ * @param term   Search term.
+ * @return Number of paths printed.
+ */
+static size_t locate_in_db(const MappedDb &db, const std::string &prefix, const std::string &term)
+{
+    uint64_t first = 0, last = db.header->block_count;
+    while (first < last) // First block whose first path is >= prefix
+    {
+        uint64_t mid = first + (last - first) / 2;
+        if (block_first_path(db, mid) < prefix)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    EntryCursor cursor = cursor_at(db, first ? first - 1 : 0);
+
+    const size_t plen = prefix.size();
+    const size_t m = term.size();
+    std::string display, out;
+    size_t match = std::string::npos;
+    size_t printed = 0;
+    bool in_range = false;
+    while (cursor.next())
+    {
+        if (cursor.path.compare(0, plen, prefix) != 0)
+        {
+            if (in_range || cursor.path > prefix)
+                break;
+            continue;
+        }
+
+        // The display path is "./" + the path below prefix.
+        size_t keep = !in_range ? 0 : cursor.shared >= plen ? 2 + cursor.shared - plen : 2;
+        in_range = true;
+        if (keep == 0)
+            display.assign("./");
+        else
+            display.resize(keep);
+        display.append(cursor.path, plen + std::max<size_t>(keep, 2) - 2, std::string::npos);
+
+        if (m == 0)
+            match = 0;
+        else if (keep == 0 || match == std::string::npos || match + m > keep)
+        {
+            size_t from = keep >= m ? keep - m + 1 : 0;
+            const char *hit = find_substring(display.data() + from, display.size() - from, term.data(), m);
+            match = hit ? hit - display.data() : std::string::npos;
+        }
+        if (match == std::string::npos)
+            continue;
+
+        out.append(display, 0, match);
+        out.append("\033[31m");
+        out.append(term);
+        out.append("\033[0m");
+        out.append(display, match + m, std::string::npos);
+        out.push_back('\n');
+        printed++;
+        if (out.size() >= 65536)
+        {
+            std::cout << out;
+            out.clear();
+        }
+    }
+    std::cout << out;
+    std::cout.flush();
+    return printed;
+}
+
+/**
+ * @brief Works out where the current directory is in the database's tree.
+ * @param prefix Receives the current directory relative to the root, with a
+ *               trailing '/', or "" at the root.
+ * @return false if the current directory is not below the root.
+ */
+static bool cwd_prefix(const MappedDb &db, std::string &prefix)
+{
+    char cwd[PATH_MAX];
+    if (!realpath(".", cwd))
+        return false;
+    std::string_view here(cwd), root = db.root;
+    if (here == root)
+    {
+        prefix.clear();
+        return true;
+    }
+    std::string root_slash(root);
+    if (root_slash.back() != '/')
+        root_slash += '/';
+    if (here.substr(0, root_slash.size()) != root_slash)
+        return false;
+    prefix = std::string(here.substr(root_slash.size())) + "/";
+    return true;
+}
+
+// -------------------------
+// Building
+// -------------------------
+
+// Directory listings of the previous database, by relative directory path.
+struct PreviousListing {
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+    uint64_t rules = 0;     // Stamp of the directory's ignore files
+    bool settled = false;   // Modified well before the previous update; the listing can be reused
+    std::vector<uint32_t> children; // Indexes into PreviousDb::entries
+};
+
+struct PreviousDb {
+    uint64_t above_rules = 0;
+    std::vector<LocateEntry> entries;
+    std::unordered_map<std::string, PreviousListing> listings; // "" is the root
+};
+
+/**
+ * @brief Loads the listings of directories that have not changed since an old database.
+ *
+ * Only directories modified more than LOCATE_RACY_NS before the old
+ * update started are settled, since an entry added in the same timestamp
+ * tick as the listing was read leaves the mtime as it was. A reused
+ * listing is trusted until the directory changes, so a database that
+ * fails its checksum or does not decode completely is not used at all.
+ *
+ * @return false if the database is damaged.
+ */
+static bool load_previous(const MappedDb &db, PreviousDb &previous)
+{
+    if (fnv1a(reinterpret_cast<const char *>(db.data), db.header->data_size) != db.header->data_hash)
+        return false;
+
+    int64_t limit_sec = db.header->built_sec;
+    int64_t limit_nsec = db.header->built_nsec - LOCATE_RACY_NS;
+    if (limit_nsec < 0)
+    {
+        limit_sec--;
+        limit_nsec += 1000000000;
+    }
+    auto settled = [&](int64_t sec, int64_t nsec) {
+        return sec < limit_sec || (sec == limit_sec && nsec < limit_nsec);
+    };
+
+    previous.above_rules = db.header->above_rules;
+    previous.listings[""] = {db.header->root_mtime_sec, db.header->root_mtime_nsec, db.header->root_rules,
+                             settled(db.header->root_mtime_sec, db.header->root_mtime_nsec), {}};
+    EntryCursor cursor = cursor_at(db, 0);
+    while (previous.entries.size() < db.header->entry_count && cursor.next())
+    {
+        uint32_t index = uint32_t(previous.entries.size());
+        previous.entries.push_back({cursor.path, cursor.flags, cursor.mtime_sec, cursor.mtime_nsec, cursor.rules});
+        if (cursor.flags & LOCATE_DIR)
+            previous.listings[cursor.path] = {cursor.mtime_sec, cursor.mtime_nsec, cursor.rules,
+                                              settled(cursor.mtime_sec, cursor.mtime_nsec), {}};
+
+        size_t slash = cursor.path.rfind('/');
+        std::string parent = slash == std::string::npos ? "" : cursor.path.substr(0, slash);
+        auto it = previous.listings.find(parent);
+        if (it != previous.listings.end())
+            it->second.children.push_back(index);
+    }
+    return previous.entries.size() == db.header->entry_count && cursor.p == cursor.end;
+}
+
+/**
+ * @brief Reads the mount table for pseudo filesystems that are not worth listing.
+ */
+static std::unordered_set<std::string> pseudo_mounts()
+{
+    static const std::unordered_set<std::string> pseudo = {
+        "proc",   "sysfs",     "devpts",     "cgroup",  "cgroup2", "debugfs",     "tracefs", "securityfs",
+        "pstore", "bpf",       "configfs",   "fusectl", "mqueue",  "hugetlbfs",   "autofs",  "binfmt_misc",
+        "nsfs",   "efivarfs",  "selinuxfs",
+    };
+    std::unordered_set<std::string> mounts;
+    std::ifstream table("/proc/self/mounts");
+    std::string device, mount_point, type, rest;
+    while (table >> device >> mount_point >> type && std::getline(table, rest))
+    {
+        if (!pseudo.count(type))
+            continue;
+        std::string decoded; // Spaces and the like are written as \ooo
+        for (size_t i = 0; i < mount_point.size(); ++i)
+        {
+            if (mount_point[i] == '\\' && i + 3 < mount_point.size() && isdigit((unsigned char)mount_point[i + 1]))
+            {
+                decoded.push_back(char(strtol(mount_point.substr(i + 1, 3).c_str(), nullptr, 8)));
+                i += 3;
+            }
+            else
+                decoded.push_back(mount_point[i]);
+        }
+        mounts.insert(decoded);
+    }
+    return mounts;
+}
+
+// State of one jupdatedb walk.
+struct UpdateWalk {
+    std::string root; // Absolute
+    WalkPolicy policy;
+    struct timespec built_at = {};
+    const PreviousDb *previous = nullptr;
+    std::unordered_set<std::string> pruned; // Absolute mount points not descended into
+    std::vector<LocateEntry> entries;
+    size_t directories = 0;
+    size_t reused = 0;
+};
+
+/**
+ * @brief Returns the absolute path of a root-relative path.
+ */
+static std::string absolute_path(const UpdateWalk &walk, const std::string &rel)
+{
+    if (rel.empty())
+        return walk.root;
+    return walk.root == "/" ? "/" + rel : walk.root + "/" + rel;
+}
+
+/**
+ * @brief Returns the stamp to record for ignore files.
+ *
+ * Ignore files edited in the same timestamp tick as this walk may change
+ * again without their stamp changing, so they are recorded as changed.
+ */
+static uint64_t recorded_stamp(const UpdateWalk &walk, const IgnoreStamp &stamp)
+{
+    int64_t limit_sec = walk.built_at.tv_sec;
+    int64_t limit_nsec = walk.built_at.tv_nsec - LOCATE_RACY_NS;
+    if (limit_nsec < 0)
+    {
+        limit_sec--;
+        limit_nsec += 1000000000;
+    }
+    bool settled = stamp.newest.tv_sec < limit_sec ||
+                   (stamp.newest.tv_sec == limit_sec && stamp.newest.tv_nsec < limit_nsec);
+    return stamp.hash && !settled ? LOCATE_RULES_RACY : stamp.hash;
+}
+
+/**
+ * @brief Lists a directory into the walk and descends into its subdirectories.
+ *
+ * A directory whose mtime matches the previous database has the same
+ * entries, so its listing is taken from there instead of being read again,
+ * unless an ignore file in it or above it changed since: each directory's
+ * ignore files are stamped in the database for that. Its subdirectories
+ * are still checked, since a change deeper down does not touch this
+ * directory's mtime. Symlinks to directories are listed but not followed;
+ * unreadable directories are listed but not entered.
+ *
+ * @param walk          Walk state.
+ * @param rel           Directory relative to the root ("" for the root).
+ * @param mtime         The directory's mtime.
+ * @param parent_rules  Ignore rules of the directories above.
+ * @param rules_changed Whether an ignore file above changed since the previous database.
+ * @return Stamp of the directory's ignore files, to record in the database.
+ */
+static uint64_t update_directory(UpdateWalk &walk, const std::string &rel, const struct timespec &mtime,
+                                 const IgnoreChain &parent_rules, bool rules_changed)
+{
+    walk.directories++;
+    std::string dir = absolute_path(walk, rel);
+    IgnoreChain rules = parent_rules;
+    IgnoreStamp stamp;
+    if (walk.policy.ignore_files)
+        rules = load_ignore_rules(dir, parent_rules, &stamp);
+
+    const PreviousListing *listing = nullptr;
+    if (walk.previous)
+    {
+        auto it = walk.previous->listings.find(rel);
+        if (it != walk.previous->listings.end())
+            listing = &it->second;
+    }
+    if (listing && listing->rules != stamp.hash)
+        rules_changed = true;
+
+    std::vector<WalkEntry> children;
+    size_t skip = rel.empty() ? 0 : rel.size() + 1;
+    if (listing && listing->settled && !rules_changed && listing->mtime_sec == mtime.tv_sec &&
+        listing->mtime_nsec == mtime.tv_nsec)
+    {
+        walk.reused++;
+        for (uint32_t index : listing->children)
+        {
+            const LocateEntry &entry = walk.previous->entries[index];
+            WalkEntry child;
+            child.name = entry.path.substr(skip);
+            struct stat st;
+            if ((entry.flags & LOCATE_DIR) && lstat(absolute_path(walk, entry.path).c_str(), &st) == 0 &&
+                S_ISDIR(st.st_mode))
+            {
+                child.type = DT_DIR;
+                child.mtime = st.st_mtim;
+            }
+            children.push_back(std::move(child));
+        }
+    }
+    else
+    {
+        DirListing fresh;
+        read_directory({dir, rules}, walk.policy, WALK_DIR_MTIMES | WALK_KEEP_RULES, fresh);
+        children = std::move(fresh.entries);
+    }
+
+    for (const WalkEntry &child : children)
+    {
+        LocateEntry entry;
+        entry.path = rel.empty() ? child.name : rel + "/" + child.name;
+        if (child.type != DT_DIR)
+        {
+            walk.entries.push_back(std::move(entry));
+            continue;
+        }
+        entry.flags = LOCATE_DIR;
+        entry.mtime_sec = child.mtime.tv_sec;
+        entry.mtime_nsec = child.mtime.tv_nsec;
+        std::string path = entry.path;
+        size_t index = walk.entries.size();
+        walk.entries.push_back(std::move(entry));
+        if (!walk.pruned.count(absolute_path(walk, path)))
+            walk.entries[index].rules = update_directory(walk, path, child.mtime, rules, rules_changed);
+    }
+    return recorded_stamp(walk, stamp);
+}
+
+/**
+ * @brief Front-codes the sorted entries and writes the database atomically.
+ * @return Bytes written, or 0 on failure.
+ */
+static size_t write_db(const std::string &path, const UpdateWalk &walk, const struct stat &root_st,
+                       uint64_t root_rules, uint64_t above_rules)
+{
+    std::string data;
+    std::vector<uint64_t> blocks;
+    const std::string *previous = nullptr;
+    for (size_t i = 0; i < walk.entries.size(); ++i)
+    {
+        const LocateEntry &entry = walk.entries[i];
+        size_t keep = 0;
+        if (i % LOCATE_BLOCK_ENTRIES == 0)
+            blocks.push_back(data.size());
+        else
+        {
+            size_t limit = std::min(previous->size(), entry.path.size());
+            while (keep < limit && (*previous)[keep] == entry.path[keep])
+                keep++;
+        }
+        put_varint(data, keep);
+        put_varint(data, entry.path.size() - keep);
+        data.append(entry.path, keep, std::string::npos);
+        data.push_back(char(entry.flags));
+        if (entry.flags & LOCATE_DIR)
+        {
+            put_varint(data, uint64_t(entry.mtime_sec));
+            put_varint(data, uint64_t(entry.mtime_nsec));
+            put_varint(data, entry.rules);
+        }
+        previous = &entry.path;
+    }
+
+    LocateHeader header = {};
+    memcpy(header.magic, LOCATE_DB_MAGIC, sizeof(header.magic));
+    header.version = LOCATE_DB_VERSION;
+    header.block_entries = LOCATE_BLOCK_ENTRIES;
+    header.entry_count = walk.entries.size();
+    header.block_count = blocks.size();
+    header.built_sec = walk.built_at.tv_sec;
+    header.built_nsec = walk.built_at.tv_nsec;
+    header.root_mtime_sec = root_st.st_mtim.tv_sec;
+    header.root_mtime_nsec = root_st.st_mtim.tv_nsec;
+    header.root_offset = sizeof(LocateHeader);
+    header.root_length = walk.root.size();
+    header.blocks_offset = (header.root_offset + header.root_length + 7) & ~uint64_t(7);
+    header.data_offset = header.blocks_offset + blocks.size() * sizeof(uint64_t);
+    header.data_size = data.size();
+    header.data_hash = fnv1a(data.data(), data.size());
+    header.root_rules = root_rules;
+    header.above_rules = above_rules;
+    header.policy = policy_flags(walk.policy);
+
+    std::string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(walk.root.data(), walk.root.size());
+    static const char padding[8] = {};
+    out.write(padding, header.blocks_offset - header.root_offset - header.root_length);
+    out.write(reinterpret_cast<const char *>(blocks.data()), blocks.size() * sizeof(uint64_t));
+    out.write(data.data(), data.size());
+    out.close();
+    if (!out || rename(temp.c_str(), path.c_str()) != 0)
+    {
+        perror(temp.c_str());
+        unlink(temp.c_str());
+        return 0;
+    }
+    return header.data_offset + header.data_size;
+}
+
+// -------------------------
+// Builtins
+// -------------------------
+
+/**
+ * @brief Parses the --hidden and --no-ignore options shared by locate and jupdatedb.
+ * @return false if arg is neither.
+ */
+static bool parse_walk_option(const char *arg, WalkPolicy &policy)
+{
+    if (strcmp(arg, "--hidden") == 0)
+        policy.hidden = true;
+    else if (strcmp(arg, "--no-ignore") == 0)
+        policy.ignore_files = false;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Handles `jupdatedb [-o db] [--hidden] [--no-ignore] [root]`: writes the locate database.
+ *
+ * Directories unchanged since the previous database of the same root and
+ * policy are not read again. Pseudo filesystems such as /proc are not
+ * descended into, and hidden and ignored paths are left out as in a live
+ * locate walk.
+ *
+ * @return 0 on success, 1 on failure, 2 on usage errors.
+ */
+int handle_jupdatedb_command(int token_count, char *tokens[])
+{
+    std::string db_path = default_db_path();
+    std::string root_arg = ".";
+    UpdateWalk walk;
+    int i = 1;
+    for (; i < token_count && tokens[i][0] == '-'; ++i)
+    {
+        if (strcmp(tokens[i], "-o") == 0 && i + 1 < token_count)
+            db_path = tokens[++i];
+        else if (!parse_walk_option(tokens[i], walk.policy))
+            break;
+    }
+    if (i < token_count && tokens[i][0] != '-')
+        root_arg = tokens[i++];
+    if (i != token_count)
+    {
+        std::cerr << "Usage: jupdatedb [-o database] [--hidden] [--no-ignore] [root]\n";
+        return 2;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    clock_gettime(CLOCK_REALTIME, &walk.built_at);
+    char resolved[PATH_MAX];
+    struct stat root_st;
+    if (!realpath(root_arg.c_str(), resolved) || lstat(resolved, &root_st) != 0 || !S_ISDIR(root_st.st_mode))
+    {
+        perror(root_arg.c_str());
+        return 1;
+    }
+
+    walk.root = resolved;
+    walk.pruned = pseudo_mounts();
+    PreviousDb previous;
+    {
+        MappedDb old;
+        if (open_db(db_path, old, true) && old.root == walk.root && old.header->policy == policy_flags(walk.policy))
+        {
+            if (load_previous(old, previous))
+                walk.previous = &previous;
+            else
+                std::cerr << "jupdatedb: " << db_path << " is damaged; rebuilding it from scratch\n";
+        }
+    }
+
+    IgnoreStamp above;
+    WalkDir start = walk_root(walk.root, walk.policy, &above);
+    bool above_changed = walk.previous && walk.previous->above_rules != above.hash;
+    uint64_t root_rules = update_directory(walk, "", root_st.st_mtim, start.rules, above_changed);
+    std::sort(walk.entries.begin(), walk.entries.end(),
+              [](const LocateEntry &a, const LocateEntry &b) { return a.path < b.path; });
+    size_t bytes = write_db(db_path, walk, root_st, root_rules, recorded_stamp(walk, above));
+    if (!bytes)
+        return 1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printf("jupdatedb: %zu entries under %s (%zu of %zu directories unchanged), %.1f MiB in %.2f s\n",
+           walk.entries.size(), walk.root.c_str(), walk.reused, walk.directories, bytes / 1048576.0, seconds);
+    fflush(stdout);
+    return 0;
+}
+
+/**
+ * @brief Handles `locate [-d db] [--no-db] [--hidden] [--no-ignore] <term>`.
+ *
+ * Paths below the current directory containing term are printed as
+ * ./path, from the database when it covers the current directory and was
+ * built with the same policy, and from a live walk otherwise. The database
+ * shows the tree as of the last jupdatedb.
+ */
+int handle_locate_command(int token_count, char *tokens[])
+{
+    std::string db_path = default_db_path();
+    bool use_db = true;
+    WalkPolicy policy;
+    int i = 1;
+    for (; i < token_count && tokens[i][0] == '-'; ++i)
+    {
+        if (strcmp(tokens[i], "-d") == 0 && i + 1 < token_count)
+            db_path = tokens[++i];
+        else if (strcmp(tokens[i], "--no-db") == 0)
+            use_db = false;
+        else if (!parse_walk_option(tokens[i], policy))
+            break; // A term that starts with '-'
+    }
+    if (i + 1 != token_count)
+    {
+        std::cerr << "Usage: locate [-d database] [--no-db] [--hidden] [--no-ignore] <term>\n";
+        return 2;
+    }
+    std::string term = tokens[i];
+
+    if (use_db)
+    {
+        MappedDb db;
+        std::string prefix;
+        if (open_db(db_path, db, true) && db.header->policy == policy_flags(policy) && cwd_prefix(db, prefix))
+        {
+            locate_in_db(db, prefix, term);
+            return 0;
+        }
+    }
+    show_found_paths(find_paths_containing(".", term, policy));
+    return 0;
+}
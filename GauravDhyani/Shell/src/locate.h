@@ -0,0 +1,16 @@
+#ifndef LOCATE_H
+#define LOCATE_H
+
+#include <string>
+#include <vector>
+#include "walk.h"
+
+#define LOCATE_DB_FILE ".jam_locatedb" // In $HOME unless JAM_LOCATEDB names another file
+
+std::vector<std::string> find_paths_containing(const std::string &root, const std::string &term,
+                                               const WalkPolicy &policy);
+void show_found_paths(const std::vector<std::string> &paths);
+int handle_locate_command(int token_count, char *tokens[]);
+int handle_jupdatedb_command(int token_count, char *tokens[]);
+
+#endif // LOCATE_H
@@ -0,0 +1,1320 @@
+#include "matcher.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <memory>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define REGEX_MAX_STATES 100000   // NFA states over all patterns
+#define REGEX_MAX_REPEAT 1000     // Largest count in {m,n}
+#define REGEX_PREFILTER_MIN 3     // Shortest required literal worth searching for first
+#define DFA_MAX_STATES 4096       // Cached DFA states per thread before the cache is flushed
+
+// -------------------------
+// Line Helpers
+// -------------------------
+
+/**
+ * @brief Counts the newlines in [begin, end), 16 bytes at a time with SSE2.
+ */
+static size_t count_newlines(const char *begin, const char *end)
+{
+    size_t count = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - begin >= 16; begin += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+    }
+#endif
+    return count + std::count(begin, end, '\n');
+}
+
+/**
+ * @brief Copies a line with [hit, hit + length) highlighted in red.
+ */
+static std::string highlight(const char *begin, const char *hit, size_t length, const char *end)
+{
+    std::string highlighted;
+    highlighted.reserve(end - begin + 9);
+    highlighted.append(begin, hit);
+    highlighted.append("\033[31m");
+    highlighted.append(hit, length);
+    highlighted.append("\033[0m");
+    highlighted.append(hit + length, end);
+    return highlighted;
+}
+
+/**
+ * @brief Finds the line around a hit: back to the previous newline (but not
+ *        before floor) and forward to the next one.
+ */
+static void line_around(const char *hit, const char *floor, const char *end, const char *&line_start,
+                        const char *&line_end)
+{
+    line_start = hit;
+    while (line_start > floor && line_start[-1] != '\n')
+        --line_start;
+    line_end = static_cast<const char *>(memchr(hit, '\n', end - hit));
+    if (!line_end)
+        line_end = end;
+}
+
+/**
+ * @brief Finds the lines of a buffer that contain one literal.
+ *
+ * The whole buffer is searched with find_substring(), and line
+ * boundaries and numbers are only worked out around each hit, so text
+ * without matches is never split into lines.
+ *
+ * @param data      File contents.
+ * @param size      Length of data.
+ * @param pattern   String to search for.
+ * @param max_lines Stop after this many matching lines.
+ * @param results   Receives (line number, line with the first hit highlighted).
+ */
+static void find_literal_lines(const char *data, size_t size, const std::string &pattern, size_t max_lines,
+                               std::vector<std::pair<int, std::string>> &results)
+{
+    const char *end = data + size;
+    const char *counted = data; // Newlines before this point are in lineno
+    int lineno = 1;
+    const char *pos = data;
+    while (pos < end && results.size() < max_lines)
+    {
+        const char *hit = find_substring(pos, end - pos, pattern.data(), pattern.size());
+        if (!hit)
+            break;
+        const char *line_start, *line_end;
+        line_around(hit, pos, end, line_start, line_end);
+        if (hit + pattern.size() > line_end)
+        {
+            // Multi-line pattern spans a newline; no single line contains it.
+            pos = line_end + 1;
+            continue;
+        }
+
+        lineno += count_newlines(counted, line_start);
+        counted = line_start;
+        results.emplace_back(lineno, highlight(line_start, hit, pattern.size(), line_end));
+        pos = line_end + 1;
+    }
+}
+
+// -------------------------
+// Aho-Corasick
+// -------------------------
+
+/**
+ * @brief Builds the automaton for a set of non-empty literals.
+ *
+ * Failure links are folded into a full transition table, so scanning is
+ * one table lookup per byte whatever the number of literals. Columns are
+ * only made for bytes that occur in some literal, and states that end a
+ * literal are numbered last, so one comparison tells whether a state has
+ * output.
+ */
+void AhoCorasick::build(const std::vector<std::string> &literals)
+{
+    lengths.clear();
+    for (const auto &literal : literals)
+        lengths.push_back(literal.size());
+    only = literals.size() == 1 ? literals[0] : std::string();
+
+    memset(byte_class, 0, sizeof(byte_class));
+    int classes = 1;
+    for (const auto &literal : literals)
+        for (unsigned char c : literal)
+            if (!byte_class[c])
+                byte_class[c] = classes++;
+
+    // Trie of the literals; -1 marks a missing edge.
+    std::vector<int32_t> trie(classes, -1);
+    std::vector<std::vector<uint32_t>> ends(1);
+    for (uint32_t i = 0; i < literals.size(); ++i)
+    {
+        int32_t node = 0;
+        for (unsigned char c : literals[i])
+        {
+            int32_t &edge = trie[node * classes + byte_class[c]];
+            if (edge < 0)
+            {
+                edge = ends.size();
+                ends.emplace_back();
+                trie.resize(trie.size() + classes, -1);
+            }
+            node = trie[node * classes + byte_class[c]];
+        }
+        ends[node].push_back(i);
+    }
+
+    // Breadth-first: failure links, full transitions and output lists.
+    // A node's failure target is shallower, so its outputs are complete.
+    size_t nodes = ends.size();
+    std::vector<int32_t> fail(nodes, 0), queue;
+    for (int col = 0; col < classes; ++col)
+    {
+        int32_t child = trie[col];
+        if (child < 0)
+            trie[col] = 0;
+        else
+            queue.push_back(child);
+    }
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        int32_t node = queue[head];
+        const auto &inherited = ends[fail[node]];
+        ends[node].insert(ends[node].end(), inherited.begin(), inherited.end());
+        for (int col = 0; col < classes; ++col)
+        {
+            int32_t &edge = trie[node * classes + col];
+            int32_t fallback = trie[fail[node] * classes + col];
+            if (edge < 0)
+                edge = fallback;
+            else
+            {
+                fail[edge] = fallback;
+                queue.push_back(edge);
+            }
+        }
+    }
+
+    // Renumber: states without output first (the root stays 0), and name
+    // each state by its row offset in a table with power-of-two rows.
+    shift = 0;
+    while ((1 << shift) < classes)
+        ++shift;
+    std::vector<int32_t> renumber(nodes);
+    int32_t id = 0;
+    for (size_t node = 0; node < nodes; ++node)
+        if (ends[node].empty())
+            renumber[node] = id++ << shift;
+    first_output = id << shift;
+    out_begin.assign(1, 0);
+    out.clear();
+    for (size_t node = 0; node < nodes; ++node)
+        if (!ends[node].empty())
+        {
+            renumber[node] = id++ << shift;
+            out.insert(out.end(), ends[node].begin(), ends[node].end());
+            out_begin.push_back(out.size());
+        }
+    next.assign(nodes << shift, 0);
+    for (size_t node = 0; node < nodes; ++node)
+        for (int col = 0; col < classes; ++col)
+            next[renumber[node] + col] = renumber[trie[node * classes + col]];
+
+    memset(starts, 0, sizeof(starts));
+    for (const auto &literal : literals)
+        starts[static_cast<unsigned char>(literal[0])] = true;
+}
+
+/**
+ * @brief Finds the first place a literal ends in [begin, end).
+ *
+ * @param begin    Start of the text; the automaton starts from its root here.
+ * @param end      End of the text.
+ * @param hit_end  Receives the end of the hit.
+ * @return Start of the longest literal ending there, or nullptr.
+ */
+const char *AhoCorasick::find(const char *begin, const char *end, const char **hit_end) const
+{
+    if (!only.empty())
+    {
+        const char *hit = find_substring(begin, end - begin, only.data(), only.size());
+        if (hit)
+            *hit_end = hit + only.size();
+        return hit;
+    }
+    int32_t row = 0;
+    for (const char *p = begin; p < end; ++p)
+    {
+        // At the root only a literal's first byte leads anywhere.
+        while (row == 0 && p < end && !starts[static_cast<unsigned char>(*p)])
+            ++p;
+        if (p == end)
+            break;
+        row = step(row, *p);
+        if (row < first_output)
+            continue;
+        uint32_t longest = 0;
+        for (const uint32_t *id = outputs_begin(row); id != outputs_end(row); ++id)
+            longest = std::max(longest, lengths[*id]);
+        *hit_end = p + 1;
+        return p + 1 - longest;
+    }
+    return nullptr;
+}
+
+// -------------------------
+// Regex Parsing
+// -------------------------
+
+// A node of a parsed regular expression.
+struct RegexNode {
+    enum Kind : uint8_t { Empty, Bytes, Concat, Alternate, Repeat, LineStart, LineEnd } kind = Empty;
+    ByteSet set;               // Bytes
+    std::vector<int> children; // Concat, Alternate; Repeat has one
+    int min = 0, max = 0;      // Repeat; max < 0 means no limit
+};
+
+/**
+ * @brief Adds the bytes of a \d, \w or \s style class to set.
+ * @return false if c names no class.
+ */
+static bool escape_class(char c, ByteSet &set)
+{
+    ByteSet bytes;
+    for (int b = 0; b < 256; ++b)
+    {
+        switch (tolower(c))
+        {
+        case 'd': bytes[b] = isdigit(b); break;
+        case 'w': bytes[b] = isalnum(b) || b == '_'; break;
+        case 's': bytes[b] = isspace(b); break;
+        default: return false;
+        }
+    }
+    if (isupper(static_cast<unsigned char>(c)))
+    {
+        bytes.flip();
+        bytes.reset('\n');
+    }
+    set |= bytes;
+    return true;
+}
+
+/**
+ * @brief Adds the bytes of a POSIX class name such as "alpha" to set.
+ */
+static bool posix_class(const std::string &name, ByteSet &set)
+{
+    static const std::pair<const char *, int (*)(int)> classes[] = {
+        {"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum}, {"space", isspace}, {"upper", isupper},
+        {"lower", islower}, {"punct", ispunct},  {"xdigit", isxdigit}, {"blank", isblank}, {"print", isprint},
+        {"graph", isgraph}, {"cntrl", iscntrl},
+    };
+    for (const auto &[class_name, test] : classes)
+    {
+        if (name != class_name)
+            continue;
+        for (int b = 0; b < 256; ++b)
+            if (test(b))
+                set.set(b);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Turns \t, \n and friends into their byte; other escapes stand for themselves.
+ */
+static char escaped_byte(char c)
+{
+    switch (c)
+    {
+    case 't': return '\t';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default: return c;
+    }
+}
+
+// Recursive-descent parser for the extended regular expressions grep -E
+// takes, plus \d, \w and \s. Matching is by byte, line by line.
+class RegexParser
+{
+public:
+    explicit RegexParser(const std::string &text) : text(text) {}
+
+    /**
+     * @brief Parses the whole expression.
+     * @return Root node, or -1 with error set.
+     */
+    int parse()
+    {
+        int root = parse_alternation();
+        if (root >= 0 && pos < text.size())
+            return fail("unmatched )");
+        return root;
+    }
+
+    std::vector<RegexNode> nodes;
+    std::string error;
+
+private:
+    int fail(const std::string &message)
+    {
+        if (error.empty())
+            error = message;
+        return -1;
+    }
+
+    int add(RegexNode node)
+    {
+        nodes.push_back(std::move(node));
+        return nodes.size() - 1;
+    }
+
+    int add_bytes(const ByteSet &set)
+    {
+        RegexNode node;
+        node.kind = RegexNode::Bytes;
+        node.set = set;
+        return add(std::move(node));
+    }
+
+    int parse_alternation()
+    {
+        RegexNode node;
+        node.kind = RegexNode::Alternate;
+        node.children.push_back(parse_concat());
+        while (node.children.back() >= 0 && pos < text.size() && text[pos] == '|')
+        {
+            ++pos;
+            node.children.push_back(parse_concat());
+        }
+        if (node.children.back() < 0)
+            return -1;
+        return node.children.size() == 1 ? node.children[0] : add(std::move(node));
+    }
+
+    int parse_concat()
+    {
+        RegexNode node;
+        node.kind = RegexNode::Concat;
+        while (pos < text.size() && text[pos] != '|' && text[pos] != ')')
+        {
+            int item = parse_repeat();
+            if (item < 0)
+                return -1;
+            node.children.push_back(item);
+        }
+        if (node.children.empty())
+            return add(RegexNode());
+        return node.children.size() == 1 ? node.children[0] : add(std::move(node));
+    }
+
+    int parse_repeat()
+    {
+        int atom = parse_atom();
+        while (atom >= 0 && pos < text.size())
+        {
+            RegexNode node;
+            node.kind = RegexNode::Repeat;
+            char c = text[pos];
+            if (c == '*')
+                node.min = 0, node.max = -1;
+            else if (c == '+')
+                node.min = 1, node.max = -1;
+            else if (c == '?')
+                node.min = 0, node.max = 1;
+            else if (c == '{')
+            {
+                if (!parse_braces(node.min, node.max))
+                    return fail("invalid repetition count");
+            }
+            else
+                break;
+            ++pos;
+            node.children.push_back(atom);
+            atom = add(std::move(node));
+        }
+        return atom;
+    }
+
+    // Parses {m}, {m,} or {m,n}, leaving pos on the closing brace.
+    bool parse_braces(int &min, int &max)
+    {
+        size_t p = pos + 1;
+        auto number = [&](int &value) {
+            if (p >= text.size() || !isdigit(static_cast<unsigned char>(text[p])))
+                return false;
+            value = 0;
+            while (p < text.size() && isdigit(static_cast<unsigned char>(text[p])) && value <= REGEX_MAX_REPEAT)
+                value = value * 10 + (text[p++] - '0');
+            return value <= REGEX_MAX_REPEAT;
+        };
+        if (!number(min))
+            return false;
+        max = min;
+        if (p < text.size() && text[p] == ',')
+        {
+            ++p;
+            max = -1;
+            if (p < text.size() && text[p] != '}' && !number(max))
+                return false;
+        }
+        if (p >= text.size() || text[p] != '}' || (max >= 0 && max < min))
+            return false;
+        pos = p;
+        return true;
+    }
+
+    int parse_atom()
+    {
+        char c = text[pos++];
+        ByteSet set;
+        switch (c)
+        {
+        case '(':
+        {
+            if (text.compare(pos, 2, "?:") == 0)
+                pos += 2;
+            int inner = parse_alternation();
+            if (inner < 0)
+                return -1;
+            if (pos >= text.size() || text[pos] != ')')
+                return fail("missing )");
+            ++pos;
+            return inner;
+        }
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            return fail(std::string("nothing to repeat before ") + c);
+        case '[':
+            return parse_class(set) ? add_bytes(set) : -1;
+        case '.':
+            set.set();
+            set.reset('\n');
+            return add_bytes(set);
+        case '^':
+        case '$':
+        {
+            RegexNode node;
+            node.kind = c == '^' ? RegexNode::LineStart : RegexNode::LineEnd;
+            return add(std::move(node));
+        }
+        case '\\':
+            if (pos >= text.size())
+                return fail("trailing backslash");
+            c = text[pos++];
+            if (escape_class(c, set))
+                return add_bytes(set);
+            if (isalnum(static_cast<unsigned char>(c)) && escaped_byte(c) == c)
+                return fail(std::string("unsupported escape \\") + c);
+            c = escaped_byte(c);
+            break;
+        }
+        set.set(static_cast<unsigned char>(c));
+        return add_bytes(set);
+    }
+
+    // Parses a bracket expression after its '['.
+    bool parse_class(ByteSet &set)
+    {
+        bool negate = pos < text.size() && text[pos] == '^';
+        if (negate)
+            ++pos;
+        for (bool first = true;; first = false)
+        {
+            if (pos >= text.size())
+            {
+                fail("missing ]");
+                return false;
+            }
+            char c = text[pos];
+            if (c == ']' && !first)
+            {
+                ++pos;
+                break;
+            }
+            if (c == '[' && text.compare(pos, 2, "[:") == 0)
+            {
+                size_t close = text.find(":]", pos + 2);
+                if (close == std::string::npos || !posix_class(text.substr(pos + 2, close - pos - 2), set))
+                {
+                    fail("unknown character class");
+                    return false;
+                }
+                pos = close + 2;
+                continue;
+            }
+            unsigned char low;
+            if (!class_byte(set, low))
+                continue; // \d and friends were added whole
+            unsigned char high = low;
+            if (pos + 1 < text.size() && text[pos] == '-' && text[pos + 1] != ']')
+            {
+                ++pos;
+                ByteSet unused;
+                if (!class_byte(unused, high) || high < low)
+                {
+                    fail("invalid range");
+                    return false;
+                }
+            }
+            for (int b = low; b <= high; ++b)
+                set.set(b);
+        }
+        if (negate)
+        {
+            set.flip();
+            set.reset('\n');
+        }
+        return true;
+    }
+
+    // Reads one byte of a bracket expression; false if it was a class escape.
+    bool class_byte(ByteSet &set, unsigned char &byte)
+    {
+        char c = text[pos++];
+        if (c == '\\' && pos < text.size())
+        {
+            c = text[pos++];
+            if (escape_class(c, set))
+                return false;
+            c = escaped_byte(c);
+        }
+        byte = static_cast<unsigned char>(c);
+        return true;
+    }
+
+    const std::string &text;
+    size_t pos = 0;
+};
+
+// What is known about the literal text of a node's matches.
+struct LiteralInfo {
+    bool exact = false; // Every match is exactly text
+    std::string text;
+    std::string best;   // A literal every match contains
+};
+
+/**
+ * @brief Works out a literal that every match of a node must contain.
+ *
+ * Runs of single bytes in a concatenation are joined, so "foo[0-9]+bar"
+ * requires "foo" and "bar" and reports the longer. Alternation and
+ * optional parts give up, except where every branch is the same text.
+ */
+static LiteralInfo literal_info(const std::vector<RegexNode> &nodes, int index)
+{
+    const RegexNode &node = nodes[index];
+    LiteralInfo info;
+    auto keep_longest = [&](const std::string &candidate) {
+        if (candidate.size() > info.best.size())
+            info.best = candidate;
+    };
+    switch (node.kind)
+    {
+    case RegexNode::Empty:
+    case RegexNode::LineStart:
+    case RegexNode::LineEnd:
+        info.exact = true;
+        break;
+    case RegexNode::Bytes:
+        if (node.set.count() == 1)
+        {
+            info.exact = true;
+            for (int b = 0; b < 256; ++b)
+                if (node.set[b])
+                    info.text = info.best = std::string(1, static_cast<char>(b));
+        }
+        break;
+    case RegexNode::Concat:
+    {
+        info.exact = true;
+        std::string run;
+        for (int child : node.children)
+        {
+            LiteralInfo part = literal_info(nodes, child);
+            if (part.exact)
+            {
+                run += part.text;
+                continue;
+            }
+            info.exact = false;
+            keep_longest(run);
+            keep_longest(part.best);
+            run.clear();
+        }
+        keep_longest(run);
+        if (info.exact)
+            info.text = run;
+        break;
+    }
+    case RegexNode::Alternate:
+    {
+        LiteralInfo first = literal_info(nodes, node.children[0]);
+        info = first;
+        for (size_t i = 1; i < node.children.size(); ++i)
+        {
+            LiteralInfo other = literal_info(nodes, node.children[i]);
+            if (!(first.exact && other.exact && other.text == first.text))
+                return LiteralInfo();
+        }
+        break;
+    }
+    case RegexNode::Repeat:
+        if (node.min == 0)
+            break;
+        info = literal_info(nodes, node.children[0]);
+        if (info.exact && node.max == node.min && info.text.size() * node.min <= 256)
+        {
+            std::string once = info.text;
+            for (int i = 1; i < node.min; ++i)
+                info.text += once;
+            info.best = info.text;
+        }
+        else
+            info.exact = false;
+        break;
+    }
+    return info;
+}
+
+// -------------------------
+// Regex Compilation
+// -------------------------
+
+// A piece of NFA with one entry and one exit; end is a Split whose out is unset.
+struct Fragment {
+    int32_t start, end;
+};
+
+static int32_t add_state(RegexProgram &program, RegexProgram::State::Kind kind)
+{
+    RegexProgram::State state;
+    state.kind = kind;
+    program.states.push_back(state);
+    return program.states.size() - 1;
+}
+
+/**
+ * @brief Compiles a parsed node into Thompson NFA states.
+ *
+ * Counted repeats are expanded, so the state count is checked by the
+ * caller against REGEX_MAX_STATES; compilation stops adding states once
+ * the limit is passed.
+ */
+static Fragment compile_node(const std::vector<RegexNode> &nodes, int index, RegexProgram &program)
+{
+    using State = RegexProgram::State;
+    const RegexNode &node = nodes[index];
+    int32_t entry = add_state(program, State::Split);
+    Fragment fragment{entry, entry};
+    if (program.states.size() > REGEX_MAX_STATES)
+        return fragment;
+
+    auto append = [&](Fragment next) {
+        program.states[fragment.end].out = next.start;
+        fragment.end = next.end;
+    };
+    switch (node.kind)
+    {
+    case RegexNode::Empty:
+        break;
+    case RegexNode::Bytes:
+    case RegexNode::LineStart:
+    case RegexNode::LineEnd:
+    {
+        State::Kind kind = node.kind == RegexNode::Bytes       ? State::Bytes
+                           : node.kind == RegexNode::LineStart ? State::LineStart
+                                                               : State::LineEnd;
+        int32_t state = add_state(program, kind);
+        if (kind == State::Bytes)
+        {
+            program.states[state].set = program.sets.size();
+            program.sets.push_back(node.set);
+        }
+        int32_t exit = add_state(program, State::Split);
+        program.states[state].out = exit;
+        append({state, exit});
+        break;
+    }
+    case RegexNode::Concat:
+        for (int child : node.children)
+            append(compile_node(nodes, child, program));
+        break;
+    case RegexNode::Alternate:
+    {
+        int32_t exit = add_state(program, State::Split);
+        int32_t chooser = entry;
+        for (size_t i = 0; i < node.children.size(); ++i)
+        {
+            Fragment branch = compile_node(nodes, node.children[i], program);
+            program.states[branch.end].out = exit;
+            program.states[chooser].out = branch.start;
+            if (i + 1 < node.children.size())
+            {
+                int32_t next_chooser = add_state(program, State::Split);
+                program.states[chooser].out1 = next_chooser;
+                chooser = next_chooser;
+            }
+        }
+        fragment.end = exit;
+        break;
+    }
+    case RegexNode::Repeat:
+    {
+        for (int i = 0; i < node.min; ++i)
+            append(compile_node(nodes, node.children[0], program));
+        int32_t exit = add_state(program, State::Split);
+        if (node.max < 0)
+        {
+            // loop: out = body (which returns to loop), out1 = exit
+            int32_t loop = add_state(program, State::Split);
+            Fragment body = compile_node(nodes, node.children[0], program);
+            program.states[loop].out = body.start;
+            program.states[loop].out1 = exit;
+            program.states[body.end].out = loop;
+            program.states[fragment.end].out = loop;
+        }
+        else
+        {
+            // Nested optional copies: each may be skipped straight to exit.
+            for (int i = node.min; i < node.max; ++i)
+            {
+                int32_t option = add_state(program, State::Split);
+                program.states[option].out1 = exit;
+                Fragment body = compile_node(nodes, node.children[0], program);
+                program.states[option].out = body.start;
+                program.states[fragment.end].out = option;
+                fragment.end = body.end;
+            }
+            program.states[fragment.end].out = exit;
+        }
+        fragment.end = exit;
+        break;
+    }
+    }
+    return fragment;
+}
+
+/**
+ * @brief Groups bytes that no byte set tells apart, so DFA rows stay narrow.
+ */
+static void compute_byte_classes(RegexProgram &program)
+{
+    std::vector<int> group(256, 0);
+    int groups = 1;
+    for (const ByteSet &set : program.sets)
+    {
+        std::map<std::pair<int, bool>, int> split;
+        for (int b = 0; b < 256; ++b)
+        {
+            auto key = std::make_pair(group[b], static_cast<bool>(set[b]));
+            auto found = split.find(key);
+            if (found == split.end())
+                found = split.emplace(key, split.size()).first;
+            group[b] = found->second;
+        }
+        groups = split.size();
+    }
+    for (int b = 0; b < 256; ++b)
+        program.byte_class[b] = group[b];
+    program.classes = groups;
+}
+
+// -------------------------
+// Lazy DFA
+// -------------------------
+
+#define DFA_MATCH 1     // A match ends here
+#define DFA_EOL_MATCH 2 // A match ends here if the line ends here
+#define DFA_DEAD 4      // No match can follow (anchored runs only)
+
+// DFA states built from NFA state sets as scanning needs them. Unanchored
+// DFAs restart the NFA at every byte, so they find matches anywhere in a
+// line; anchored ones only match from where they were started. States are
+// named by their row offset in the transition table, as in AhoCorasick.
+class LazyDfa
+{
+public:
+    LazyDfa(const RegexProgram &program, uint64_t serial, bool anchored)
+        : serial(serial), program(program), anchored(anchored), mark(program.states.size(), 0)
+    {
+        while ((1 << shift) < program.classes)
+            ++shift;
+    }
+
+    /**
+     * @brief Returns the state to start from, at the start of a line or not.
+     */
+    int32_t start(bool at_line_start)
+    {
+        // Prepared here, as it may flush states a caller still holds.
+        if (!anchored && restart < 0)
+            prepare_restart();
+        if (starts[at_line_start] < 0)
+        {
+            roots.assign(1, program.start);
+            closure(at_line_start, target);
+            int32_t row = intern(target);
+            starts[at_line_start] = row;
+        }
+        return starts[at_line_start];
+    }
+
+    /**
+     * @brief Follows one byte; only the first visit to a transition builds it.
+     */
+    int32_t step(int32_t row, unsigned char byte)
+    {
+        int32_t next = transitions[row + program.byte_class[byte]];
+        return next >= 0 ? next : build_step(row, byte);
+    }
+
+    /**
+     * @brief Steps through [p, end) until a state with any of stop_flags.
+     *
+     * The tables are read through local pointers, reloaded only when a new
+     * transition is built, so each byte costs one dependent lookup.
+     *
+     * @param row State; updated.
+     * @return Where scanning stopped: the byte after the flagged state, or end.
+     */
+    const char *run(int32_t &row, const char *p, const char *end, uint8_t stop_flags)
+    {
+        const int32_t *table = transitions.data();
+        const uint8_t *flags = state_flags.data();
+        const uint16_t *byte_class = program.byte_class;
+        int32_t s = row;
+        while (p < end && !(flags[s >> shift] & stop_flags))
+        {
+            // Nothing under way: skip bytes that cannot start a match.
+            if (s == restart)
+            {
+                while (p < end && stays[static_cast<unsigned char>(*p)])
+                    ++p;
+                if (p == end)
+                    break;
+            }
+            unsigned char byte = *p++;
+            int32_t next = table[s + byte_class[byte]];
+            if (next < 0)
+            {
+                next = build_step(s, byte);
+                table = transitions.data();
+                flags = state_flags.data();
+            }
+            s = next;
+        }
+        row = s;
+        return p;
+    }
+
+    uint8_t flags(int32_t row) const { return state_flags[row >> shift]; }
+    const std::vector<uint32_t> &matches(int32_t row, bool at_line_end) const
+    {
+        return at_line_end ? eol_matches[row >> shift] : now_matches[row >> shift];
+    }
+
+    const uint64_t serial;
+
+private:
+    // Finds the unanchored state in which no match has begun. A byte no
+    // state in it accepts only restarts the NFA, which leads back to it.
+    void prepare_restart()
+    {
+        roots.assign(1, program.start);
+        closure(false, target);
+        ByteSet accepted;
+        for (int32_t s : target)
+            if (program.states[s].kind == RegexProgram::State::Bytes)
+                accepted |= program.sets[program.states[s].set];
+        for (int b = 0; b < 256; ++b)
+            stays[b] = !accepted[b];
+        restart = intern(target);
+    }
+
+    // Expands roots over Split and (at a line start) LineStart states.
+    void closure(bool at_line_start, std::vector<int32_t> &result)
+    {
+        ++generation;
+        result.clear();
+        while (!roots.empty())
+        {
+            int32_t s = roots.back();
+            roots.pop_back();
+            if (s < 0 || mark[s] == generation)
+                continue;
+            mark[s] = generation;
+            const RegexProgram::State &state = program.states[s];
+            if (state.kind == RegexProgram::State::Split)
+            {
+                roots.push_back(state.out1);
+                roots.push_back(state.out);
+            }
+            else if (state.kind == RegexProgram::State::LineStart)
+            {
+                if (at_line_start)
+                    roots.push_back(state.out);
+            }
+            else
+                result.push_back(s);
+        }
+        std::sort(result.begin(), result.end());
+    }
+
+    int32_t build_step(int32_t row, unsigned char byte)
+    {
+        roots.clear();
+        for (int32_t s : sets[row >> shift])
+        {
+            const RegexProgram::State &nfa = program.states[s];
+            if (nfa.kind == RegexProgram::State::Bytes && program.sets[nfa.set][byte])
+                roots.push_back(nfa.out);
+        }
+        if (!anchored)
+            roots.push_back(program.start);
+        closure(false, target);
+
+        uint64_t before = flushes;
+        int32_t next = intern(target);
+        if (flushes == before)
+            transitions[row + program.byte_class[byte]] = next;
+        return next;
+    }
+
+    // Returns the DFA state for an NFA state set, adding it if new.
+    int32_t intern(const std::vector<int32_t> &set)
+    {
+        auto found = ids.find(set);
+        if (found != ids.end())
+            return found->second;
+        if (sets.size() >= DFA_MAX_STATES)
+            flush();
+
+        int32_t row = sets.size() << shift;
+        ids.emplace(set, row);
+        sets.push_back(set);
+        transitions.resize(transitions.size() + (size_t(1) << shift), -1);
+
+        std::vector<uint32_t> now, at_end;
+        std::vector<int32_t> after_end;
+        for (int32_t s : set)
+        {
+            const RegexProgram::State &state = program.states[s];
+            if (state.kind == RegexProgram::State::Match)
+                now.push_back(state.pattern);
+            else if (state.kind == RegexProgram::State::LineEnd)
+                roots.push_back(state.out);
+        }
+        closure(false, after_end);
+        at_end = now;
+        for (int32_t s : after_end)
+            if (program.states[s].kind == RegexProgram::State::Match)
+                at_end.push_back(program.states[s].pattern);
+        std::sort(at_end.begin(), at_end.end());
+        at_end.erase(std::unique(at_end.begin(), at_end.end()), at_end.end());
+
+        state_flags.push_back((now.empty() ? 0 : DFA_MATCH) | (at_end.empty() ? 0 : DFA_EOL_MATCH) |
+                              (set.empty() ? DFA_DEAD : 0));
+        now_matches.push_back(std::move(now));
+        eol_matches.push_back(std::move(at_end));
+        return row;
+    }
+
+    // Drops every cached state; callers only hold on to the next one.
+    void flush()
+    {
+        ids.clear();
+        sets.clear();
+        transitions.clear();
+        state_flags.clear();
+        now_matches.clear();
+        eol_matches.clear();
+        starts[0] = starts[1] = restart = -1;
+        ++flushes;
+    }
+
+    const RegexProgram &program;
+    const bool anchored;
+    int shift = 0; // Rows of transitions are 1 << shift wide
+    std::map<std::vector<int32_t>, int32_t> ids;
+    std::vector<std::vector<int32_t>> sets;
+    std::vector<int32_t> transitions; // row + class -> next row; -1 until built
+    std::vector<uint8_t> state_flags;
+    std::vector<std::vector<uint32_t>> now_matches, eol_matches;
+    int32_t starts[2] = {-1, -1};
+    int32_t restart = -1; // Unanchored: nothing matched so far
+    bool stays[256] = {}; // Bytes that leave restart where it is
+    uint64_t flushes = 0;
+    std::vector<uint32_t> mark; // Closure visit marks, by generation
+    uint32_t generation = 0;
+    std::vector<int32_t> roots, target;
+};
+
+/**
+ * @brief Returns this thread's DFA cache for a matcher.
+ *
+ * Workers share the compiled program but each grows its own DFA, so
+ * scanning never takes a lock.
+ */
+static LazyDfa &thread_dfa(const RegexProgram &program, uint64_t serial, bool anchored)
+{
+    static thread_local std::unique_ptr<LazyDfa> caches[2];
+    std::unique_ptr<LazyDfa> &cache = caches[anchored];
+    if (!cache || cache->serial != serial)
+        cache = std::make_unique<LazyDfa>(program, serial, anchored);
+    return *cache;
+}
+
+// -------------------------
+// Matcher
+// -------------------------
+
+/**
+ * @brief Compiles the patterns sgown looks for.
+ *
+ * One literal is searched with find_substring() and several with an
+ * Aho-Corasick automaton. Regular expressions are joined into one NFA
+ * and run as a lazy DFA; when every pattern requires some literal of
+ * at least REGEX_PREFILTER_MIN bytes, only lines containing one of those
+ * literals are run through the DFA.
+ *
+ * @param list     Patterns, in the order counts are reported.
+ * @param as_regex Treat patterns as extended regular expressions.
+ * @param error    Receives a message if a pattern is invalid.
+ * @return false on error.
+ */
+bool Matcher::compile(const std::vector<std::string> &list, bool as_regex, std::string &error)
+{
+    static std::atomic<uint64_t> serials{0};
+    serial = ++serials;
+    patterns = list;
+    regex = as_regex;
+    if (patterns.empty())
+    {
+        error = "no pattern given";
+        return false;
+    }
+    if (!regex)
+    {
+        for (const auto &pattern : patterns)
+            if (pattern.empty())
+            {
+                error = "empty pattern";
+                return false;
+            }
+        if (patterns.size() > 1)
+            literals.build(patterns);
+        return true;
+    }
+
+    program = RegexProgram();
+    required.clear();
+    int32_t chooser = add_state(program, RegexProgram::State::Split);
+    program.start = chooser;
+    for (uint32_t i = 0; i < patterns.size(); ++i)
+    {
+        RegexParser parser(patterns[i]);
+        int root = parser.parse();
+        if (root < 0)
+        {
+            error = patterns[i] + ": " + parser.error;
+            return false;
+        }
+        Fragment fragment = compile_node(parser.nodes, root, program);
+        int32_t match = add_state(program, RegexProgram::State::Match);
+        program.states[match].pattern = i;
+        program.states[fragment.end].out = match;
+        program.states[chooser].out = fragment.start;
+        if (i + 1 < patterns.size())
+        {
+            int32_t next = add_state(program, RegexProgram::State::Split);
+            program.states[chooser].out1 = next;
+            chooser = next;
+        }
+        required.push_back(literal_info(parser.nodes, root).best);
+    }
+    if (program.states.size() > REGEX_MAX_STATES)
+    {
+        error = "pattern too large";
+        return false;
+    }
+    compute_byte_classes(program);
+
+    use_prefilter = std::all_of(required.begin(), required.end(),
+                                [](const std::string &literal) { return literal.size() >= REGEX_PREFILTER_MIN; });
+    if (use_prefilter)
+        prefilter.build(required);
+    return true;
+}
+
+/**
+ * @brief Lists literals such that every matching line contains one of them.
+ *
+ * Used to narrow a search with the trigram index.
+ *
+ * @return false if some regex pattern has no usable literal.
+ */
+bool Matcher::required_literals(std::vector<std::string> &list) const
+{
+    if (regex && !use_prefilter)
+        return false;
+    list = regex ? required : patterns;
+    return true;
+}
+
+/**
+ * @brief Checks one line against several literals.
+ *
+ * The line is scanned once from the automaton's root, which finds every
+ * literal in it; the leftmost (then longest) is highlighted.
+ */
+bool Matcher::check_literals(const char *begin, const char *end, FileMatches &matches, int lineno) const
+{
+    std::vector<uint32_t> found;
+    const char *best = nullptr;
+    size_t best_length = 0;
+    int32_t row = 0;
+    for (const char *p = begin; p < end; ++p)
+    {
+        row = literals.step(row, *p);
+        if (row < literals.first_output)
+            continue;
+        for (const uint32_t *output = literals.outputs_begin(row); output != literals.outputs_end(row); ++output)
+        {
+            uint32_t id = *output;
+            const char *start = p + 1 - literals.lengths[id];
+            found.push_back(id);
+            if (!best || start < best || (start == best && literals.lengths[id] > best_length))
+            {
+                best = start;
+                best_length = literals.lengths[id];
+            }
+        }
+    }
+    if (found.empty())
+        return false;
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    matches.lines.emplace_back(lineno, highlight(begin, best, best_length, end));
+    matches.patterns.push_back(std::move(found));
+    return true;
+}
+
+/**
+ * @brief Checks one line against the regular expressions.
+ *
+ * The unanchored DFA finds which patterns match; with one pattern it
+ * stops at the first match. The highlighted span is then the leftmost
+ * longest match, found with the anchored DFA from each start in turn.
+ */
+bool Matcher::check_regex(const char *begin, const char *end, FileMatches &matches, int lineno) const
+{
+    LazyDfa &dfa = thread_dfa(program, serial, false);
+    bool several = patterns.size() > 1;
+    std::vector<uint32_t> found;
+    int32_t state = dfa.start(true);
+    const char *p = begin;
+    while (true)
+    {
+        p = dfa.run(state, p, end, DFA_MATCH);
+        bool at_end = p == end;
+        if (dfa.flags(state) & (at_end ? DFA_EOL_MATCH : DFA_MATCH))
+        {
+            const auto &ids = dfa.matches(state, at_end);
+            found.insert(found.end(), ids.begin(), ids.end());
+            if (!several)
+                break;
+        }
+        if (at_end)
+            break;
+        state = dfa.step(state, *p++);
+    }
+    if (found.empty())
+        return false;
+
+    LazyDfa &anchored = thread_dfa(program, serial, true);
+    const char *hit = begin, *hit_end = begin;
+    for (const char *from = begin; from <= end; ++from)
+    {
+        const char *last = nullptr;
+        state = anchored.start(from == begin);
+        for (p = from;; ++p)
+        {
+            uint8_t flags = anchored.flags(state);
+            if (flags & (p == end ? DFA_EOL_MATCH : DFA_MATCH))
+                last = p;
+            if (p == end || (flags & DFA_DEAD))
+                break;
+            state = anchored.step(state, *p);
+        }
+        if (last)
+        {
+            hit = from;
+            hit_end = last;
+            break;
+        }
+    }
+
+    matches.lines.emplace_back(lineno, highlight(begin, hit, hit_end - hit, end));
+    if (several)
+    {
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        matches.patterns.push_back(std::move(found));
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the matching lines of a buffer in one pass.
+ *
+ * With a literal finder (several literals, or regexes with required
+ * literals), only lines around its hits are examined, and line numbers are
+ * counted between hits; otherwise every line goes through the DFA.
+ *
+ * @param data      File contents.
+ * @param size      Length of data.
+ * @param max_lines Stop after this many matching lines.
+ * @param matches   Receives the lines and, with several patterns, which
+ *                  patterns each line matches.
+ */
+void Matcher::find_lines(const char *data, size_t size, size_t max_lines, FileMatches &matches) const
+{
+    if (!regex && patterns.size() == 1)
+    {
+        find_literal_lines(data, size, patterns[0], max_lines, matches.lines);
+        return;
+    }
+
+    const char *end = data + size;
+    if (regex && !use_prefilter)
+    {
+        int lineno = 1;
+        for (const char *line = data; line < end && matches.lines.size() < max_lines; ++lineno)
+        {
+            const char *line_end = static_cast<const char *>(memchr(line, '\n', end - line));
+            if (!line_end)
+                line_end = end;
+            check_regex(line, line_end, matches, lineno);
+            line = line_end + 1;
+        }
+        return;
+    }
+
+    const AhoCorasick &finder = regex ? prefilter : literals;
+    const char *counted = data; // Newlines before this point are in lineno
+    int lineno = 1;
+    const char *pos = data;
+    while (pos < end && matches.lines.size() < max_lines)
+    {
+        const char *hit_end;
+        const char *hit = finder.find(pos, end, &hit_end);
+        if (!hit)
+            break;
+        const char *line_start, *line_end;
+        line_around(hit, pos, end, line_start, line_end);
+        lineno += count_newlines(counted, line_start);
+        counted = line_start;
+        if (regex)
+            check_regex(line_start, line_end, matches, lineno);
+        else
+            check_literals(line_start, line_end, matches, lineno);
+        pos = line_end + 1;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "search.h"
+
+using ByteSet = std::bitset<256>;
+
+// Several literals compiled into one Aho-Corasick automaton. States are
+// named by their row offset in next, so a step is a single lookup.
+struct AhoCorasick {
+    std::string only;                 // The literal, when there is just one; found with find_substring()
+    uint16_t byte_class[256] = {};    // Byte -> column of next
+    bool starts[256] = {};            // Bytes that begin some literal
+    int shift = 0;                    // Rows of next are 1 << shift columns wide
+    std::vector<int32_t> next;        // Full transition table: next[row + byte_class[c]] is the next row
+    int32_t first_output = 0;         // Rows at or above this end at least one literal
+    std::vector<uint32_t> out_begin;  // Literals ending in each output state, as ranges of out
+    std::vector<uint32_t> out;
+    std::vector<uint32_t> lengths;    // Length of each literal
+
+    void build(const std::vector<std::string> &literals);
+    const char *find(const char *begin, const char *end, const char **hit_end) const;
+
+    int32_t step(int32_t row, unsigned char c) const { return next[row + byte_class[c]]; }
+    const uint32_t *outputs_begin(int32_t row) const { return &out[out_begin[(row - first_output) >> shift]]; }
+    const uint32_t *outputs_end(int32_t row) const { return &out[0] + out_begin[((row - first_output) >> shift) + 1]; }
+};
+
+// Regular expressions compiled into one Thompson NFA, run as a lazy DFA.
+struct RegexProgram {
+    struct State {
+        enum Kind : uint8_t { Bytes, Split, Match, LineStart, LineEnd } kind = Split;
+        int32_t set = -1;  // Bytes: index into sets
+        int32_t out = -1, out1 = -1;
+        uint32_t pattern = 0; // Match: which pattern
+    };
+    std::vector<State> states;
+    std::vector<ByteSet> sets;
+    int32_t start = -1;
+    uint16_t byte_class[256] = {}; // Bytes no set tells apart share a class
+    int classes = 1;
+};
+
+// What sgown looks for: one or more literals, or one or more regular
+// expressions, all found in a single pass over each file.
+class Matcher
+{
+public:
+    bool compile(const std::vector<std::string> &patterns, bool regex, std::string &error);
+    size_t pattern_count() const { return patterns.size(); }
+    const std::string &pattern(size_t i) const { return patterns[i]; }
+    bool required_literals(std::vector<std::string> &literals) const;
+    void find_lines(const char *data, size_t size, size_t max_lines, FileMatches &matches) const;
+
+private:
+    bool check_literals(const char *begin, const char *end, FileMatches &matches, int lineno) const;
+    bool check_regex(const char *begin, const char *end, FileMatches &matches, int lineno) const;
+
+    std::vector<std::string> patterns;
+    bool regex = false;
+    AhoCorasick literals;          // Several literals: the patterns themselves
+    RegexProgram program;          // Regex mode
+    std::vector<std::string> required; // Regex mode: a literal each pattern's matches contain
+    AhoCorasick prefilter;         // Regex mode: finds lines containing any required literal
+    bool use_prefilter = false;
+    uint64_t serial = 0;           // Tells per-thread DFA caches which matcher they belong to
+};
+
+#endif // MATCHER_H
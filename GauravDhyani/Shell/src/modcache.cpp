@@ -0,0 +1,405 @@
+#include "modcache.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cctype>
+#include <sys/stat.h>
+
+// -------------------------
+// Internal Cache Storage
+// -------------------------
+
+// Cache entry: the parsed module plus the file identity it was validated against.
+struct CacheEntry {
+    std::shared_ptr<const JamModule> module;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+};
+
+static std::unordered_map<std::string, CacheEntry> module_cache;
+static std::shared_mutex cache_mutex;
+
+// The JAM lexer keeps its position in global state, so only one thread may lex at a time.
+static std::mutex lexer_mutex;
+
+static std::atomic<size_t> cache_hits{0};
+static std::atomic<size_t> cache_misses{0};
+static std::atomic<size_t> cache_invalidations{0};
+static std::atomic<size_t> bytes_saved{0};
+static std::atomic<long long> parse_us_saved{0};
+
+/**
+ * @brief Releases the AST and token stream owned by a module.
+ */
+JamModule::~JamModule()
+{
+    if (ast)
+        freeAST(ast);
+    for (int i = 0; i < token_count; i++)
+    {
+        free(tokens[i]->lexeme);
+        free(tokens[i]);
+    }
+    free(tokens);
+}
+
+// -------------------------
+// Helpers
+// -------------------------
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of a buffer.
+ *
+ * @param data Buffer to hash.
+ * @param size Number of bytes.
+ * @return Hash value.
+ */
+static uint64_t fnv1a(const char *data, size_t size)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Checks whether a cache entry still describes the file on disk.
+ */
+static bool same_file_identity(const CacheEntry &entry, const struct stat &st)
+{
+    return entry.dev == st.st_dev && entry.ino == st.st_ino && entry.size == st.st_size &&
+           entry.mtime.tv_sec == st.st_mtim.tv_sec && entry.mtime.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Resolves an import name relative to the importing module.
+ *
+ * "import lib" and "import \"lib.jam\"" both resolve to lib.jam next to the importer.
+ *
+ * @param importer Resolved path of the importing module.
+ * @param name     Module name as written after the import keyword.
+ * @return Resolved path, or an empty string if the module does not exist.
+ */
+static std::string resolve_import(const std::string &importer, std::string name)
+{
+    if (name.size() < 4 || name.compare(name.size() - 4, 4, ".jam") != 0)
+        name += ".jam";
+    if (name[0] != '/')
+    {
+        size_t slash = importer.rfind('/');
+        if (slash != std::string::npos)
+            name = importer.substr(0, slash + 1) + name;
+    }
+    char resolved[PATH_MAX];
+    return realpath(name.c_str(), resolved) ? std::string(resolved) : std::string();
+}
+
+/**
+ * @brief Lexes and parses source text into a new module.
+ *
+ * @param path   Resolved path of the module.
+ * @param source Source text (NUL-terminated).
+ * @param hash   Hash of the source text.
+ * @return Newly parsed module.
+ */
+static std::shared_ptr<JamModule> parse_module(const std::string &path, const std::string &source, uint64_t hash)
+{
+    auto module = std::make_shared<JamModule>();
+    module->path = path;
+    module->hash = hash;
+    module->bytes = source.size();
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(lexer_mutex);
+        initlexer(source.c_str());
+        int cap = 0;
+        while (1)
+        {
+            Token *t = get_next_token();
+            if (module->token_count == cap)
+            {
+                cap = cap ? cap * 2 : 8;
+                module->tokens = (Token **)realloc(module->tokens, cap * sizeof(Token *));
+            }
+            module->tokens[module->token_count++] = t;
+            if (t->type == TOKEN_EOF)
+                break;
+        }
+
+        Parser parser;
+        initParser(&parser, module->tokens, module->token_count);
+        module->ast = parseProgram(&parser);
+    }
+    module->parse_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (int i = 0; i + 1 < module->token_count; ++i)
+    {
+        const Token *keyword = module->tokens[i];
+        if (keyword->type == TOKEN_KEYWORD && strcmp(keyword->lexeme, "import") == 0 &&
+            module->tokens[i + 1]->type != TOKEN_EOF)
+        {
+            std::string resolved = resolve_import(path, module->tokens[i + 1]->lexeme);
+            if (!resolved.empty())
+                module->imports.push_back(resolved);
+            else
+                std::cerr << "[modcache] " << path << ": cannot resolve import '" << module->tokens[i + 1]->lexeme << "'\n";
+        }
+    }
+    return module;
+}
+
+// -------------------------
+// Module Loading
+// -------------------------
+
+/**
+ * @brief Returns the parsed module for a JAM file, parsing it only when needed.
+ *
+ * Entries are keyed on the resolved path and revalidated against the file's
+ * inode, size and mtime on every lookup. If those changed but the content
+ * hash did not, the cached parse is still reused. Safe to call from
+ * concurrent threads; modules stay alive while any caller holds them.
+ *
+ * @param path Path to the JAM source file.
+ * @return Parsed module, or nullptr if the file cannot be read.
+ */
+std::shared_ptr<const JamModule> load_module(const std::string &path)
+{
+    char resolved_buf[PATH_MAX];
+    struct stat st;
+    if (!realpath(path.c_str(), resolved_buf) || stat(resolved_buf, &st) != 0)
+    {
+        perror("Script open error");
+        return nullptr;
+    }
+    std::string resolved = resolved_buf;
+
+    {
+        std::shared_lock<std::shared_mutex> lock(cache_mutex);
+        auto it = module_cache.find(resolved);
+        if (it != module_cache.end() && same_file_identity(it->second, st))
+        {
+            cache_hits++;
+            bytes_saved += it->second.module->bytes;
+            parse_us_saved += static_cast<long long>(it->second.module->parse_ms * 1000);
+            return it->second.module;
+        }
+    }
+
+    std::ifstream file(resolved, std::ios::binary);
+    if (!file)
+    {
+        perror("Script open error");
+        return nullptr;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string source = buffer.str();
+    uint64_t hash = fnv1a(source.data(), source.size());
+
+    std::shared_ptr<const JamModule> module;
+    {
+        std::shared_lock<std::shared_mutex> lock(cache_mutex);
+        auto it = module_cache.find(resolved);
+        if (it != module_cache.end() && it->second.module->hash == hash && it->second.module->bytes == source.size())
+            module = it->second.module;
+    }
+
+    if (module)
+    {
+        // Touched but unchanged: keep the parse, refresh the file identity.
+        cache_hits++;
+        bytes_saved += module->bytes;
+        parse_us_saved += static_cast<long long>(module->parse_ms * 1000);
+    }
+    else
+    {
+        cache_misses++;
+        module = parse_module(resolved, source, hash);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(cache_mutex);
+    auto it = module_cache.find(resolved);
+    if (it != module_cache.end() && it->second.module != module)
+        cache_invalidations++;
+    module_cache[resolved] = {module, st.st_dev, st.st_ino, st.st_size, st.st_mtim};
+    return module;
+}
+
+/**
+ * @brief Loads a module and everything it imports, transitively.
+ *
+ * Each module appears once, in depth-first order with the requested file
+ * first; import cycles are tolerated.
+ *
+ * @param path Path to the root JAM source file.
+ * @return Loaded modules, or an empty vector if the root cannot be read.
+ */
+std::vector<std::shared_ptr<const JamModule>> load_module_graph(const std::string &path)
+{
+    std::vector<std::shared_ptr<const JamModule>> modules;
+    std::unordered_set<std::string> visited;
+    std::vector<std::string> pending = {path};
+
+    while (!pending.empty())
+    {
+        std::string next = pending.back();
+        pending.pop_back();
+        auto module = load_module(next);
+        if (!module || !visited.insert(module->path).second)
+            continue;
+        modules.push_back(module);
+        for (auto it = module->imports.rbegin(); it != module->imports.rend(); ++it)
+        {
+            if (!visited.count(*it))
+                pending.push_back(*it);
+        }
+    }
+    return modules;
+}
+
+/**
+ * @brief Lists the modules a JAM file imports without lexing or parsing it.
+ *
+ * A cached, unchanged module answers from its parse. Otherwise the source is
+ * scanned for `import name` and `import "name"` outside comments (`** ...`,
+ * `*- ... -*`) and string literals. The result only guides what to load
+ * ahead of time; the parse stays authoritative.
+ *
+ * @param path Path to the JAM source file.
+ * @return Resolved paths of the imported modules that exist.
+ */
+std::vector<std::string> scan_module_imports(const std::string &path)
+{
+    char resolved_buf[PATH_MAX];
+    struct stat st;
+    if (!realpath(path.c_str(), resolved_buf) || stat(resolved_buf, &st) != 0)
+        return {};
+    std::string resolved = resolved_buf;
+
+    {
+        std::shared_lock<std::shared_mutex> lock(cache_mutex);
+        auto it = module_cache.find(resolved);
+        if (it != module_cache.end() && same_file_identity(it->second, st))
+            return it->second.module->imports;
+    }
+
+    std::ifstream file(resolved, std::ios::binary);
+    if (!file)
+        return {};
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string source = buffer.str();
+
+    auto is_word = [](char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    std::vector<std::string> imports;
+    size_t i = 0;
+    while (i < source.size())
+    {
+        if (source.compare(i, 2, "**") == 0)
+        {
+            i = source.find('\n', i);
+        }
+        else if (source.compare(i, 2, "*-") == 0)
+        {
+            i = source.find("-*", i + 2);
+            i = i == std::string::npos ? i : i + 2;
+        }
+        else if (source[i] == '"')
+        {
+            for (++i; i < source.size() && source[i] != '"'; ++i)
+            {
+                if (source[i] == '\\')
+                    ++i;
+            }
+            ++i;
+        }
+        else if (is_word(source[i]))
+        {
+            size_t start = i;
+            while (i < source.size() && is_word(source[i]))
+                ++i;
+            if (source.compare(start, i - start, "import") != 0)
+                continue;
+
+            while (i < source.size() && isspace(static_cast<unsigned char>(source[i])))
+                ++i;
+            std::string name;
+            if (i < source.size() && source[i] == '"')
+            {
+                size_t close = source.find('"', i + 1);
+                if (close == std::string::npos)
+                    break;
+                name = source.substr(i + 1, close - i - 1);
+                i = close + 1;
+            }
+            else
+            {
+                start = i;
+                while (i < source.size() && is_word(source[i]))
+                    ++i;
+                name = source.substr(start, i - start);
+            }
+            std::string import = name.empty() ? std::string() : resolve_import(resolved, name);
+            if (!import.empty())
+                imports.push_back(import);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return imports;
+}
+
+// -------------------------
+// Cache Utilities
+// -------------------------
+
+/**
+ * @brief Prints the module cache contents and how much parse work it saved.
+ */
+void print_module_cache_stats()
+{
+    std::shared_lock<std::shared_mutex> lock(cache_mutex);
+    size_t cached_bytes = 0;
+    for (const auto &[path, entry] : module_cache)
+        cached_bytes += entry.module->bytes;
+
+    std::cout << "Module cache: " << module_cache.size() << " modules, " << cached_bytes << " bytes of source\n";
+    std::cout << "  hits: " << cache_hits << ", parses: " << cache_misses
+              << ", invalidated: " << cache_invalidations << "\n";
+    std::cout << "  saved: " << bytes_saved << " bytes not re-parsed, "
+              << parse_us_saved / 1000.0 << " ms of lex/parse time\n";
+}
+
+/**
+ * @brief Drops every cached module and resets the counters.
+ */
+void clear_module_cache()
+{
+    std::unique_lock<std::shared_mutex> lock(cache_mutex);
+    module_cache.clear();
+    cache_hits = 0;
+    cache_misses = 0;
+    cache_invalidations = 0;
+    bytes_saved = 0;
+    parse_us_saved = 0;
+    std::cout << "Module cache cleared.\n";
+}
@@ -0,0 +1,41 @@
+#ifndef MODCACHE_H
+#define MODCACHE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../JAM/lexer.h"
+#include "../JAM/parser.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+// A lexed and parsed JAM source file owned by the module cache.
+struct JamModule {
+    std::string path;                 // Resolved (canonical) path
+    uint64_t hash = 0;                // FNV-1a hash of the source text
+    Token** tokens = nullptr;         // Token stream, terminated by TOKEN_EOF
+    int token_count = 0;
+    ASTNode* ast = nullptr;
+    std::vector<std::string> imports; // Resolved paths of imported modules
+    size_t bytes = 0;
+    double parse_ms = 0;
+
+    ~JamModule();
+};
+
+std::shared_ptr<const JamModule> load_module(const std::string& path);
+std::vector<std::shared_ptr<const JamModule>> load_module_graph(const std::string& path);
+std::vector<std::string> scan_module_imports(const std::string& path);
+
+void print_module_cache_stats();
+void clear_module_cache();
+
+#endif // MODCACHE_H
@@ -0,0 +1,408 @@
+#include "parallel.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "pathcache.h"
+#include "procspawn.h"
+#include "jobs.h"
+#include "builtins.h"
+#include "fastpath.h"
+
+// -------------------------
+// Job Description
+// -------------------------
+
+struct ParallelOptions {
+    int jobs = 0;               // Children in flight; 0 means one per CPU
+    bool keep_order = false;    // Print output in argument order
+    std::vector<std::string> command; // Template; "{}" marks the argument
+    std::vector<std::string> args;
+};
+
+// One invocation of the template. Output is collected until the child exits
+// so that lines from different jobs never interleave.
+struct ParallelJob {
+    std::string command_line;
+    pid_t pid = -1;
+    int out_fd = -1;
+    int err_fd = -1;
+    std::string out;
+    std::string err;
+    int status = 0;             // Shell-style exit status
+    bool done = false;
+};
+
+/**
+ * @brief Prints command-line usage.
+ */
+static void print_jparallel_usage()
+{
+    std::cerr << "Usage: jparallel [-j N] [-k] <command...> [::: args...]\n"
+                 "  Runs <command> once per argument, N at a time (default: one per CPU).\n"
+                 "  Arguments come after ':::' or, without it, one per line from stdin.\n"
+                 "  {} is replaced by the argument ({.} without extension, {/} basename,\n"
+                 "  {/.} basename without extension, {#} job number); without a placeholder the argument is appended.\n"
+                 "  -k prints output in argument order instead of completion order.\n";
+}
+
+/**
+ * @brief Parses jparallel options, template and arguments.
+ *
+ * @return true on success, false (after printing usage) on bad input.
+ */
+static bool parse_jparallel_args(int token_count, char *tokens[], ParallelOptions &opt)
+{
+    int i = 1;
+    for (; i < token_count && tokens[i][0] == '-'; ++i)
+    {
+        if (strcmp(tokens[i], "-k") == 0 || strcmp(tokens[i], "--keep-order") == 0)
+        {
+            opt.keep_order = true;
+        }
+        else if (strcmp(tokens[i], "-j") == 0 && i + 1 < token_count)
+        {
+            opt.jobs = atoi(tokens[++i]);
+        }
+        else if (strncmp(tokens[i], "-j", 2) == 0 && tokens[i][2] != '\0')
+        {
+            opt.jobs = atoi(tokens[i] + 2);
+        }
+        else
+        {
+            print_jparallel_usage();
+            return false;
+        }
+    }
+
+    bool from_stdin = true;
+    for (; i < token_count; ++i)
+    {
+        if (strcmp(tokens[i], ":::") == 0)
+            from_stdin = false;
+        else if (from_stdin)
+            opt.command.push_back(tokens[i]);
+        else
+            opt.args.push_back(tokens[i]);
+    }
+    if (opt.command.empty())
+    {
+        print_jparallel_usage();
+        return false;
+    }
+
+    if (from_stdin)
+    {
+        std::string line;
+        while (std::getline(std::cin, line))
+        {
+            if (!line.empty())
+                opt.args.push_back(line);
+        }
+        std::cin.clear();
+    }
+    if (opt.jobs <= 0)
+        opt.jobs = std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+/**
+ * @brief Expands the placeholders of one template word.
+ *
+ * @param word   Template word.
+ * @param arg    Argument for this job.
+ * @param number 1-based job number.
+ * @param used   Set when the word contained a placeholder.
+ */
+static std::string expand_template(const std::string &word, const std::string &arg, size_t number, bool &used)
+{
+    std::string result;
+    for (size_t i = 0; i < word.size(); ++i)
+    {
+        if (word[i] != '{')
+        {
+            result += word[i];
+            continue;
+        }
+        size_t close = word.find('}', i);
+        std::string key = close == std::string::npos ? "" : word.substr(i + 1, close - i - 1);
+        if (key == "")
+        {
+            result += arg;
+        }
+        else if (key == "." || key == "/" || key == "/.")
+        {
+            std::string part = arg;
+            size_t slash = part.rfind('/');
+            if (key[0] == '/' && slash != std::string::npos)
+                part.erase(0, slash + 1);
+            size_t dot = part.rfind('.');
+            slash = part.rfind('/');
+            if (key.back() == '.' && dot != std::string::npos && (slash == std::string::npos || dot > slash))
+                part.erase(dot);
+            result += part;
+        }
+        else if (key == "#")
+        {
+            result += std::to_string(number);
+        }
+        else
+        {
+            result += word[i];
+            continue;
+        }
+        used = true;
+        i = close;
+    }
+    return result;
+}
+
+// -------------------------
+// Job Execution
+// -------------------------
+
+/**
+ * @brief Starts one job with its stdout and stderr captured through pipes.
+ *
+ * Launched the way pipeline stages are: executables through posix_spawn,
+ * builtins (and fast paths with no executable behind them) in a forked
+ * copy of the shell. Jobs get /dev/null as stdin so they cannot compete
+ * for the terminal or an argument stream.
+ *
+ * @return true if the child was started; otherwise the job is marked done.
+ */
+static bool start_job(ParallelJob &job, const std::vector<std::string> &argv_words)
+{
+    job.command_line.clear();
+    std::vector<char *> argv;
+    for (const auto &word : argv_words)
+    {
+        argv.push_back(const_cast<char *>(word.c_str()));
+        job.command_line += (job.command_line.empty() ? "" : " ") + word;
+    }
+    argv.push_back(nullptr);
+
+    int argc = static_cast<int>(argv.size() - 1);
+    const Builtin *builtin = find_builtin(argv[0]);
+    const char *path = builtin ? nullptr : lookup_executable(argv[0]);
+    FastPathHandler fast = builtin || path ? nullptr : find_fast_path(argv[0]);
+    if (!builtin && !path && !fast)
+    {
+        job.err = "jam: command not found: " + argv_words[0] + "\n";
+        job.status = 127;
+        job.done = true;
+        return false;
+    }
+
+    int out[2], err[2];
+    if (pipe2(out, O_CLOEXEC) < 0 || pipe2(err, O_CLOEXEC) < 0)
+    {
+        perror("pipe");
+        job.status = 126;
+        job.done = true;
+        return false;
+    }
+
+    SpawnOptions options;
+    options.stdout_fd = out[1];
+    options.stderr_fd = err[1];
+    options.input = "/dev/null";
+    if (path)
+    {
+        job.pid = spawn_command(path, argv.data(), options);
+    }
+    else
+    {
+        job.pid = fork_command(options, [&]() {
+            if (builtin)
+                return run_builtin(*builtin, argc, argv.data());
+            int status = fast(argc, argv.data());
+            if (status == FASTPATH_FALLBACK)
+            {
+                std::cerr << "jam: command not found: " << argv[0] << "\n";
+                status = 127;
+            }
+            return status;
+        });
+    }
+    close(out[1]);
+    close(err[1]);
+    if (job.pid < 0)
+    {
+        close(out[0]);
+        close(err[0]);
+        job.status = 127;
+        job.done = true;
+        return false;
+    }
+    job.out_fd = out[0];
+    job.err_fd = err[0];
+    return true;
+}
+
+/**
+ * @brief Reads whatever is available on a job pipe; closes it at EOF.
+ */
+static void drain_pipe(int &fd, std::string &buffer)
+{
+    char chunk[65536];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n > 0)
+    {
+        buffer.append(chunk, n);
+    }
+    else if (n == 0 || errno != EINTR)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+/**
+ * @brief Writes a finished job's buffered output to the shell's stdout/stderr.
+ */
+static void emit_job_output(ParallelJob &job)
+{
+    fwrite(job.out.data(), 1, job.out.size(), stdout);
+    fflush(stdout);
+    fwrite(job.err.data(), 1, job.err.size(), stderr);
+    fflush(stderr);
+    std::string().swap(job.out);
+    std::string().swap(job.err);
+}
+
+/**
+ * @brief Runs a template over a list of arguments with N jobs in flight.
+ *
+ * A new job is started as soon as one finishes. Each job's stdout and
+ * stderr are buffered and written as a block when it exits, in completion
+ * order or (with -k) in argument order. If a job is killed by Ctrl-C no new
+ * jobs are started. A summary with throughput and failures goes to stderr.
+ *
+ * @param token_count The number of command-line tokens received.
+ * @param tokens      An array of strings containing the command-line tokens.
+ * @return 0 if every job succeeded, otherwise the number of failed jobs (max 101).
+ */
+int handle_jparallel_command(int token_count, char *tokens[])
+{
+    ParallelOptions opt;
+    if (!parse_jparallel_args(token_count, tokens, opt))
+        return 2;
+
+    std::cout.flush();
+    std::vector<ParallelJob> jobs(opt.args.size());
+    std::vector<size_t> running;
+    size_t next_start = 0, next_emit = 0, finished = 0;
+    bool interrupted = false;
+    auto start_time = std::chrono::steady_clock::now();
+
+    auto finish = [&](size_t index) {
+        finished++;
+        if (!opt.keep_order)
+        {
+            emit_job_output(jobs[index]);
+            return;
+        }
+        while (next_emit < jobs.size() && jobs[next_emit].done)
+            emit_job_output(jobs[next_emit++]);
+    };
+
+    while (finished < jobs.size())
+    {
+        while (!interrupted && running.size() < static_cast<size_t>(opt.jobs) && next_start < jobs.size())
+        {
+            size_t index = next_start++;
+            bool used = false;
+            std::vector<std::string> words;
+            for (const auto &word : opt.command)
+                words.push_back(expand_template(word, opt.args[index], index + 1, used));
+            if (!used)
+                words.push_back(opt.args[index]);
+
+            if (start_job(jobs[index], words))
+                running.push_back(index);
+            else
+                finish(index);
+        }
+        if (running.empty())
+        {
+            if (interrupted || next_start == jobs.size())
+                break;
+            continue;
+        }
+
+        std::vector<struct pollfd> fds;
+        for (size_t index : running)
+        {
+            if (jobs[index].out_fd != -1)
+                fds.push_back({jobs[index].out_fd, POLLIN, 0});
+            if (jobs[index].err_fd != -1)
+                fds.push_back({jobs[index].err_fd, POLLIN, 0});
+        }
+        if (!fds.empty() && poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        for (size_t r = 0; r < running.size();)
+        {
+            ParallelJob &job = jobs[running[r]];
+            for (const auto &pfd : fds)
+            {
+                if (!pfd.revents)
+                    continue;
+                if (pfd.fd == job.out_fd)
+                    drain_pipe(job.out_fd, job.out);
+                else if (pfd.fd == job.err_fd)
+                    drain_pipe(job.err_fd, job.err);
+            }
+            if (job.out_fd != -1 || job.err_fd != -1)
+            {
+                ++r;
+                continue;
+            }
+
+            // Both pipes hit EOF, so the child has exited (or closed them itself).
+            int status = 0;
+            struct rusage usage = {};
+            while (wait4(job.pid, &status, 0, &usage) < 0 && errno == EINTR)
+                ;
+            account_child_usage(usage);
+            job.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            job.done = true;
+            interrupted |= WIFSIGNALED(status) && WTERMSIG(status) == SIGINT;
+            size_t index = running[r];
+            running.erase(running.begin() + r);
+            finish(index);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    size_t failed = 0;
+    for (const auto &job : jobs)
+        failed += job.done && job.status != 0;
+
+    fprintf(stderr, "jparallel: %zu jobs, %zu ok, %zu failed in %.3f s (%.1f jobs/s)\n",
+            finished, finished - failed, failed, seconds, seconds > 0 ? finished / seconds : 0.0);
+    if (interrupted)
+        fprintf(stderr, "jparallel: interrupted; %zu jobs not started\n", jobs.size() - next_start);
+    for (const auto &job : jobs)
+    {
+        if (job.done && job.status != 0)
+            fprintf(stderr, "  [exit %d] %s\n", job.status, job.command_line.c_str());
+    }
+    return failed > 101 ? 101 : static_cast<int>(failed);
+}
@@ -0,0 +1,6 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+int handle_jparallel_command(int token_count, char *tokens[]);
+
+#endif // PARALLEL_H
@@ -0,0 +1,285 @@
+#include "pathcache.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+// -------------------------
+// Internal Cache Storage
+// -------------------------
+
+// A resolved executable and how often it has been looked up.
+struct HashedCommand {
+    std::string path;
+    unsigned long hits = 0;
+};
+
+// A scanned $PATH directory and what it looked like when scanned.
+struct PathDir {
+    std::string path;
+    struct timespec mtime = {};
+    bool exists = false;  // A missing directory may be created later
+    bool watched = false; // Covered by an inotify watch; otherwise polled with stat()
+};
+
+static std::unordered_map<std::string, HashedCommand> command_table;
+static std::vector<PathDir> path_dirs;
+static std::string hashed_path_env;
+static bool table_valid = false;
+static int inotify_fd = -1;
+
+// Relative $PATH entries ("." or "bin") name different directories after a
+// cd, so the working directory they were scanned from is recorded.
+static bool has_relative_dirs = false;
+static dev_t scanned_cwd_dev = 0;
+static ino_t scanned_cwd_ino = 0;
+
+// -------------------------
+// Cache Maintenance
+// -------------------------
+
+/**
+ * @brief Drops the table and any directory watches.
+ */
+void reset_path_cache()
+{
+    command_table.clear();
+    path_dirs.clear();
+    hashed_path_env.clear();
+    table_valid = false;
+    has_relative_dirs = false;
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+}
+
+/**
+ * @brief Scans every $PATH directory and records the executables in it.
+ *
+ * Earlier directories win, as with execvp(). Directories are watched with
+ * inotify when available; missing directories, and any that cannot be
+ * watched, have their existence and mtime recorded for polling instead.
+ */
+static void rebuild_path_cache()
+{
+    std::unordered_map<std::string, HashedCommand> previous;
+    previous.swap(command_table);
+    reset_path_cache();
+    const char* env = getenv("PATH");
+    hashed_path_env = env ? env : "";
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    size_t start = 0;
+    while (start <= hashed_path_env.size())
+    {
+        size_t end = hashed_path_env.find(':', start);
+        if (end == std::string::npos)
+            end = hashed_path_env.size();
+        std::string dir = hashed_path_env.substr(start, end - start);
+        start = end + 1;
+        if (dir.empty())
+            dir = ".";
+        if (std::any_of(path_dirs.begin(), path_dirs.end(), [&](const PathDir& d) { return d.path == dir; }))
+            continue;
+
+        PathDir entry;
+        entry.path = dir;
+        struct stat st;
+        if (stat(dir.c_str(), &st) == 0)
+        {
+            entry.exists = true;
+            entry.mtime = st.st_mtim;
+        }
+        if (dir[0] != '/' && !has_relative_dirs && stat(".", &st) == 0)
+        {
+            has_relative_dirs = true;
+            scanned_cwd_dev = st.st_dev;
+            scanned_cwd_ino = st.st_ino;
+        }
+        if (inotify_fd >= 0 && entry.exists)
+            entry.watched = inotify_add_watch(inotify_fd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) >= 0;
+        path_dirs.push_back(entry);
+
+        int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR* listing = dirfd >= 0 ? fdopendir(dirfd) : nullptr;
+        if (!listing)
+        {
+            if (dirfd >= 0)
+                close(dirfd);
+            continue;
+        }
+        while (struct dirent* de = readdir(listing))
+        {
+            if (de->d_name[0] == '.' || de->d_type == DT_DIR || command_table.count(de->d_name))
+                continue;
+            if (de->d_type != DT_REG)
+            {
+                struct stat target;
+                if (fstatat(dirfd, de->d_name, &target, 0) != 0 || !S_ISREG(target.st_mode))
+                    continue;
+            }
+            if (faccessat(dirfd, de->d_name, X_OK, AT_EACCESS) == 0)
+                command_table[de->d_name].path = dir + "/" + de->d_name;
+        }
+        closedir(listing);
+    }
+
+    // Automatic rebuilds keep the hit counts of commands that still exist.
+    for (const auto& [name, old] : previous)
+    {
+        auto it = command_table.find(name);
+        if (it != command_table.end())
+            it->second.hits = old.hits;
+    }
+    table_valid = true;
+}
+
+/**
+ * @brief Checks whether the table still matches $PATH and the directories in it.
+ *
+ * Watched directories are checked with a single non-blocking inotify read.
+ * Every other directory is stat()ed and its existence and mtime compared
+ * against the scan, so a $PATH entry created after the scan is noticed. If
+ * $PATH has relative entries, a change of working directory also
+ * invalidates the table.
+ *
+ * @return true if the table can be used as is.
+ */
+static bool path_cache_is_current()
+{
+    const char* env = getenv("PATH");
+    if (!table_valid || hashed_path_env != (env ? env : ""))
+        return false;
+
+    if (has_relative_dirs)
+    {
+        struct stat st;
+        if (stat(".", &st) != 0 || st.st_dev != scanned_cwd_dev || st.st_ino != scanned_cwd_ino)
+            return false;
+    }
+
+    if (inotify_fd >= 0)
+    {
+        char events[4096];
+        if (read(inotify_fd, events, sizeof(events)) > 0)
+            return false;
+    }
+
+    for (const auto& dir : path_dirs)
+    {
+        if (dir.watched)
+            continue;
+        struct stat st;
+        bool exists = stat(dir.path.c_str(), &st) == 0;
+        if (exists != dir.exists)
+            return false;
+        if (exists && (st.st_mtim.tv_sec != dir.mtime.tv_sec || st.st_mtim.tv_nsec != dir.mtime.tv_nsec))
+            return false;
+    }
+    return true;
+}
+
+// -------------------------
+// Lookup
+// -------------------------
+
+/**
+ * @brief Resolves a command name to the executable execvp() would run.
+ *
+ * Names containing a '/' are checked directly. Other names are answered
+ * from the in-process table, which is rebuilt when $PATH or one of its
+ * directories changes, so no process is spawned for the lookup.
+ *
+ * @param name      Command name as typed.
+ * @param count_hit Whether the lookup counts as a use in `hash` output.
+ * @return Full path of the executable, or nullptr if it cannot be found.
+ *         The pointer stays valid until the next lookup or reset.
+ */
+const char* lookup_executable(const char* name, bool count_hit)
+{
+    if (!name || !*name)
+        return nullptr;
+    if (strchr(name, '/'))
+    {
+        struct stat st;
+        return stat(name, &st) == 0 && S_ISREG(st.st_mode) && access(name, X_OK) == 0 ? name : nullptr;
+    }
+
+    if (!path_cache_is_current())
+        rebuild_path_cache();
+
+    auto it = command_table.find(name);
+    if (it == command_table.end())
+        return nullptr;
+    if (count_hit)
+        it->second.hits++;
+    return it->second.path.c_str();
+}
+
+// -------------------------
+// hash Builtin
+// -------------------------
+
+/**
+ * @brief Prints the commands that have been looked up, like the shell's `hash`.
+ */
+void print_path_cache()
+{
+    std::vector<const std::pair<const std::string, HashedCommand>*> used;
+    for (const auto& entry : command_table)
+    {
+        if (entry.second.hits > 0)
+            used.push_back(&entry);
+    }
+    std::sort(used.begin(), used.end(), [](auto a, auto b) { return a->first < b->first; });
+
+    if (used.empty())
+    {
+        std::cout << "hash: hash table empty (" << command_table.size() << " executables indexed)\n";
+        return;
+    }
+    std::cout << "hits\tcommand\n";
+    for (const auto* entry : used)
+    {
+        std::cout << entry->second.hits << "\t" << entry->second.path << "\n";
+    }
+    std::cout << "(" << command_table.size() << " executables indexed from " << path_dirs.size() << " directories)\n";
+}
+
+/**
+ * @brief Handles the `hash` builtin.
+ *
+ * `hash` lists looked-up commands, `hash -r` forgets everything and
+ * `hash name...` resolves names and reports any that are not found.
+ *
+ * @param token_count The number of command-line tokens received.
+ * @param tokens      An array of strings containing the command-line tokens.
+ */
+void handle_hash_command(int token_count, char *tokens[])
+{
+    if (token_count == 1)
+    {
+        print_path_cache();
+        return;
+    }
+    if (strcmp(tokens[1], "-r") == 0)
+    {
+        reset_path_cache();
+        return;
+    }
+    for (int i = 1; i < token_count; ++i)
+    {
+        if (!lookup_executable(tokens[i]))
+            std::cerr << "hash: " << tokens[i] << ": not found\n";
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+const char* lookup_executable(const char* name, bool count_hit = true);
+void print_path_cache();
+void reset_path_cache();
+void handle_hash_command(int token_count, char *tokens[]);
+
+#endif // PATHCACHE_H
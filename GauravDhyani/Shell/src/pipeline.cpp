@@ -0,0 +1,311 @@
+#include "pipeline.h"
+#include <iostream>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "pathcache.h"
+#include "procspawn.h"
+#include "jobs.h"
+#include "builtins.h"
+#include "fastpath.h"
+
+// -------------------------
+// Pipeline Parsing
+// -------------------------
+
+/**
+ * @brief Splits a command line into pipeline stages and their redirections.
+ *
+ * Every stage may carry its own "<", ">" and ">>" redirections, which take
+ * precedence over the pipe on that side. Only unquoted operators count, so
+ * a quoted "|" is an ordinary argument.
+ *
+ * @param tokens Command tokens (without a trailing "&").
+ * @param count  Number of tokens.
+ * @param stages Receives the parsed stages.
+ * @return true on success, false (after printing an error) on a syntax error.
+ */
+bool parse_pipeline(const ShellToken *tokens, size_t count, std::vector<PipelineStage> &stages)
+{
+    stages.clear();
+    stages.emplace_back();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        PipelineStage &stage = stages.back();
+        std::string_view token = tokens[i].text;
+        char *text = const_cast<char *>(token.data());
+
+        if (!(tokens[i].flags & TOKEN_OPERATOR))
+        {
+            stage.argv.push_back(text);
+        }
+        else if (token == "|")
+        {
+            if (stage.argv.empty())
+            {
+                std::cerr << "jam: syntax error near '|'\n";
+                return false;
+            }
+            stages.emplace_back();
+        }
+        else if (token == "<" || token == ">" || token == ">>")
+        {
+            if (i + 1 >= count || (tokens[i + 1].flags & TOKEN_OPERATOR))
+            {
+                std::cerr << "jam: syntax error: missing file after '" << token << "'\n";
+                return false;
+            }
+            const char *file = tokens[++i].text.data();
+            if (token == "<")
+            {
+                stage.input = file;
+            }
+            else
+            {
+                stage.append = token == ">>";
+                stage.output = file;
+            }
+        }
+        else
+        {
+            std::cerr << "jam: syntax error near '" << token << "'\n";
+            return false;
+        }
+    }
+
+    for (auto &stage : stages)
+    {
+        if (stage.argv.empty())
+        {
+            std::cerr << "jam: syntax error: empty command in pipeline\n";
+            return false;
+        }
+        stage.argv.push_back(nullptr);
+    }
+    return true;
+}
+
+// -------------------------
+// Pipeline Execution
+// -------------------------
+
+/**
+ * @brief Rebuilds a stage's command text for the job table.
+ */
+static std::string describe_stage(const PipelineStage &stage)
+{
+    std::string text;
+    for (size_t i = 0; stage.argv[i] != nullptr; ++i)
+        text += (i ? " " : "") + std::string(stage.argv[i]);
+    if (stage.input)
+        text += std::string(" < ") + stage.input;
+    if (stage.output)
+        text += std::string(stage.append ? " >> " : " > ") + stage.output;
+    return text;
+}
+
+/**
+ * @brief Runs a builtin or fast path inside the shell with a stage's redirections.
+ *
+ * fds 0 and 1 are saved, pointed at the redirection targets for the call
+ * and restored afterwards, so output written through stdio, iostreams or
+ * write(1) all lands in the file.
+ *
+ * @param stage Single foreground stage.
+ * @param body  Runs the command and returns its status.
+ * @return The body's status, or 1 if a redirection could not be opened.
+ */
+static int run_in_process(const PipelineStage &stage, const std::function<int()> &body)
+{
+    const char *files[2] = {stage.input, stage.output};
+    int saved[2] = {-1, -1};
+    int status = 1;
+    bool ready = true;
+
+    std::cout.flush();
+    fflush(stdout);
+    for (int fd = 0; fd < 2 && ready; ++fd)
+    {
+        if (!files[fd])
+            continue;
+        int flags = fd == 0 ? O_RDONLY : O_WRONLY | O_CREAT | (stage.append ? O_APPEND : O_TRUNC);
+        int file = open(files[fd], flags | O_CLOEXEC, 0644);
+        saved[fd] = file < 0 ? -1 : fcntl(fd, F_DUPFD_CLOEXEC, 10);
+        if (saved[fd] < 0)
+        {
+            perror(files[fd]);
+            ready = false;
+        }
+        else
+        {
+            dup2(file, fd);
+        }
+        if (file >= 0)
+            close(file);
+    }
+
+    if (ready)
+        status = body();
+
+    std::cout.flush();
+    fflush(stdout);
+    for (int fd = 0; fd < 2; ++fd)
+    {
+        if (saved[fd] >= 0)
+        {
+            dup2(saved[fd], fd);
+            close(saved[fd]);
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Starts every stage of a pipeline concurrently and waits for them.
+ *
+ * All stages are spawned before any is waited for, so producers never block
+ * on a full pipe waiting for a consumer that has not started. Pipes and
+ * redirections are passed to posix_spawn() as file actions; pipe ends are
+ * close-on-exec and closed in the shell right after each spawn, so every
+ * reader sees EOF as soon as its writer exits. A stage that cannot start is
+ * skipped and the rest of the pipeline still runs, as in other shells.
+ *
+ * The stages form one job in the job table. With job control they share a
+ * new process group that owns the terminal while in the foreground.
+ *
+ * A lone foreground builtin or fast-path command (see fastpath.cpp) runs
+ * in the shell itself with no process at all. Inside a longer pipeline or
+ * in the background, builtins run in a forked copy of the shell, while
+ * fast-path commands are spawned from their executables like any other
+ * command, which is cheaper than forking the shell.
+ *
+ * @param stages     Parsed pipeline stages.
+ * @param background Whether to return without waiting.
+ * @return Exit status of the last stage (0 when run in the background,
+ *         128+SIGTSTP when stopped).
+ */
+int run_pipeline(std::vector<PipelineStage> &stages, bool background)
+{
+    // Children write straight to the shared descriptors; put our own
+    // buffered output ahead of theirs.
+    fflush(stdout);
+
+    if (stages.size() == 1 && !background)
+    {
+        PipelineStage &stage = stages[0];
+        int argc = static_cast<int>(stage.argv.size() - 1);
+        if (const Builtin *builtin = find_builtin(stage.argv[0]))
+            return run_in_process(stage, [&]() { return run_builtin(*builtin, argc, stage.argv.data()); });
+        if (FastPathHandler fast = find_fast_path(stage.argv[0]))
+        {
+            int status = run_in_process(stage, [&]() { return fast(argc, stage.argv.data()); });
+            if (status != FASTPATH_FALLBACK)
+                return status;
+        }
+    }
+
+    std::vector<pid_t> pids;
+    std::string command;
+    int prev_read = -1;
+    int failed_status = 0; // Status of the last stage when it could not start
+    pid_t pgid = job_control_enabled() ? 0 : -1;
+
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        int pipefd[2] = {-1, -1};
+        bool last = i + 1 == stages.size();
+        if (!last && pipe2(pipefd, O_CLOEXEC) < 0)
+        {
+            perror("pipe");
+            break;
+        }
+
+        SpawnOptions options;
+        options.stdin_fd = prev_read;
+        options.stdout_fd = last ? -1 : pipefd[1];
+        options.input = stages[i].input;
+        options.output = stages[i].output;
+        options.append = stages[i].append;
+        options.pgid = pgid;
+
+        pid_t pid = -1;
+        char **argv = stages[i].argv.data();
+        int argc = static_cast<int>(stages[i].argv.size() - 1);
+        const Builtin *builtin = find_builtin(argv[0]);
+        const char *path = builtin ? nullptr : lookup_executable(argv[0]);
+        FastPathHandler fast = builtin || path ? nullptr : find_fast_path(argv[0]);
+        if (builtin || fast)
+        {
+            pid = fork_command(options, [&]() {
+                if (builtin)
+                    return run_builtin(*builtin, argc, argv);
+                int status = fast(argc, argv);
+                if (status == FASTPATH_FALLBACK)
+                {
+                    std::cerr << "jam: command not found: " << argv[0] << "\n";
+                    status = 127;
+                }
+                return status;
+            });
+            failed_status = 127;
+        }
+        else if (!path)
+        {
+            std::cerr << "jam: command not found: " << argv[0] << "\n";
+            failed_status = 127;
+        }
+        else if (stages[i].input && access(stages[i].input, R_OK) != 0)
+        {
+            // Checked here so the error names the file, not the command.
+            perror(stages[i].input);
+            failed_status = 1;
+        }
+        else
+        {
+            pid = spawn_command(path, argv, options);
+            failed_status = 127;
+        }
+
+        if (prev_read != -1)
+            close(prev_read);
+        if (!last)
+            close(pipefd[1]);
+        prev_read = pipefd[0];
+
+        if (pid > 0)
+        {
+            failed_status = 0;
+            pids.push_back(pid);
+            if (pgid == 0)
+            {
+                // The first stage leads the job's process group; hand it the
+                // terminal before it can read from it.
+                pgid = pid;
+                if (!background)
+                    give_terminal_to(pgid);
+            }
+        }
+
+        command += (i ? " | " : "") + describe_stage(stages[i]);
+    }
+    if (prev_read != -1)
+        close(prev_read);
+
+    if (pids.empty())
+        return failed_status;
+
+    int id = add_job(pgid, pids, command);
+    if (background)
+    {
+        if (job_control_enabled())
+            printf("[%d] %d\n", id, pids.back());
+        return 0;
+    }
+    int status = wait_for_job(id, true);
+    return failed_status ? failed_status : status;
+}
@@ -0,0 +1,18 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include "tokenizer.h"
+
+// One command of a pipeline with its own redirections.
+struct PipelineStage {
+    std::vector<char *> argv;      // nullptr-terminated argument vector
+    const char *input = nullptr;   // "< file"
+    const char *output = nullptr;  // "> file" or ">> file"
+    bool append = false;
+};
+
+bool parse_pipeline(const ShellToken *tokens, size_t count, std::vector<PipelineStage> &stages);
+int run_pipeline(std::vector<PipelineStage> &stages, bool background);
+
+#endif // PIPELINE_H
@@ -0,0 +1,156 @@
+#include "procspawn.h"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+
+extern char **environ;
+
+// Signals the shell may catch or ignore; children always start with the defaults.
+static const int reset_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGCHLD, SIGPIPE};
+
+// -------------------------
+// posix_spawn Launch
+// -------------------------
+
+/**
+ * @brief Starts a command with posix_spawn(), wiring up pipes and redirections.
+ *
+ * glibc implements posix_spawn() with clone(CLONE_VM | CLONE_VFORK), so the
+ * cost does not grow with the shell's memory size the way fork() page-table
+ * copies do. Pipes and redirections are expressed as file actions and run
+ * in the child before exec.
+ *
+ * @param path    Executable to run (already resolved against $PATH).
+ * @param argv    nullptr-terminated argument vector.
+ * @param options Stream wiring and process group.
+ * @return Child pid, or -1 after printing why the command could not start.
+ */
+pid_t spawn_command(const char *path, char *const argv[], const SpawnOptions &options)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    if (options.stdin_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, options.stdin_fd, STDIN_FILENO);
+    if (options.stdout_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, options.stdout_fd, STDOUT_FILENO);
+    if (options.stderr_fd != -1)
+        posix_spawn_file_actions_adddup2(&actions, options.stderr_fd, STDERR_FILENO);
+    if (options.input)
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, options.input, O_RDONLY, 0);
+    if (options.output)
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, options.output,
+                                         O_WRONLY | O_CREAT | (options.append ? O_APPEND : O_TRUNC), 0644);
+
+    sigset_t defaults, empty;
+    sigemptyset(&defaults);
+    for (int sig : reset_signals)
+        sigaddset(&defaults, sig);
+    sigemptyset(&empty);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (options.pgid >= 0)
+    {
+        posix_spawnattr_setpgroup(&attr, options.pgid);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid = -1;
+    int err = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (err != 0)
+    {
+        std::cerr << "jam: " << argv[0] << ": " << strerror(err) << "\n";
+        return -1;
+    }
+    return pid;
+}
+
+// -------------------------
+// fork Fallback
+// -------------------------
+
+/**
+ * @brief Forks a child that runs shell code instead of (or before) exec.
+ *
+ * Fallback for stages that need pre-exec work posix_spawn() cannot express,
+ * such as running a builtin inside a pipeline. The child gets the same
+ * stream wiring, process group and signal defaults as spawn_command(), then
+ * exits with the body's return value.
+ *
+ * @param options Stream wiring and process group.
+ * @param body    Code to run in the child; its result is the exit status.
+ * @return Child pid, or -1 if fork() failed.
+ */
+pid_t fork_command(const SpawnOptions &options, const std::function<int()> &body)
+{
+    std::cout.flush();
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        if (pid < 0)
+            perror("fork");
+        // Set the group from both sides, so it exists before the caller
+        // hands it the terminal or spawns the next stage into it. EACCES
+        // means the child already ran exec, by which time it had done so.
+        else if (options.pgid >= 0 && setpgid(pid, options.pgid ? options.pgid : pid) < 0 && errno != EACCES)
+            perror("setpgid");
+        return pid;
+    }
+
+    if (options.pgid >= 0)
+        setpgid(0, options.pgid);
+    for (int sig : reset_signals)
+        signal(sig, SIG_DFL);
+    sigset_t empty;
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, nullptr);
+
+    if (options.stdin_fd != -1)
+        dup2(options.stdin_fd, STDIN_FILENO);
+    if (options.stdout_fd != -1)
+        dup2(options.stdout_fd, STDOUT_FILENO);
+    if (options.stderr_fd != -1)
+        dup2(options.stderr_fd, STDERR_FILENO);
+    if (options.input)
+    {
+        int fd = open(options.input, O_RDONLY);
+        if (fd < 0)
+        {
+            perror(options.input);
+            _exit(1);
+        }
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
+    if (options.output)
+    {
+        int fd = open(options.output, O_WRONLY | O_CREAT | (options.append ? O_APPEND : O_TRUNC), 0644);
+        if (fd < 0)
+        {
+            perror(options.output);
+            _exit(1);
+        }
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+
+    int status = body();
+    std::cout.flush();
+    fflush(stdout);
+    _exit(status);
+}
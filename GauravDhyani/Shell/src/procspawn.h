@@ -0,0 +1,21 @@
+#ifndef PROCSPAWN_H
+#define PROCSPAWN_H
+
+#include <functional>
+#include <sys/types.h>
+
+// Standard stream wiring and process group for a new child process.
+struct SpawnOptions {
+    int stdin_fd = -1;             // Becomes fd 0 when not -1
+    int stdout_fd = -1;            // Becomes fd 1 when not -1
+    int stderr_fd = -1;            // Becomes fd 2 when not -1
+    const char *input = nullptr;   // File opened as fd 0 (after stdin_fd)
+    const char *output = nullptr;  // File opened as fd 1 (after stdout_fd)
+    bool append = false;
+    pid_t pgid = -1;               // -1 inherit, 0 new group, >0 join group
+};
+
+pid_t spawn_command(const char *path, char *const argv[], const SpawnOptions &options);
+pid_t fork_command(const SpawnOptions &options, const std::function<int()> &body);
+
+#endif // PROCSPAWN_H
@@ -0,0 +1,312 @@
+#include "profiler.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "../JAM/executionengine.h"
+using namespace std;
+
+#define PROFILE_MAX_FRAMES 64
+#define PROFILE_POOL_SLOTS (1 << 21)
+#define PROFILE_TOP_ROWS 25
+#define PROFILE_TOP_SITES 10
+
+// -------------------------
+// Sample Storage
+// -------------------------
+
+// Samples are written by the SIGPROF handler into a preallocated pool as
+// [depth, frame0 (leaf), frame1, ...] records, so the handler never allocates.
+static vector<void*> sample_pool;
+static atomic<size_t> pool_used{0};
+static atomic<size_t> samples_dropped{0};
+
+/**
+ * @brief SIGPROF handler that records the interrupted call stack.
+ *
+ * The first two frames belong to the handler and the signal trampoline and
+ * are skipped, so the leaf frame is the exact interrupted program counter.
+ */
+static void on_profile_tick(int)
+{
+    int saved_errno = errno;
+    void* frames[PROFILE_MAX_FRAMES];
+    int depth = backtrace(frames, PROFILE_MAX_FRAMES) - 2;
+
+    if (depth > 0)
+    {
+        size_t at = pool_used.fetch_add(depth + 1, memory_order_relaxed);
+        if (at + depth + 1 <= sample_pool.size())
+        {
+            sample_pool[at] = reinterpret_cast<void*>(static_cast<intptr_t>(depth));
+            memcpy(&sample_pool[at + 1], frames + 2, depth * sizeof(void*));
+        }
+        else
+        {
+            samples_dropped.fetch_add(1, memory_order_relaxed);
+        }
+    }
+    errno = saved_errno;
+}
+
+// -------------------------
+// Symbolization
+// -------------------------
+
+/**
+ * @brief Formats a code address as "module+0xoffset" for use with addr2line.
+ *
+ * @param addr Code address.
+ * @return Module-relative location string.
+ */
+static string site_name(void* addr)
+{
+    Dl_info info;
+    if (dladdr(addr, &info) && info.dli_fname)
+    {
+        const char* base = strrchr(info.dli_fname, '/');
+        uintptr_t offset = reinterpret_cast<uintptr_t>(addr) - reinterpret_cast<uintptr_t>(info.dli_fbase);
+        stringstream ss;
+        ss << (base ? base + 1 : info.dli_fname) << "+0x" << hex << offset;
+        return ss.str();
+    }
+    stringstream ss;
+    ss << addr;
+    return ss.str();
+}
+
+/**
+ * @brief Resolves a code address to a readable function name.
+ *
+ * Uses the dynamic symbol table, so the shell must be linked with -rdynamic
+ * for interpreter functions to show up by name. Unresolved addresses fall
+ * back to "module+0xoffset" which addr2line understands.
+ *
+ * @param addr Code address taken from a sampled stack.
+ * @return Demangled function name or module offset.
+ */
+static string symbol_name(void* addr)
+{
+    Dl_info info;
+    if (dladdr(addr, &info) && info.dli_sname)
+    {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        string name = (status == 0 && demangled) ? demangled : info.dli_sname;
+        free(demangled);
+        return name;
+    }
+    return site_name(addr);
+}
+
+// -------------------------
+// Report Generation
+// -------------------------
+
+struct FunctionStats {
+    size_t self = 0;
+    size_t total = 0;
+};
+
+/**
+ * @brief Aggregates recorded samples and prints the profile report.
+ *
+ * Frames above profile_jam_script() belong to the shell itself and are
+ * trimmed, so every stack starts at the interpreter entry point.
+ *
+ * @param filename    Script that was profiled (used in the header).
+ * @param folded_path Output path for the collapsed-stack file.
+ * @param wall_ms     Wall-clock duration of the run in milliseconds.
+ */
+static void write_profile_report(const char* filename, const string& folded_path, double wall_ms)
+{
+    unordered_set<string> interned;
+    unordered_map<void*, const string*> names;
+    unordered_map<string, FunctionStats> functions;
+    unordered_map<void*, size_t> sites;
+    unordered_map<string, size_t> folded;
+
+    // Interned so that recursive frames of one function compare equal by pointer.
+    // Frame 0 is the interrupted PC itself. The frames above it are return
+    // addresses, which point past the call, so step back into the call.
+    auto name_of = [&](void* addr, bool leaf) -> const string* {
+        void* pc = leaf ? addr : static_cast<char*>(addr) - 1;
+        auto it = names.find(pc);
+        if (it == names.end())
+        {
+            const string& name = *interned.insert(symbol_name(pc)).first;
+            it = names.emplace(pc, &name).first;
+        }
+        return it->second;
+    };
+
+    const string root = symbol_name(reinterpret_cast<void*>(&profile_jam_script));
+    size_t used = min(pool_used.load(), sample_pool.size());
+    size_t samples = 0;
+    for (size_t at = 0; at < used;)
+    {
+        int depth = static_cast<int>(reinterpret_cast<intptr_t>(sample_pool[at]));
+        void** frames = &sample_pool[at + 1];
+        at += depth + 1;
+
+        vector<const string*> stack;
+        for (int i = 0; i < depth; ++i)
+        {
+            const string* name = name_of(frames[i], i == 0);
+            if (*name == root)
+                break;
+            stack.push_back(name);
+        }
+        if (stack.empty())
+            continue;
+
+        samples++;
+        sites[frames[0]]++;
+        functions[*stack[0]].self++;
+
+        unordered_set<const string*> seen;
+        string line;
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        {
+            if (seen.insert(*it).second)
+                functions[**it].total++;
+            if (!line.empty())
+                line += ';';
+            line += **it;
+        }
+        folded[line]++;
+    }
+
+    ios_base::fmtflags saved_flags = cout.flags();
+    streamsize saved_precision = cout.precision();
+    double ms_per_sample = PROFILE_INTERVAL_US / 1000.0;
+    cout << "\n===== JAM Profile: " << filename << " =====\n";
+    cout << "Wall time: " << fixed << setprecision(1) << wall_ms << " ms, "
+         << samples << " samples at " << PROFILE_INTERVAL_US << "us";
+    if (samples_dropped.load())
+        cout << " (" << samples_dropped.load() << " dropped)";
+    cout << "\n\n";
+
+    if (samples == 0)
+    {
+        cout << "No samples collected; the script finished in under one interval.\n";
+        cout.flags(saved_flags);
+        cout.precision(saved_precision);
+        return;
+    }
+
+    vector<pair<string, FunctionStats>> rows(functions.begin(), functions.end());
+    sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        if (a.second.self != b.second.self)
+            return a.second.self > b.second.self;
+        return a.second.total > b.second.total;
+    });
+
+    cout << setw(8) << "Self%" << setw(10) << "Self ms" << setw(9) << "Total%" << setw(10) << "Total ms" << "  Function\n";
+    for (size_t i = 0; i < rows.size() && i < PROFILE_TOP_ROWS; ++i)
+    {
+        const auto& [name, stats] = rows[i];
+        cout << setw(7) << setprecision(1) << 100.0 * stats.self / samples << "%"
+             << setw(10) << stats.self * ms_per_sample
+             << setw(8) << 100.0 * stats.total / samples << "%"
+             << setw(10) << stats.total * ms_per_sample
+             << "  " << name << "\n";
+    }
+
+    vector<pair<void*, size_t>> hot(sites.begin(), sites.end());
+    sort(hot.begin(), hot.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    cout << "\nHot sites (resolve with addr2line -f -e <module> <offset>):\n";
+    for (size_t i = 0; i < hot.size() && i < PROFILE_TOP_SITES; ++i)
+    {
+        string site = site_name(hot[i].first);
+        string symbol = symbol_name(hot[i].first);
+        cout << setw(7) << 100.0 * hot[i].second / samples << "%  " << site;
+        if (symbol != site)
+            cout << "  " << symbol;
+        cout << "\n";
+    }
+    cout.flags(saved_flags);
+    cout.precision(saved_precision);
+
+    ofstream out(folded_path);
+    if (!out)
+    {
+        cerr << "Failed to write collapsed stacks to '" << folded_path << "'.\n";
+        return;
+    }
+    for (const auto& [stack, count] : folded)
+    {
+        out << stack << " " << count << "\n";
+    }
+    cout << "\nCollapsed stacks written to " << folded_path << " (flamegraph.pl compatible)\n";
+}
+
+// -------------------------
+// Profiler Entry Point
+// -------------------------
+
+/**
+ * @brief Executes a JAM script under the sampling profiler.
+ *
+ * Arms a CPU-time interval timer for the duration of run_jam_script(),
+ * records the call stack on every tick and prints a table of self and
+ * inclusive time per function plus the hottest code sites.
+ *
+ * @param filename    The JAM script to execute.
+ * @param folded_path Collapsed-stack output file, or nullptr for "<filename>.folded".
+ */
+void profile_jam_script(const char* filename, const char* folded_path)
+{
+    string out_path = folded_path ? folded_path : string(filename) + ".folded";
+
+    sample_pool.assign(PROFILE_POOL_SLOTS, nullptr);
+    pool_used = 0;
+    samples_dropped = 0;
+
+    // backtrace() loads libgcc lazily on first use, which is not async-signal-safe.
+    void* warmup[1];
+    backtrace(warmup, 1);
+
+    struct sigaction action = {}, previous = {};
+    action.sa_handler = on_profile_tick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previous);
+
+    struct itimerval timer = {}, stopped = {};
+    timer.it_interval.tv_usec = PROFILE_INTERVAL_US;
+    timer.it_value.tv_usec = PROFILE_INTERVAL_US;
+
+    auto start = chrono::steady_clock::now();
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    int result = run_jam_script(filename);
+    setitimer(ITIMER_PROF, &stopped, nullptr);
+    auto end = chrono::steady_clock::now();
+
+    sigaction(SIGPROF, &previous, nullptr);
+
+    if (result != 0)
+    {
+        cerr << "JAM execution failed with code: " << result << endl;
+    }
+    write_profile_report(filename, out_path, chrono::duration<double, milli>(end - start).count());
+
+    sample_pool.clear();
+    sample_pool.shrink_to_fit();
+}
@@ -0,0 +1,9 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Sampling interval of the JAM profiler in microseconds of CPU time.
+#define PROFILE_INTERVAL_US 1000
+
+void profile_jam_script(const char* filename, const char* folded_path);
+
+#endif // PROFILER_H
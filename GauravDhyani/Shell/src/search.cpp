@@ -0,0 +1,819 @@
+#include "search.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <map>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "matcher.h"
+#include "searchindex.h"
+#include "workqueue.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SEARCH_QUEUE_CAPACITY 65536 // Pending directories and files; overflow is handled inline
+#define SEARCH_OUTPUT_CAPACITY 1024 // Scanned files waiting for the printer
+#define SEARCH_REORDER_WINDOW 4096  // Stable order: files the walker may run ahead of the printer
+#define GREP_MMAP_THRESHOLD (64 * 1024) // Smaller files are read instead of mapped
+#define GREP_BINARY_PROBE size_t(8192)  // Leading bytes checked for NUL
+
+// -------------------------
+// File Scanning
+// -------------------------
+
+/**
+ * @brief Finds the first occurrence of needle in haystack, like memmem().
+ *
+ * With SSE2, 16 candidate positions at a time are compared against the
+ * needle's first and last bytes and only positions matching both are
+ * checked in full; on text this rejects almost every position without a
+ * byte-by-byte compare. Other targets, and the tail, use memmem().
+ */
+const char *find_substring(const char *haystack, size_t size, const char *needle, size_t length)
+{
+    if (length <= 1)
+        return length ? static_cast<const char *>(memchr(haystack, needle[0], size)) : haystack;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[length - 1]);
+    for (; i + length + 15 <= size; i += 16)
+    {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i + length - 1));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+        while (mask)
+        {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, length - 2) == 0)
+                return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return static_cast<const char *>(memmem(haystack + i, size - i, needle, length));
+}
+
+// -------------------------
+// File Loading
+// -------------------------
+
+// The mapping this thread is scanning, so that a SIGBUS from a file
+// truncated under it can be told apart from a real fault.
+static thread_local const char *scan_begin = nullptr;
+static thread_local size_t scan_length = 0;
+static thread_local volatile sig_atomic_t scan_truncated = 0;
+static uintptr_t page_size = 4096;
+
+/**
+ * @brief Handles SIGBUS from reading a mapped file past its new end.
+ *
+ * The vanished pages are replaced with zeros so the scan runs to the end;
+ * the file is then reported as truncated and its result dropped. A fault
+ * outside the current mapping gets the default action when it recurs.
+ */
+static void on_truncated_mapping(int, siginfo_t *info, void *)
+{
+    uintptr_t addr = reinterpret_cast<uintptr_t>(info->si_addr);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(scan_begin);
+    if (scan_begin && addr >= begin && addr < begin + scan_length)
+    {
+        uintptr_t page = addr & ~(page_size - 1);
+        void *zeros = mmap(reinterpret_cast<void *>(page), begin + scan_length - page, PROT_READ,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        if (zeros != MAP_FAILED)
+        {
+            scan_truncated = 1;
+            return;
+        }
+    }
+    signal(SIGBUS, SIG_DFL);
+}
+
+/**
+ * @brief Installs the SIGBUS handler for mapped files, once per process.
+ */
+static void catch_truncated_mappings()
+{
+    static std::once_flag installed;
+    std::call_once(installed, []() {
+        page_size = sysconf(_SC_PAGESIZE);
+        struct sigaction action = {};
+        action.sa_sigaction = on_truncated_mapping;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, nullptr);
+    });
+}
+
+FileContents::~FileContents()
+{
+    if (mapping)
+    {
+        scan_begin = nullptr;
+        scan_length = 0;
+        munmap(mapping, mapped);
+    }
+}
+
+/**
+ * @brief Loads a regular file.
+ *
+ * Large files are memory-mapped; small ones are read into a per-thread
+ * buffer, which is cheaper than setting up a mapping. That buffer is
+ * shared, so a thread holds only one loaded FileContents at a time.
+ *
+ * @param path File to load.
+ * @return false if it is not a readable regular file.
+ */
+bool FileContents::load(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    static thread_local std::vector<char> buffer;
+    if (size >= GREP_MMAP_THRESHOLD)
+    {
+        catch_truncated_mappings();
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, size, MADV_SEQUENTIAL);
+            mapping = map;
+            mapped = size;
+            bytes = static_cast<const char *>(map);
+            length = size;
+            scan_begin = bytes;
+            scan_length = size;
+            scan_truncated = 0;
+        }
+    }
+    if (!mapping)
+    {
+        // The file may change size under us; read what is there now.
+        buffer.resize(size);
+        size_t got = 0;
+        while (got < size)
+        {
+            ssize_t n = read(fd, buffer.data() + got, size - got);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            got += n;
+        }
+        bytes = buffer.data();
+        length = got;
+    }
+    close(fd);
+    return true;
+}
+
+/**
+ * @brief Tells whether the mapped file shrank while it was being read.
+ *
+ * The missing part read as zeros, so nothing read from it can be trusted.
+ */
+bool FileContents::truncated() const
+{
+    return mapping && scan_truncated;
+}
+
+/**
+ * @brief Tells whether the file looks binary: a NUL byte in its first block, as grep does.
+ */
+bool FileContents::is_binary() const
+{
+    return memchr(bytes, '\0', std::min(length, GREP_BINARY_PROBE)) != nullptr;
+}
+
+/**
+ * @brief Finds the lines of a file that match.
+ *
+ * Binary files are skipped unless asked for, as are mapped files cut short
+ * while they are scanned.
+ *
+ * @param filepath  Path to the file.
+ * @param matcher   Compiled patterns.
+ * @param max_lines Stop after this many matching lines.
+ * @param binary    Search the file even if it looks binary.
+ * @param matches   Receives the matching lines.
+ */
+void grep_in_file(const std::string &filepath, const Matcher &matcher, size_t max_lines, bool binary,
+                  FileMatches &matches)
+{
+    FileContents file;
+    if (file.load(filepath) && file.size() > 0 && (binary || !file.is_binary()))
+    {
+        matcher.find_lines(file.data(), file.size(), max_lines, matches);
+        if (file.truncated())
+        {
+            matches.lines.clear();
+            matches.patterns.clear();
+        }
+    }
+}
+
+// -------------------------
+// Parallel Traversal
+// -------------------------
+
+// A directory to list or a file to visit.
+struct SearchTask {
+    std::string path;
+    bool is_dir = false;
+    uint64_t seq = 0;  // Position in a stable traversal, when there is one
+    IgnoreChain rules; // Directories: ignore rules in force above them
+};
+
+// State shared by the workers of one pool.
+struct SearchState {
+    WalkPolicy policy;
+    WorkQueue<SearchTask> queue{SEARCH_QUEUE_CAPACITY};
+    std::atomic<size_t> pending{0}; // Tasks submitted but not yet finished
+    std::function<void(int worker, SearchTask &task)> visit;
+    const std::atomic<bool> *stop = nullptr; // Skip remaining tasks once set
+};
+
+static void run_task(SearchState &state, SearchTask &task, int worker);
+
+/**
+ * @brief Queues a task, or runs it on the spot when the queue is full.
+ */
+static void submit_task(SearchState &state, SearchTask task, int worker)
+{
+    state.pending.fetch_add(1, std::memory_order_relaxed);
+    if (state.queue.try_push(task))
+        return;
+    run_task(state, task, worker);
+    state.pending.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+ * @brief Runs one queued task, if there is one.
+ * @return false if the queue was empty.
+ */
+static bool run_queued_task(SearchState &state, int worker)
+{
+    SearchTask task;
+    if (!state.queue.try_pop(task))
+        return false;
+    run_task(state, task, worker);
+    state.pending.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Lists a directory (queueing its entries) or visits a file.
+ *
+ * Directories are read with the pool's walk policy; symlinks to files
+ * count as files and symlinks to directories are not followed.
+ * Unreadable directories are skipped, and so is everything once the
+ * pool's stop flag is set.
+ *
+ * @param state  Shared pool state.
+ * @param task   Task to run.
+ * @param worker Index of the calling worker.
+ */
+static void run_task(SearchState &state, SearchTask &task, int worker)
+{
+    if (state.stop && state.stop->load(std::memory_order_relaxed))
+        return;
+    if (!task.is_dir)
+    {
+        state.visit(worker, task);
+        return;
+    }
+
+    DirListing listing;
+    read_directory({task.path, std::move(task.rules)}, state.policy, WALK_LINKED_FILES, listing);
+    for (const WalkEntry &entry : listing.entries)
+    {
+        if (entry.type != DT_REG && entry.type != DT_DIR)
+            continue;
+        SearchTask child;
+        child.path = join_path(task.path, entry.name);
+        child.is_dir = entry.type == DT_DIR;
+        if (child.is_dir)
+            child.rules = listing.rules;
+        submit_task(state, std::move(child), worker);
+    }
+}
+
+/**
+ * @brief Takes tasks from the shared queue until all work is done.
+ *
+ * The pool is finished when no task is queued or running; idle workers
+ * yield, then back off briefly, while others may still add directories.
+ */
+static void search_worker(SearchState &state, int worker)
+{
+    int idle_rounds = 0;
+    while (true)
+    {
+        if (run_queued_task(state, worker))
+        {
+            idle_rounds = 0;
+            continue;
+        }
+        if (state.pending.load(std::memory_order_acquire) == 0)
+            return;
+        if (++idle_rounds < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+/**
+ * @brief Runs a pool of workers over the tasks that feed() submits.
+ *
+ * Listing directories and visiting files are both tasks on one lock-free
+ * queue, so a wide directory and a deep one spread over the pool alike.
+ * The calling thread is worker 0: it runs feed() while the other workers
+ * already take tasks, then works through the queue with them.
+ */
+static void run_pool(SearchState &state, int jobs, const std::function<void()> &feed)
+{
+    // Hold one pending task while feeding so early workers do not quit.
+    state.pending.fetch_add(1, std::memory_order_relaxed);
+    std::vector<std::thread> workers;
+    for (int i = 1; i < jobs; ++i)
+        workers.emplace_back(search_worker, std::ref(state), i);
+    feed();
+    state.pending.fetch_sub(1, std::memory_order_release);
+
+    search_worker(state, 0);
+    for (auto &worker : workers)
+        worker.join();
+}
+
+/**
+ * @brief Resolves a -j value: 0 or less means one worker per CPU.
+ */
+int resolve_jobs(int jobs)
+{
+    return jobs > 0 ? jobs : std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * @brief Calls visit for every regular file below root, on a worker pool.
+ *
+ * @param root   Directory to walk.
+ * @param jobs   Worker threads, as returned by resolve_jobs().
+ * @param policy Hidden and ignored paths.
+ * @param visit  Called as visit(worker, path); worker is in [0, jobs).
+ */
+void walk_files_parallel(const std::string &root, int jobs, const WalkPolicy &policy, const FileVisitor &visit)
+{
+    SearchState state;
+    state.policy = policy;
+    state.visit = [&](int worker, SearchTask &task) { visit(worker, task.path); };
+    run_pool(state, jobs, [&] { submit_task(state, {root, true, 0, walk_root(root, policy, nullptr).rules}, 0); });
+}
+
+/**
+ * @brief Calls visit for each of the given files, on a worker pool.
+ */
+void visit_files_parallel(std::vector<std::string> files, int jobs, const FileVisitor &visit)
+{
+    SearchState state;
+    state.visit = [&](int worker, SearchTask &task) { visit(worker, task.path); };
+    run_pool(state, jobs, [&] {
+        for (auto &file : files)
+            submit_task(state, {std::move(file), false, 0, nullptr}, 0);
+    });
+}
+
+// -------------------------
+// Streaming Search
+// -------------------------
+
+// A scanned file on its way to the printer. In stable order every file is
+// sent, matching or not, so the printer knows when a position is done.
+struct SearchResult {
+    uint64_t seq = 0;
+    FileMatches matches;
+};
+
+// State of one streamed search, shared by the pool and the printer.
+struct SearchStream {
+    SearchState pool;
+    WorkQueue<SearchResult> output{SEARCH_OUTPUT_CAPACITY};
+    std::atomic<bool> stop{false};        // Limits reached; finish quickly
+    std::atomic<bool> finished{false};    // Pool done; no more results
+    std::atomic<uint64_t> next_seq{0};    // Next position the printer needs (stable order)
+    const Matcher *matcher = nullptr;
+    SearchOptions options;
+};
+
+/**
+ * @brief Sleeps a little longer the longer a thread has been waiting.
+ */
+static void back_off(int &rounds)
+{
+    if (++rounds < 64)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+/**
+ * @brief Scans one file and hands the result to the printer.
+ *
+ * The output queue is bounded, so a worker waits here while the printer
+ * is behind; results are dropped once the search has been stopped.
+ */
+static void scan_for_stream(SearchStream &stream, SearchTask &task)
+{
+    SearchResult result;
+    result.seq = task.seq;
+    size_t max_lines = stream.options.max_count ? stream.options.max_count : SIZE_MAX;
+    grep_in_file(task.path, *stream.matcher, max_lines, stream.options.binary, result.matches);
+    if (result.matches.lines.empty() && !stream.options.stable)
+        return;
+    result.matches.path = std::move(task.path);
+
+    int rounds = 0;
+    while (!stream.output.try_push(result))
+    {
+        if (stream.stop.load(std::memory_order_relaxed))
+            return;
+        back_off(rounds);
+    }
+}
+
+/**
+ * @brief Walks a directory in path order, numbering files for the printer.
+ *
+ * Entries are visited sorted, with directories keyed as "name/", which is
+ * exactly the order of the full paths. Listing is serial here; scanning
+ * still runs on the whole pool. The walker stays at most
+ * SEARCH_REORDER_WINDOW files ahead of the printer, helping with queued
+ * scans while it waits, so only that window is ever buffered.
+ *
+ * @param stream Search state.
+ * @param dir    Directory to walk and the ignore rules above it.
+ * @param seq    Next file number; advanced for each file.
+ */
+static void walk_in_order(SearchStream &stream, const WalkDir &dir, uint64_t &seq)
+{
+    std::vector<std::pair<std::string, bool>> children; // (sort key, is directory)
+    DirListing listing;
+    read_directory(dir, stream.options.walk, WALK_LINKED_FILES, listing);
+    for (WalkEntry &entry : listing.entries)
+    {
+        if (entry.type == DT_DIR)
+            children.emplace_back(entry.name + "/", true);
+        else if (entry.type == DT_REG)
+            children.emplace_back(std::move(entry.name), false);
+    }
+    std::sort(children.begin(), children.end());
+
+    for (auto &[key, is_dir] : children)
+    {
+        if (stream.stop.load(std::memory_order_relaxed))
+            return;
+        if (is_dir)
+        {
+            key.pop_back();
+            walk_in_order(stream, {join_path(dir.path, key), listing.rules}, seq);
+            continue;
+        }
+        int rounds = 0;
+        while (seq >= stream.next_seq.load(std::memory_order_acquire) + SEARCH_REORDER_WINDOW)
+        {
+            if (stream.stop.load(std::memory_order_relaxed))
+                return;
+            if (run_queued_task(stream.pool, 0))
+                rounds = 0;
+            else
+                back_off(rounds);
+        }
+        submit_task(stream.pool, {join_path(dir.path, key), false, seq++, nullptr}, 0);
+    }
+}
+
+/**
+ * @brief Prints results as they arrive, in order if asked, until the pool is done.
+ *
+ * In stable order, results that arrive ahead of their turn wait in a
+ * reorder buffer keyed by file number. Once a limit is reached the pool is
+ * told to stop and the remaining results are drained unprinted.
+ */
+static void print_stream(SearchStream &stream, const MatchSink &sink)
+{
+    std::map<uint64_t, FileMatches> early; // Stable order: results ahead of next_seq
+    uint64_t next = 0;
+    size_t lines = 0, files = 0;
+    const SearchOptions &options = stream.options;
+
+    auto emit = [&](FileMatches &matches) {
+        if (stream.stop.load(std::memory_order_relaxed) || matches.lines.empty())
+            return;
+        if (options.max_count && lines + matches.lines.size() >= options.max_count)
+        {
+            matches.lines.resize(options.max_count - lines);
+            if (!matches.patterns.empty())
+                matches.patterns.resize(matches.lines.size());
+            stream.stop = true;
+        }
+        lines += matches.lines.size();
+        files++;
+        if (options.max_files && files >= options.max_files)
+            stream.stop = true;
+        sink(matches);
+    };
+
+    SearchResult result;
+    int rounds = 0;
+    while (true)
+    {
+        if (!stream.output.try_pop(result))
+        {
+            if (!stream.finished.load(std::memory_order_acquire))
+            {
+                back_off(rounds);
+                continue;
+            }
+            // Everything pushed before the pool finished is visible now.
+            if (!stream.output.try_pop(result))
+                break;
+        }
+        rounds = 0;
+        if (!options.stable)
+        {
+            emit(result.matches);
+            continue;
+        }
+        early.emplace(result.seq, std::move(result.matches));
+        while (!early.empty() && early.begin()->first == next)
+        {
+            emit(early.begin()->second);
+            early.erase(early.begin());
+            next++;
+        }
+        stream.next_seq.store(next, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Runs a streamed search: the pool scans, the calling thread prints.
+ *
+ * @param stream Search state with matcher and options set.
+ * @param feed   Submits the search's first tasks to stream.pool.
+ * @param sink   Receives each matching file, in the order printed.
+ */
+static void run_stream(SearchStream &stream, const std::function<void()> &feed, const MatchSink &sink)
+{
+    int jobs = resolve_jobs(stream.options.jobs);
+    stream.pool.stop = &stream.stop;
+    stream.pool.policy = stream.options.walk;
+    stream.pool.visit = [&](int, SearchTask &task) { scan_for_stream(stream, task); };
+    std::thread pool([&] {
+        run_pool(stream.pool, jobs, feed);
+        stream.finished.store(true, std::memory_order_release);
+    });
+    print_stream(stream, sink);
+    pool.join();
+}
+
+/**
+ * @brief Recursively searches a directory, streaming matching files to sink.
+ *
+ * Without options.stable, directories are listed by the whole pool and
+ * files are reported as soon as they are scanned. options.walk decides
+ * which hidden and ignored paths are left out.
+ *
+ * @param root    Root directory.
+ * @param matcher Compiled patterns.
+ * @param options Workers, limits and ordering.
+ * @param sink    Receives each matching file.
+ */
+void search_directory(const std::string &root, const Matcher &matcher, const SearchOptions &options,
+                      const MatchSink &sink)
+{
+    SearchStream stream;
+    stream.matcher = &matcher;
+    stream.options = options;
+    run_stream(stream, [&] {
+        WalkDir start = walk_root(root, options.walk, nullptr);
+        if (!options.stable)
+        {
+            submit_task(stream.pool, {root, true, 0, std::move(start.rules)}, 0);
+            return;
+        }
+        uint64_t seq = 0;
+        walk_in_order(stream, start, seq);
+    }, sink);
+}
+
+/**
+ * @brief Searches the given files only, e.g. candidates from the index.
+ *
+ * In stable order the files are reported in the order given.
+ */
+void search_files(std::vector<std::string> files, const Matcher &matcher, const SearchOptions &options,
+                  const MatchSink &sink)
+{
+    SearchStream stream;
+    stream.matcher = &matcher;
+    stream.options = options;
+    run_stream(stream, [&] {
+        for (uint64_t seq = 0; seq < files.size(); ++seq)
+        {
+            int rounds = 0;
+            while (options.stable && seq >= stream.next_seq.load(std::memory_order_acquire) + SEARCH_REORDER_WINDOW)
+            {
+                if (stream.stop.load(std::memory_order_relaxed))
+                    return;
+                if (run_queued_task(stream.pool, 0))
+                    rounds = 0;
+                else
+                    back_off(rounds);
+            }
+            if (stream.stop.load(std::memory_order_relaxed))
+                return;
+            submit_task(stream.pool, {std::move(files[seq]), false, seq, nullptr}, 0);
+        }
+    }, sink);
+}
+
+/**
+ * @brief Displays one file's matches with highlighting and line numbers.
+ * @param matches File and its matched lines.
+ */
+void display_file_matches(const FileMatches &matches)
+{
+    std::cout << "\n\033[95m" << matches.path << "\033[0m\n";
+    for (const auto &[line, text] : matches.lines)
+    {
+        std::cout << "\033[34m" << line << "\033[0m: ..." << text << '\n';
+    }
+}
+
+// -------------------------
+// sgown Builtin
+// -------------------------
+
+/**
+ * @brief Prints command-line usage.
+ */
+static void print_sgown_usage()
+{
+    std::cerr << "Usage: sgown [-j N] [--stable] [--max-count N] [--max-files N] [--no-index]\n"
+                 "             [--hidden] [--no-ignore] [--binary] [-E] <term>\n"
+                 "       sgown [options] [-E] -e <pattern> [-e <pattern> ...]\n"
+                 "       sgown [-j N] --index build|update|drop\n"
+                 "  Searches every file below the current directory for <term>, printing files as\n"
+                 "  they are scanned (in path order with --stable). -e may be repeated to find lines\n"
+                 "  with any of several patterns in one pass, and -E makes patterns extended regular\n"
+                 "  expressions. Hidden paths, .git and whatever .gitignore or .jamignore files\n"
+                 "  exclude are skipped unless --hidden or --no-ignore is given, and binary files\n"
+                 "  unless --binary is. With an index (" SEARCH_INDEX_FILE "), only files\n"
+                 "  containing all of a term's trigrams are read.\n";
+}
+
+/**
+ * @brief Prints how many lines matched each pattern, after a -e or -E search.
+ */
+static void print_sgown_summary(const Matcher &matcher, const std::vector<size_t> &counts, size_t lines,
+                                size_t files)
+{
+    std::cout << '\n' << lines << " matching line" << (lines == 1 ? "" : "s") << " in " << files << " file"
+              << (files == 1 ? "" : "s") << '\n';
+    if (matcher.pattern_count() < 2)
+        return;
+    for (size_t i = 0; i < matcher.pattern_count(); ++i)
+        std::cout << "  " << counts[i] << '\t' << matcher.pattern(i) << '\n';
+}
+
+/**
+ * @brief Handles `sgown`: searches every file below ".", or manages its index.
+ */
+int handle_sgown_command(int token_count, char *tokens[])
+{
+    SearchOptions options;
+    bool use_index = true, regex = false;
+    std::string index_action;
+    std::vector<std::string> patterns;
+    int i = 1;
+    for (; i < token_count && tokens[i][0] == '-'; ++i)
+    {
+        const char *arg = tokens[i];
+        bool needs_value = strcmp(arg, "-j") == 0 || strcmp(arg, "--index") == 0 || strcmp(arg, "-e") == 0 ||
+                           strcmp(arg, "--max-count") == 0 || strcmp(arg, "--max-files") == 0;
+        if (needs_value && i + 1 >= token_count)
+        {
+            print_sgown_usage();
+            return 2;
+        }
+        if (strcmp(arg, "-j") == 0)
+            options.jobs = atoi(tokens[++i]);
+        else if (strcmp(arg, "--index") == 0)
+            index_action = tokens[++i];
+        else if (strcmp(arg, "-e") == 0)
+            patterns.push_back(tokens[++i]);
+        else if (strcmp(arg, "-E") == 0 || strcmp(arg, "--regex") == 0)
+            regex = true;
+        else if (strcmp(arg, "--max-count") == 0)
+            options.max_count = strtoul(tokens[++i], nullptr, 10);
+        else if (strcmp(arg, "--max-files") == 0)
+            options.max_files = strtoul(tokens[++i], nullptr, 10);
+        else if (strcmp(arg, "--stable") == 0)
+            options.stable = true;
+        else if (strcmp(arg, "--no-index") == 0)
+            use_index = false;
+        else if (strcmp(arg, "--hidden") == 0)
+            options.walk.hidden = true;
+        else if (strcmp(arg, "--no-ignore") == 0)
+            options.walk.ignore_files = false;
+        else if (strcmp(arg, "--binary") == 0)
+            options.binary = true;
+        else
+            break; // A term that starts with '-'
+    }
+
+    if (!index_action.empty())
+    {
+        if (i != token_count)
+        {
+            print_sgown_usage();
+            return 2;
+        }
+        if (index_action == "build" || index_action == "update")
+            return build_search_index(".", index_action == "update", options.jobs) ? 0 : 1;
+        if (index_action == "drop")
+            return drop_search_index(".") ? 0 : 1;
+        print_sgown_usage();
+        return 2;
+    }
+
+    // A single term unless -e gave the patterns.
+    bool summary = regex || !patterns.empty();
+    if (patterns.empty() && i + 1 == token_count)
+        patterns.push_back(tokens[i++]);
+    if (patterns.empty() || i != token_count)
+    {
+        print_sgown_usage();
+        return 2;
+    }
+    Matcher matcher;
+    std::string error;
+    if (!matcher.compile(patterns, regex, error))
+    {
+        std::cerr << "sgown: " << error << '\n';
+        return 2;
+    }
+
+    std::vector<size_t> counts(matcher.pattern_count(), 0);
+    size_t lines = 0, files = 0;
+    MatchSink sink = [&](const FileMatches &matches) {
+        display_file_matches(matches);
+        lines += matches.lines.size();
+        files++;
+        if (matches.patterns.empty())
+            counts[0] += matches.lines.size();
+        for (const auto &line_patterns : matches.patterns)
+            for (uint32_t id : line_patterns)
+                counts[id]++;
+    };
+
+    // The index covers the default walk and records binary files as never matching.
+    WalkPolicy default_walk;
+    use_index = use_index && !options.binary && options.walk.hidden == default_walk.hidden &&
+                options.walk.ignore_files == default_walk.ignore_files;
+    std::vector<std::string> literals, candidates;
+    if (use_index && matcher.required_literals(literals) &&
+        index_candidates(".", literals, options.jobs, candidates))
+        search_files(std::move(candidates), matcher, options, sink);
+    else
+        search_directory(".", matcher, options, sink);
+    if (summary)
+        print_sgown_summary(matcher, counts, lines, files);
+    std::cout.flush();
+    return 0;
+}
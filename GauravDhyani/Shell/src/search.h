@@ -0,0 +1,79 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include "walk.h"
+
+// Matching lines of one file as (line number, highlighted line).
+// With several patterns, patterns[i] lists the patterns line i matches.
+struct FileMatches {
+    std::string path;
+    std::vector<std::pair<int, std::string>> lines;
+    std::vector<std::vector<uint32_t>> patterns;
+};
+
+class Matcher;
+
+// Contents of a regular file: memory-mapped when large, read otherwise.
+// A mapped file cut short while it is scanned reads as zeros and reports
+// truncated() instead of raising SIGBUS.
+class FileContents
+{
+public:
+    FileContents() = default;
+    ~FileContents();
+    FileContents(const FileContents &) = delete;
+    FileContents &operator=(const FileContents &) = delete;
+
+    bool load(const std::string &path);
+    bool is_binary() const;
+    bool truncated() const;
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+    const struct stat &status() const { return st; }
+
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+    void *mapping = nullptr;
+    size_t mapped = 0;
+    struct stat st = {};
+};
+
+// How sgown searches: workers, limits (0 = none), output order and which
+// files it looks at.
+struct SearchOptions {
+    int jobs = 0;          // Worker threads; 0 means one per CPU
+    size_t max_count = 0;  // Stop after this many matching lines
+    size_t max_files = 0;  // Stop after this many matching files
+    bool stable = false;   // Report files in path order instead of as found
+    bool binary = false;   // Search files that look binary too
+    WalkPolicy walk;       // Hidden and ignored paths
+};
+
+// Receives each matching file as the search finds it.
+using MatchSink = std::function<void(const FileMatches &matches)>;
+
+// Called by a pool worker for each file; worker is the worker's index.
+using FileVisitor = std::function<void(int worker, std::string &path)>;
+
+int resolve_jobs(int jobs);
+void walk_files_parallel(const std::string &root, int jobs, const WalkPolicy &policy, const FileVisitor &visit);
+void visit_files_parallel(std::vector<std::string> files, int jobs, const FileVisitor &visit);
+
+const char *find_substring(const char *haystack, size_t size, const char *needle, size_t length);
+void grep_in_file(const std::string &filepath, const Matcher &matcher, size_t max_lines, bool binary,
+                  FileMatches &matches);
+void search_directory(const std::string &root, const Matcher &matcher, const SearchOptions &options,
+                      const MatchSink &sink);
+void search_files(std::vector<std::string> files, const Matcher &matcher, const SearchOptions &options,
+                  const MatchSink &sink);
+void display_file_matches(const FileMatches &matches);
+int handle_sgown_command(int token_count, char *tokens[]);
+
+#endif // SEARCH_H
@@ -0,0 +1,717 @@
+#include "searchindex.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "search.h"
+
+#define INDEX_MAGIC "JAMTRI1"
+#define INDEX_VERSION 1
+#define INDEX_MAX_TRIGRAMS 200000 // Files with more distinct trigrams are always scanned
+#define INDEX_RACY_NS 10000000    // Files modified this close to the last build are re-read
+
+// -------------------------
+// On-Disk Format
+// -------------------------
+//
+// The index is one file of fixed-size tables that a query uses straight
+// from an mmap, without parsing:
+//
+//   IndexHeader
+//   IndexFileEntry[file_count]       sorted by path; a file's id is its position
+//   IndexTrigram[trigram_count]      sorted by trigram, for binary search
+//   uint32_t[always_count]           ids of files too varied to index
+//   names                            paths, not NUL-terminated
+//   postings                         per trigram, LEB128 deltas of file ids
+//
+// Integers are in host byte order; the index is a local cache, not an
+// exchange format.
+
+enum IndexFileFlags : uint32_t {
+    INDEX_BINARY = 1,    // Never matches; sgown skips binary files
+    INDEX_UNINDEXED = 2, // Too many distinct trigrams; always a candidate
+};
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t file_count;
+    uint32_t trigram_count;
+    uint32_t always_count;
+    int64_t built_sec; // When the walk that produced the index started
+    int64_t built_nsec;
+    uint64_t files_offset;
+    uint64_t trigrams_offset;
+    uint64_t always_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t postings_offset;
+    uint64_t postings_size;
+};
+
+struct IndexFileEntry {
+    uint64_t name_offset; // Into the names block
+    uint32_t name_length;
+    uint32_t flags;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t size;
+};
+
+struct IndexTrigram {
+    uint32_t trigram; // Three bytes, first byte highest
+    uint32_t count;   // Files containing it
+    uint64_t postings_offset;
+};
+
+/**
+ * @brief Returns the path of the index file for a root.
+ */
+static std::string index_path(const std::string &root)
+{
+    return root + "/" + SEARCH_INDEX_FILE;
+}
+
+// -------------------------
+// Reading
+// -------------------------
+
+// A validated, memory-mapped index.
+struct MappedIndex {
+    const char *base = nullptr;
+    size_t size = 0;
+    const IndexHeader *header = nullptr;
+    const IndexFileEntry *files = nullptr;
+    const IndexTrigram *trigrams = nullptr;
+    const uint32_t *always = nullptr;
+
+    ~MappedIndex()
+    {
+        if (base)
+            munmap(const_cast<char *>(base), size);
+    }
+};
+
+/**
+ * @brief Maps an index file and checks that its tables lie inside it.
+ *
+ * Only the header is read here, so opening costs the same for any size of
+ * index; names and postings are bounds-checked where they are used.
+ *
+ * @return false if there is no index or it is unusable.
+ */
+static bool open_index(const std::string &path, MappedIndex &index)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(IndexHeader))
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    index.base = static_cast<const char *>(map);
+    index.size = st.st_size;
+
+    const IndexHeader *h = reinterpret_cast<const IndexHeader *>(index.base);
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset <= index.size && count <= (index.size - offset) / width;
+    };
+    if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0 || h->version != INDEX_VERSION ||
+        !fits(h->files_offset, h->file_count, sizeof(IndexFileEntry)) ||
+        !fits(h->trigrams_offset, h->trigram_count, sizeof(IndexTrigram)) ||
+        !fits(h->always_offset, h->always_count, sizeof(uint32_t)) || !fits(h->names_offset, h->names_size, 1) ||
+        !fits(h->postings_offset, h->postings_size, 1))
+    {
+        std::cerr << "sgown: " << path << " is not a valid index; rebuild it with sgown --index build\n";
+        return false;
+    }
+    index.header = h;
+    index.files = reinterpret_cast<const IndexFileEntry *>(index.base + h->files_offset);
+    index.trigrams = reinterpret_cast<const IndexTrigram *>(index.base + h->trigrams_offset);
+    index.always = reinterpret_cast<const uint32_t *>(index.base + h->always_offset);
+    return true;
+}
+
+/**
+ * @brief Returns the path of file `id`, or an empty view if it is out of bounds.
+ */
+static std::string_view file_name(const MappedIndex &index, uint32_t id)
+{
+    const IndexFileEntry &entry = index.files[id];
+    if (entry.name_offset > index.header->names_size ||
+        entry.name_length > index.header->names_size - entry.name_offset)
+        return {};
+    return std::string_view(index.base + index.header->names_offset + entry.name_offset, entry.name_length);
+}
+
+/**
+ * @brief Finds a trigram's table entry by binary search.
+ */
+static const IndexTrigram *find_trigram(const MappedIndex &index, uint32_t trigram)
+{
+    const IndexTrigram *begin = index.trigrams;
+    const IndexTrigram *end = begin + index.header->trigram_count;
+    const IndexTrigram *it =
+        std::lower_bound(begin, end, trigram, [](const IndexTrigram &t, uint32_t key) { return t.trigram < key; });
+    return it != end && it->trigram == trigram ? it : nullptr;
+}
+
+/**
+ * @brief Decodes a trigram's posting list into ascending file ids.
+ *
+ * Decoding stops at the end of the postings block or at the first id out
+ * of range, so a damaged index yields fewer candidates, never a crash.
+ */
+static void decode_postings(const MappedIndex &index, const IndexTrigram &trigram, std::vector<uint32_t> &ids)
+{
+    ids.clear();
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(index.base + index.header->postings_offset);
+    const uint8_t *end = p + index.header->postings_size;
+    if (trigram.postings_offset > index.header->postings_size)
+        return;
+    p += trigram.postings_offset;
+
+    uint64_t id = 0;
+    for (uint32_t n = 0; n < trigram.count && p < end; ++n)
+    {
+        uint64_t delta = 0;
+        int shift = 0;
+        while (p < end && shift < 35)
+        {
+            uint8_t byte = *p++;
+            delta |= uint64_t(byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80))
+                break;
+        }
+        id += delta;
+        if (id >= index.header->file_count)
+            return;
+        ids.push_back(uint32_t(id));
+    }
+}
+
+/**
+ * @brief Collects the distinct trigrams of a string, in ascending order.
+ */
+static std::vector<uint32_t> trigrams_of(const std::string &text)
+{
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i + 3 <= text.size(); ++i)
+    {
+        out.push_back(uint32_t(uint8_t(text[i])) << 16 | uint32_t(uint8_t(text[i + 1])) << 8 |
+                      uint8_t(text[i + 2]));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+/**
+ * @brief Whether an entry's mtime is far enough before the build to trust.
+ *
+ * A write in the same timestamp tick as the build leaves the mtime as it
+ * was, so files modified within INDEX_RACY_NS of it are treated as changed.
+ */
+static bool settled_at_build(const IndexHeader &header, const IndexFileEntry &entry)
+{
+    int64_t limit_sec = header.built_sec;
+    int64_t limit_nsec = header.built_nsec - INDEX_RACY_NS;
+    if (limit_nsec < 0)
+    {
+        limit_sec--;
+        limit_nsec += 1000000000;
+    }
+    return entry.mtime_sec < limit_sec || (entry.mtime_sec == limit_sec && entry.mtime_nsec < limit_nsec);
+}
+
+/**
+ * @brief Whether a file's current size and mtime are those the index recorded.
+ */
+static bool matches_entry(const IndexFileEntry &entry, const struct stat &st)
+{
+    return entry.size == uint64_t(st.st_size) && entry.mtime_sec == st.st_mtim.tv_sec &&
+           entry.mtime_nsec == st.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Compares the tree as a default search walks it now with the index.
+ *
+ * Listing directories and stat()ing files costs a small fraction of reading
+ * them, and catches what the index cannot know about: files created since
+ * the build (new names in the walk) and files edited in place (a new size
+ * or mtime). Files that were deleted or are now ignored are simply not
+ * seen.
+ *
+ * @param root    Searched root.
+ * @param index   Its index.
+ * @param jobs    Worker threads for the walk.
+ * @param current Set to 1 for each file id whose file is unchanged.
+ * @param changed Receives the paths of files the index does not describe.
+ */
+static void check_index(const std::string &root, const MappedIndex &index, int jobs, std::vector<uint8_t> &current,
+                        std::vector<std::string> &changed)
+{
+    std::string path = index_path(root);
+    std::string temp = path + ".tmp";
+    std::unordered_map<std::string_view, uint32_t> ids;
+    ids.reserve(index.header->file_count);
+    for (uint32_t id = 0; id < index.header->file_count; ++id)
+    {
+        std::string_view name = file_name(index, id);
+        if (!name.empty() && settled_at_build(*index.header, index.files[id]))
+            ids.emplace(name, id);
+    }
+
+    current.assign(index.header->file_count, 0);
+    jobs = resolve_jobs(jobs);
+    std::vector<std::vector<std::string>> found(jobs);
+    walk_files_parallel(root, jobs, WalkPolicy{}, [&](int worker, std::string &file_path) {
+        if (file_path == path || file_path == temp)
+            return;
+        struct stat st;
+        auto it = ids.find(file_path);
+        if (it != ids.end() && stat(file_path.c_str(), &st) == 0 && matches_entry(index.files[it->second], st))
+            current[it->second] = 1; // Each path is visited once, so workers never share an element
+        else
+            found[worker].push_back(std::move(file_path));
+    });
+    for (auto &part : found)
+        std::move(part.begin(), part.end(), std::back_inserter(changed));
+}
+
+/**
+ * @brief Lists the files that may contain any of terms according to the index.
+ *
+ * A file can only contain a term if it contains every trigram of it, so
+ * a term's candidates are the intersection of its trigrams' posting
+ * lists; those of several terms are merged, and the files that were too
+ * varied to index are added. The tree is then checked against the index
+ * (see check_index()): files created or changed since the build are
+ * candidates whatever they contain, and deleted ones are dropped, so a
+ * stale index costs time but never misses a match. The result is sorted
+ * by path.
+ *
+ * @param root  Searched root.
+ * @param terms Search terms; a file containing any of them is a candidate.
+ * @param jobs  Worker threads for checking the tree; 0 means one per CPU.
+ * @param files Receives candidate paths.
+ * @return false if there is no usable index or some term is too short to
+ *         narrow the search (fewer than three bytes).
+ */
+bool index_candidates(const std::string &root, const std::vector<std::string> &terms, int jobs,
+                      std::vector<std::string> &files)
+{
+    for (const auto &term : terms)
+        if (term.size() < 3)
+            return false;
+    MappedIndex index;
+    if (terms.empty() || !open_index(index_path(root), index))
+        return false;
+
+    std::vector<uint32_t> all(index.always, index.always + index.header->always_count);
+    std::vector<uint32_t> candidates, next, merged;
+    for (const auto &term : terms)
+    {
+        std::vector<const IndexTrigram *> lists;
+        bool all_present = true;
+        for (uint32_t trigram : trigrams_of(term))
+        {
+            const IndexTrigram *entry = find_trigram(index, trigram);
+            if (!entry)
+            {
+                all_present = false;
+                break;
+            }
+            lists.push_back(entry);
+        }
+        if (!all_present)
+            continue;
+
+        // Intersect shortest first so the working set only shrinks.
+        std::sort(lists.begin(), lists.end(),
+                  [](const IndexTrigram *a, const IndexTrigram *b) { return a->count < b->count; });
+        decode_postings(index, *lists[0], candidates);
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+        {
+            decode_postings(index, *lists[i], next);
+            merged.clear();
+            std::set_intersection(candidates.begin(), candidates.end(), next.begin(), next.end(),
+                                  std::back_inserter(merged));
+            candidates.swap(merged);
+        }
+        merged.clear();
+        std::set_union(all.begin(), all.end(), candidates.begin(), candidates.end(), std::back_inserter(merged));
+        all.swap(merged);
+    }
+
+    std::vector<uint8_t> current;
+    check_index(root, index, jobs, current, files);
+    for (uint32_t id : all)
+    {
+        if (id >= index.header->file_count || !current[id])
+            continue;
+        std::string_view name = file_name(index, id);
+        if (!name.empty())
+            files.emplace_back(name);
+    }
+    std::sort(files.begin(), files.end());
+    return true;
+}
+
+// -------------------------
+// Building
+// -------------------------
+
+// A file as it will be written to the index.
+struct IndexedFile {
+    std::string path;
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+    uint64_t size = 0;
+    uint32_t flags = 0;
+    uint32_t old_id = UINT32_MAX;   // Id in the previous index when reused from it
+    std::vector<uint32_t> trigrams; // Ascending
+};
+
+/**
+ * @brief Collects the distinct trigrams of a buffer, in ascending order.
+ *
+ * A per-thread bitmap over all 2^24 trigrams marks the ones seen; only the
+ * bits that were set are cleared afterwards.
+ *
+ * @return false if the buffer has more than INDEX_MAX_TRIGRAMS distinct trigrams.
+ */
+static bool extract_trigrams(const char *data, size_t size, std::vector<uint32_t> &out)
+{
+    static thread_local std::vector<uint64_t> seen(size_t(1) << 18);
+    bool complete = true;
+    uint32_t trigram = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        trigram = (trigram << 8 | uint8_t(data[i])) & 0xffffff;
+        if (i < 2)
+            continue;
+        uint64_t &word = seen[trigram >> 6];
+        uint64_t bit = uint64_t(1) << (trigram & 63);
+        if (word & bit)
+            continue;
+        word |= bit;
+        out.push_back(trigram);
+        if (out.size() > INDEX_MAX_TRIGRAMS)
+        {
+            complete = false;
+            break;
+        }
+    }
+    for (uint32_t t : out)
+        seen[t >> 6] = 0;
+    if (!complete)
+    {
+        out.clear();
+        out.shrink_to_fit();
+        return false;
+    }
+    std::sort(out.begin(), out.end());
+    return true;
+}
+
+/**
+ * @brief Appends an unsigned LEB128 varint.
+ */
+static void put_varint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+/**
+ * @brief Inverts the files' trigram lists and writes the index atomically.
+ *
+ * Trigram lists of freshly read files are scattered into one flat array
+ * grouped by trigram (a counting sort); since files are visited in id
+ * order, each group comes out sorted. Reused files take their postings
+ * from the previous index: both indexes are sorted by path, so mapping
+ * old ids to new ones keeps every list sorted. Each trigram's two lists
+ * are then merged and encoded in one sequential pass.
+ *
+ * The file is written next to the index and renamed over it, so a query
+ * never sees a partial index.
+ *
+ * @param path          Index file.
+ * @param files         Files sorted by path; their trigram lists are released.
+ * @param old           Previous index that reused files refer to, or nullptr.
+ * @param built_at      When the walk started.
+ * @param trigram_count Receives the number of distinct trigrams.
+ * @return Bytes written, or 0 on failure.
+ */
+static size_t write_index(const std::string &path, std::vector<IndexedFile> &files, const MappedIndex *old,
+                          const struct timespec &built_at, size_t &trigram_count)
+{
+    std::vector<uint32_t> start((size_t(1) << 24) + 1, 0); // Trigram -> first slot in fresh
+    for (const auto &file : files)
+    {
+        for (uint32_t t : file.trigrams)
+            start[t + 1]++;
+    }
+    for (size_t t = 1; t < start.size(); ++t)
+        start[t] += start[t - 1];
+    std::vector<uint32_t> fresh(start.back());
+    {
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for (uint32_t id = 0; id < files.size(); ++id)
+        {
+            for (uint32_t t : files[id].trigrams)
+                fresh[fill[t]++] = id;
+            std::vector<uint32_t>().swap(files[id].trigrams);
+        }
+    }
+
+    std::vector<uint32_t> new_ids(old ? old->header->file_count : 0, UINT32_MAX);
+    for (uint32_t id = 0; id < files.size(); ++id)
+    {
+        if (files[id].old_id != UINT32_MAX)
+            new_ids[files[id].old_id] = id;
+    }
+
+    std::vector<IndexTrigram> table;
+    std::string postings;
+    std::vector<uint32_t> decoded, reused, merged;
+    uint32_t old_count = old ? old->header->trigram_count : 0;
+    uint32_t next_old = 0;
+    for (uint32_t t = 0; t < (uint32_t(1) << 24); ++t)
+    {
+        // Skip ahead to the next trigram present in either source.
+        bool in_old = next_old < old_count && old->trigrams[next_old].trigram == t;
+        if (!in_old && start[t] == start[t + 1])
+        {
+            uint32_t next = next_old < old_count ? old->trigrams[next_old].trigram : (uint32_t(1) << 24);
+            if (next <= t)
+            {
+                next_old++; // Out of order in a damaged index
+                continue;
+            }
+            auto it = std::upper_bound(start.begin() + t + 1, start.begin() + next + 1, start[t]);
+            t = uint32_t(it - start.begin()) - 2; // The loop increment lands on the next used trigram
+            continue;
+        }
+
+        reused.clear();
+        if (in_old)
+        {
+            decode_postings(*old, old->trigrams[next_old++], decoded);
+            for (uint32_t id : decoded)
+            {
+                if (new_ids[id] != UINT32_MAX)
+                    reused.push_back(new_ids[id]);
+            }
+        }
+        merged.clear();
+        std::merge(reused.begin(), reused.end(), fresh.begin() + start[t], fresh.begin() + start[t + 1],
+                   std::back_inserter(merged));
+        if (merged.empty())
+            continue;
+
+        table.push_back({t, uint32_t(merged.size()), postings.size()});
+        uint32_t last = 0;
+        for (uint32_t id : merged)
+        {
+            put_varint(postings, id - last);
+            last = id;
+        }
+    }
+
+    std::vector<uint32_t> always;
+    std::string names;
+    std::vector<IndexFileEntry> entries;
+    entries.reserve(files.size());
+    for (uint32_t id = 0; id < files.size(); ++id)
+    {
+        const IndexedFile &file = files[id];
+        if (file.flags & INDEX_UNINDEXED)
+            always.push_back(id);
+        entries.push_back({names.size(), uint32_t(file.path.size()), file.flags, file.mtime_sec, file.mtime_nsec,
+                           file.size});
+        names += file.path;
+    }
+
+    IndexHeader header = {};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.file_count = uint32_t(files.size());
+    header.trigram_count = uint32_t(table.size());
+    header.always_count = uint32_t(always.size());
+    header.built_sec = built_at.tv_sec;
+    header.built_nsec = built_at.tv_nsec;
+    header.files_offset = sizeof(IndexHeader);
+    header.trigrams_offset = header.files_offset + entries.size() * sizeof(IndexFileEntry);
+    header.always_offset = header.trigrams_offset + table.size() * sizeof(IndexTrigram);
+    header.names_offset = header.always_offset + always.size() * sizeof(uint32_t);
+    header.names_size = names.size();
+    header.postings_offset = header.names_offset + names.size();
+    header.postings_size = postings.size();
+
+    std::string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(IndexFileEntry));
+    out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(IndexTrigram));
+    out.write(reinterpret_cast<const char *>(always.data()), always.size() * sizeof(uint32_t));
+    out.write(names.data(), names.size());
+    out.write(postings.data(), postings.size());
+    out.close();
+    if (!out || rename(temp.c_str(), path.c_str()) != 0)
+    {
+        perror(temp.c_str());
+        unlink(temp.c_str());
+        return 0;
+    }
+    trigram_count = table.size();
+    return header.postings_offset + header.postings_size;
+}
+
+/**
+ * @brief Builds or refreshes the trigram index of a root.
+ *
+ * With `incremental`, files whose size and mtime match the previous index
+ * keep their trigrams from it and are not read; the rest are read again.
+ * Files modified within INDEX_RACY_NS of the previous build are always
+ * re-read, since a write in the same timestamp tick leaves the mtime as it
+ * was. Binary files are recorded but never match. The index covers the
+ * files a default sgown search walks, so hidden and ignored paths are left
+ * out.
+ *
+ * @param root        Root to index.
+ * @param incremental Reuse unchanged files from the existing index.
+ * @param jobs        Worker threads; 0 means one per CPU.
+ * @return true on success.
+ */
+bool build_search_index(const std::string &root, bool incremental, int jobs)
+{
+    auto started = std::chrono::steady_clock::now();
+    struct timespec built_at;
+    clock_gettime(CLOCK_REALTIME, &built_at);
+    std::string path = index_path(root);
+    std::string temp = path + ".tmp";
+
+    MappedIndex old;
+    std::unordered_map<std::string_view, uint32_t> old_ids;
+    if (incremental && open_index(path, old))
+    {
+        for (uint32_t id = 0; id < old.header->file_count; ++id)
+        {
+            std::string_view name = file_name(old, id);
+            if (!name.empty() && settled_at_build(*old.header, old.files[id]))
+                old_ids.emplace(name, id);
+        }
+    }
+    else if (incremental)
+    {
+        std::cout << "sgown: no index yet; building one\n";
+    }
+
+    jobs = resolve_jobs(jobs);
+    std::vector<std::vector<IndexedFile>> found(jobs);
+    walk_files_parallel(root, jobs, WalkPolicy{}, [&](int worker, std::string &file_path) {
+        if (file_path == path || file_path == temp)
+            return;
+        IndexedFile file;
+        if (!old_ids.empty())
+        {
+            struct stat st;
+            auto it = old_ids.find(file_path);
+            if (it != old_ids.end() && stat(file_path.c_str(), &st) == 0)
+            {
+                const IndexFileEntry &entry = old.files[it->second];
+                if (matches_entry(entry, st))
+                {
+                    file.path = std::move(file_path);
+                    file.mtime_sec = entry.mtime_sec;
+                    file.mtime_nsec = entry.mtime_nsec;
+                    file.size = entry.size;
+                    file.flags = entry.flags;
+                    file.old_id = it->second;
+                    found[worker].push_back(std::move(file));
+                    return;
+                }
+            }
+        }
+
+        FileContents contents;
+        if (!contents.load(file_path))
+            return;
+        file.mtime_sec = contents.status().st_mtim.tv_sec;
+        file.mtime_nsec = contents.status().st_mtim.tv_nsec;
+        file.size = contents.status().st_size;
+        if (contents.is_binary())
+            file.flags = INDEX_BINARY;
+        else if (!extract_trigrams(contents.data(), contents.size(), file.trigrams))
+            file.flags = INDEX_UNINDEXED;
+        if (contents.truncated())
+        {
+            file.trigrams.clear();
+            file.flags = INDEX_UNINDEXED; // Changed while indexed: always scan it
+        }
+        file.path = std::move(file_path);
+        found[worker].push_back(std::move(file));
+    });
+
+    std::vector<IndexedFile> files;
+    for (auto &part : found)
+        std::move(part.begin(), part.end(), std::back_inserter(files));
+    std::sort(files.begin(), files.end(), [](const IndexedFile &a, const IndexedFile &b) { return a.path < b.path; });
+
+    size_t reused = 0, binary = 0, unindexed = 0;
+    for (const auto &file : files)
+    {
+        reused += file.old_id != UINT32_MAX;
+        binary += (file.flags & INDEX_BINARY) != 0;
+        unindexed += (file.flags & INDEX_UNINDEXED) != 0;
+    }
+
+    size_t trigram_count = 0;
+    size_t bytes = write_index(path, files, old.header ? &old : nullptr, built_at, trigram_count);
+    if (!bytes)
+        return false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printf("sgown: indexed %zu files (%zu reused, %zu binary, %zu always scanned), %zu trigrams, %.1f MiB in %.2f s\n",
+           files.size(), reused, binary, unindexed, trigram_count, bytes / 1048576.0, seconds);
+    fflush(stdout);
+    return true;
+}
+
+/**
+ * @brief Deletes the index of a root.
+ */
+bool drop_search_index(const std::string &root)
+{
+    std::string path = index_path(root);
+    if (unlink(path.c_str()) != 0)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,14 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <string>
+#include <vector>
+
+#define SEARCH_INDEX_FILE ".jam_sgown_index" // Written in the searched root
+
+bool build_search_index(const std::string &root, bool incremental, int jobs);
+bool drop_search_index(const std::string &root);
+bool index_candidates(const std::string &root, const std::vector<std::string> &terms, int jobs,
+                      std::vector<std::string> &files);
+
+#endif // SEARCHINDEX_H
@@ -9,11 +9,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <string>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <readline/readline.h>
-#include <readline/history.h>
 #include <chrono>
 #include <ctime>
 #include <sstream>
@@ -24,18 +24,26 @@
 #include <vector>
 #include <fcntl.h>
 #include <signal.h>
+#include <clocale>
 #include <sstream>             
 
 #include "commands.h"
 #include "history.h"
 #include "scheduler.h"
-
-#define MAX_INPUT 1024
+#include "pathcache.h"
+#include "builtins.h"
+#include "shell.h"
+#include "pipeline.h"
+#include "jobs.h"
+#include "tokenizer.h"
+#include "fastpath.h"
+#include "wildcard.h"
+#include "timing.h"
 
 namespace fs = std::filesystem;
 using namespace std;
 
-/// Alias storage
+/// Alias storage (shared with the alias builtin)
 unordered_map<string, string> aliases;
 
 // -------------------- Task 1: Initialization --------------------
@@ -89,246 +97,154 @@ string interpret_error(int code)
 
 // -------------------- Task 3: File Search --------------------
 
-/**
- * @brief Searches a file for lines containing a given pattern.
- * @param filepath Path to the file.
- * @param pattern String to search for.
- * @return Vector of matched lines with line numbers and highlights.
- */
-vector<pair<int, string>> grep_in_file(const string &filepath, const string &pattern)
-{
-    ifstream file(filepath);
-    string line;
-    int lineno = 0;
-    vector<pair<int, string>> results;
+// sgown runs on a worker pool; see search.cpp.
 
-    while (getline(file, line))
-    {
-        lineno++;
-        size_t pos = line.find(pattern);
-        if (pos != string::npos)
-        {
-            string highlighted = line;
-            highlighted.insert(pos + pattern.length(), "\033[0m");
-            highlighted.insert(pos, "\033[31m");
-            results.emplace_back(lineno, highlighted);
-        }
-    }
-    return results;
-}
+// -------------------- Task 4: File Location --------------------
 
-/**
- * @brief Recursively searches a directory for pattern matches in files.
- * @param root Root directory.
- * @param term Search term.
- * @return Map of file paths to matched lines and highlights.
- */
-unordered_map<string, vector<pair<int, string>>> search_directory(const string &root, const string &term)
-{
-    unordered_map<string, vector<pair<int, string>>> findings;
-    for (const auto &entry : fs::recursive_directory_iterator(root))
-    {
-        if (entry.is_regular_file())
-        {
-            auto matches = grep_in_file(entry.path().string(), term);
-            if (!matches.empty())
-            {
-                findings[entry.path().string()] = matches;
-            }
-        }
-    }
-    return findings;
-}
+// locate and jupdatedb live in locate.cpp.
+
+// -------------------- Task 5: Redirection and Piping --------------------
 
 /**
- * @brief Displays search results with highlighting and line numbers.
- * @param data Map of file paths to matched line information.
+ * @brief Handles input/output redirection and pipes, then executes commands.
+ * @param tokens Command tokens (without a trailing "&").
+ * @param count Number of tokens.
+ * @param background Whether the command runs in the background.
+ * @return Exit status of the last pipeline stage.
  */
-void display_search_results(const unordered_map<string, vector<pair<int, string>>> &data)
+int handle_redirection_and_execute(const ShellToken *tokens, size_t count, bool background)
 {
-    for (const auto &[file, entries] : data)
-    {
-        cout << "\n\033[95m" << file << "\033[0m\n";
-        for (const auto &[line, text] : entries)
-        {
-            cout << "\033[34m" << line << "\033[0m: ..." << text << endl;
-        }
-    }
+    vector<PipelineStage> stages;
+    if (!parse_pipeline(tokens, count, stages))
+        return 2;
+    return run_pipeline(stages, background);
 }
 
-// -------------------- Task 4: File Location --------------------
+// -------------------- Task 6: Command Execution --------------------
+
+/// Exit status of the last command ($?)
+int shell_last_status = 0;
 
 /**
- * @brief Finds paths containing the search term in their names.
- * @param root Directory to search from.
- * @param term Search term.
- * @return Vector of matched file/directory paths.
+ * @brief Runs one command (a builtin, a fast path or a pipeline).
+ * @param tokens Tokens of the command, without separators.
+ * @param count Number of tokens.
+ * @param background Whether the command was followed by "&".
+ * @param globs Directory listings shared by the commands of the line.
+ * @return Exit status of the command.
  */
-vector<string> find_paths_containing(const string &root, const string &term)
+int run_command(const ShellToken *tokens, size_t count, bool background, GlobCache &globs)
 {
-    vector<string> found;
-    for (const auto &entry : fs::recursive_directory_iterator(root))
+    ExpandedCommand expanded;
+    for (size_t i = 0; i < count; ++i)
     {
-        string path_str = entry.path().string();
-        size_t pos = path_str.find(term);
-        if (pos != string::npos)
+        if (tokens[i].flags & TOKEN_GLOB)
         {
-            path_str.insert(pos + term.length(), "\033[0m");
-            path_str.insert(pos, "\033[31m");
-            found.push_back(path_str);
+            expand_wildcards(tokens, count, globs, expanded);
+            tokens = expanded.tokens.data();
+            count = expanded.tokens.size();
+            break;
         }
     }
-    return found;
-}
-
-/**
- * @brief Outputs the found paths.
- * @param paths Vector of colored, matched paths.
- */
-void show_found_paths(const vector<string> &paths)
-{
-    for (const auto &p : paths)
-    {
-        cout << p << endl;
-    }
-}
 
-// -------------------- Task 5: Redirection and Piping --------------------
+    // "jtime cmd | ..." times the whole pipeline, so it is a prefix rather
+    // than a builtin that would only see its own stage.
+    if (count > 1 && tokens[0].text == "jtime" && !(tokens[0].flags & TOKEN_QUOTED) && tokens[1].text != "-t")
+        return time_command(tokens + 1, count - 1, background, globs, true);
 
-/**
- * @brief Handles input/output redirection and pipes, then executes commands.
- * @param args Command arguments.
- * @param background Whether the command runs in the background.
- */
-void handle_redirection_and_execute(vector<char *> &args, bool background)
-{
-    int in_fd = 0, out_fd = 1;
-    vector<char *> command;
-    bool piping = false;
-    int pipefd[2];
+    bool simple = !background;
+    for (size_t i = 0; i < count && simple; ++i)
+        simple = !(tokens[i].flags & TOKEN_OPERATOR);
 
-    for (size_t i = 0; i < args.size(); ++i)
+    if (!(tokens[0].flags & TOKEN_OPERATOR))
     {
-        if (strcmp(args[i], "|") == 0)
-        {
-            piping = true;
-            args[i] = nullptr;
-            pipe(pipefd);
-            pid_t pid = fork();
-            if (pid == 0)
-            {
-                dup2(pipefd[1], STDOUT_FILENO);
-                close(pipefd[0]);
-                execvp(args[0], args.data());
-                perror("execvp");
-                exit(1);
-            }
-            else
-            {
-                wait(nullptr);
-                dup2(pipefd[0], STDIN_FILENO);
-                close(pipefd[1]);
-                vector<char *> rightCmd(args.begin() + i + 1, args.end());
-                rightCmd.push_back(nullptr);
-                execvp(rightCmd[0], rightCmd.data());
-                perror("execvp");
-                exit(1);
-            }
-            return;
-        }
-        else if (strcmp(args[i], ">") == 0)
+        // Builtins with redirections, in pipelines or in the background go
+        // through run_pipeline(), which sets up their streams.
+        const Builtin *builtin = find_builtin(tokens[0].text);
+        if (builtin && simple)
         {
-            out_fd = open(args[i + 1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
-            args[i] = nullptr;
-            break;
-        }
-        else if (strcmp(args[i], ">>") == 0)
-        {
-            out_fd = open(args[i + 1], O_WRONLY | O_CREAT | O_APPEND, 0644);
-            args[i] = nullptr;
-            break;
+            vector<char *> argv;
+            argv.reserve(count + 1);
+            for (size_t i = 0; i < count; ++i)
+                argv.push_back(const_cast<char *>(tokens[i].text.data()));
+            argv.push_back(nullptr);
+            return run_builtin(*builtin, static_cast<int>(count), argv.data());
         }
-        else if (strcmp(args[i], "<") == 0)
+        if (!builtin && !is_shell_command(tokens[0].text.data()) && !find_fast_path(tokens[0].text.data()))
         {
-            in_fd = open(args[i + 1], O_RDONLY);
-            args[i] = nullptr;
-            break;
+            std::cerr << "jam: command not found: " << tokens[0].text << "\n";
+            return 127;
         }
     }
-
-    pid_t pid = fork();
-    if (pid == 0)
-    {
-        if (in_fd != 0)
-            dup2(in_fd, STDIN_FILENO);
-        if (out_fd != 1)
-            dup2(out_fd, STDOUT_FILENO);
-        execvp(args[0], args.data());
-        perror("execvp");
-        exit(1);
-    }
-    else
-    {
-        if (!background)
-            wait(nullptr);
-    }
+    return handle_redirection_and_execute(tokens, count, background);
 }
 
-// -------------------- Task 6: Alias, History, Env --------------------
-
 /**
- * @brief Applies alias substitution to the input command.
- * @param input User input string to modify in-place.
+ * @brief Tokenizes and executes one command line.
+ *
+ * Commands separated by ";" run in order; a command followed by "&" runs
+ * in the background. The line buffer is modified in place.
+ *
+ * @param line   Mutable, NUL-terminated command line.
+ * @param parsed Token buffers, reused across calls by the caller.
+ * @return Exit status of the last command (also stored for $?).
  */
-void apply_aliases(char *input)
+int execute_line(char *line, TokenizedLine &parsed)
 {
-    string cmd(input);
-    stringstream ss(cmd);
-    string token;
-    ss >> token;
-    if (aliases.find(token) != aliases.end())
+    GlobCache globs;
+    for (char *cursor = line; cursor && !shell_exit_requested; cursor = parsed.rest)
     {
-        cmd.replace(0, token.length(), aliases[token]);
-        strncpy(input, cmd.c_str(), MAX_INPUT);
-    }
-}
+        if (!tokenize_line(cursor, parsed, shell_last_status))
+            return shell_last_status = 2;
+
+        // Separators from the line end the token list; an alias may add more.
+        const vector<ShellToken> &tokens = parsed.tokens;
+        size_t begin = 0;
+        for (size_t i = 0; i <= tokens.size() && !shell_exit_requested; ++i)
+        {
+            bool at_end = i == tokens.size();
+            bool separator = !at_end && (tokens[i].flags & TOKEN_OPERATOR) &&
+                             (tokens[i].text == ";" || tokens[i].text == "&");
+            if (!at_end && !separator)
+                continue;
 
-/**
- * @brief Expands environment variables in the input command.
- * @param input Input string with $VAR-style references.
- */
-void expand_env_variables(char *input)
-{
-    stringstream ss(input);
-    string token, result;
-    while (ss >> token)
-    {
-        if (token[0] == '$')
-        {
-            const char *val = getenv(token.substr(1).c_str());
-            result += val ? string(val) : "";
-        }
-        else
-        {
-            result += token;
+            if (i > begin)
+            {
+                bool background = separator && tokens[i].text == "&";
+                if (slow_command_reporting())
+                    shell_last_status = time_command(&tokens[begin], i - begin, background, globs, false);
+                else
+                    shell_last_status = run_command(&tokens[begin], i - begin, background, globs);
+                globs.generation++;
+            }
+            else if (separator)
+            {
+                std::cerr << "jam: syntax error near '" << tokens[i].text << "'\n";
+                return shell_last_status = 2;
+            }
+            begin = i + 1;
         }
-        result += " ";
     }
-    strcpy(input, result.c_str());
+    return shell_last_status;
 }
 
 // -------------------- Task 7: Shell Execution Loop --------------------
 
 /**
  * @brief Main shell REPL loop.
+ *
+ * Each line is tokenized in place in readline's buffer (quotes, escapes,
+ * aliases and $VAR are handled by tokenize_line()), so there is no limit on
+ * line length or argument count. The token buffers are reused from line
+ * to line.
  */
 void run_shell_loop()
 {
-    char input[MAX_INPUT];
+    TokenizedLine parsed;
 
     while (true)
     {
-        
+        notify_jobs(true);
         char *line = readline(("JAM [" + current_time() + "]> ").c_str());
         if (!line) {
             printf("\nSession terminated.\n");
@@ -338,165 +254,114 @@ void run_shell_loop()
             free(line);
             continue;
         }
-        add_history(line);
-        strncpy(input, line, MAX_INPUT);
+        add_to_history(line);
+        execute_line(line, parsed);
         free(line);
 
-        if (strncmp(input, "exit", 4) == 0)
+        if (shell_exit_requested)
             break;
+    }
+}
 
-        apply_aliases(input);
-        expand_env_variables(input);
-
-        // Tokenize input
-        char *tokens[64];
-        int token_count = 0;
-        char *token = strtok(input, " ");
-        while (token != NULL && token_count < 64)
-        {
-            tokens[token_count++] = token;
-            token = strtok(NULL, " ");
-        }
-        tokens[token_count] = NULL;
-
-        if (token_count == 0)
-            continue;
+/**
+ * @brief Runs commands from a file descriptor without readline, banner or prompt.
+ *
+ * Input is read in large blocks and split into lines in place, so scripted
+ * use costs one read(2) per block rather than readline's per-character
+ * processing. Pending output is flushed only before blocking on input.
+ * Commands that read stdin themselves may find that the reader has already
+ * consumed some of it.
+ *
+ * @param fd Descriptor to read commands from.
+ * @return Exit status of the last command.
+ */
+int run_batch(int fd)
+{
+    TokenizedLine parsed;
+    vector<char> buffer(1 << 16);
+    size_t pos = 0, len = 0; // Unprocessed input is buffer[pos, len)
+    bool eof = false;
 
-        if (strcmp(tokens[0], "sgown") == 0 && token_count > 1)
-        {
-            auto result = search_directory(".", tokens[1]);
-            display_search_results(result);
-        }
-        else if (strcmp(tokens[0], "help") == 0)
-        {
-            print_help_menu();
-        }
-        else if (strcmp(tokens[0], "locate") == 0 && token_count > 1)
-        {
-            auto results = find_paths_containing(".", tokens[1]);
-            show_found_paths(results);
-        }
-        else if (strcmp(tokens[0], "jcreate") == 0 && token_count > 1)
-        {
-            create_file(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "jsave") == 0 && token_count > 1)
-        {
-            save_file(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "jedit") == 0 && token_count > 1)
-        {
-            edit_file(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "jmodify") == 0 && token_count > 1)
-        {
-            modify_file(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "jexecute") == 0 && token_count > 1)
-        {
-            execute_jam_script(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "jrename") == 0 && token_count > 2)
-        {
-            rename_file(tokens[1], tokens[2]);
-        }
-        else if (strcmp(tokens[0], "cd") == 0 && token_count > 1)
-        {
-            change_directory(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "history") == 0)
-        {
-            print_history();
-        }
-        else if (strcmp(tokens[0], "jschedule") == 0)
-        {
-            if (token_count < 2)
-            {
-                std::cerr << "Usage: jschedule <filename> [priority]\n";
+    while (!shell_exit_requested)
+    {
+        char *start = buffer.data() + pos;
+        char *newline = static_cast<char *>(memchr(start, '\n', len - pos));
+        if (!newline && !eof)
+        {
+            memmove(buffer.data(), start, len - pos);
+            len -= pos;
+            pos = 0;
+            if (len + 1 >= buffer.size())
+                buffer.resize(buffer.size() * 2);
+
+            fflush(stdout);
+            ssize_t n = read(fd, buffer.data() + len, buffer.size() - len - 1);
+            if (n < 0 && errno == EINTR)
                 continue;
-            }
-            std::string filename = tokens[1];
-            int priority = (token_count > 2) ? atoi(tokens[2]) : 2;
-            jschedule_command(filename, priority);
-        }
-        else if (strcmp(tokens[0], "jschedulexecute") == 0)
-        {
-            jschedulexecute_command();
-        }
-        else if (strcmp(tokens[0], "alias") == 0 && token_count > 1)
-        {
-            std::string def_str = tokens[1];
-            for (int i = 2; i < token_count; ++i)
-            {
-                def_str += " ";
-                def_str += tokens[i];
-            }
-            auto eq = def_str.find('=');
-            if (eq != std::string::npos)
+            if (n < 0)
             {
-                std::string key = def_str.substr(0, eq);
-                std::string val = def_str.substr(eq + 1);
-                aliases[key] = val;
-                std::cout << "Alias set: " << key << " -> " << val << std::endl;
+                perror("read");
+                break;
             }
+            eof = n == 0;
+            len += n;
+            continue;
         }
-        else if (strcmp(tokens[0], "jscheduleview") == 0)
-        {
-            print_scheduled_tasks();
-        }
-        else if (strcmp(tokens[0], "jschedulesave") == 0 && token_count > 1)
-        {
-            save_queues_to_file(tokens[1]);
-        }
-        else if (strcmp(tokens[0], "jschedulecancel") == 0 && token_count > 1)
-        {
-            int id = atoi(tokens[1]);
-            cancel_task(id);
-        }
-        else if (strcmp(tokens[0], "jschedulemodify") == 0 && token_count > 2)
-        {
-            int id = atoi(tokens[1]);
-            std::string new_cmd = tokens[2];
-            for (int i = 3; i < token_count; ++i)
-            {
-                new_cmd += " ";
-                new_cmd += tokens[i];
-            }
-            modify_task(id, new_cmd);
-        }
-        else if (is_shell_command(input))
-        {
-            execute_shell_command(input);
-        }
-        else if (strcmp(tokens[0], "jambo") == 0)
+        if (!newline)
         {
-            handle_jambo_command(token_count, tokens);
+            if (pos == len)
+                break;
+            newline = buffer.data() + len; // Last line without a newline
         }
-        else
-        {
-            std::vector<char *> args;
-            for (int i = 0; i < token_count; ++i)
-            {
-                args.push_back(tokens[i]);
-            }
 
-            bool background = false;
-            if (!args.empty() && strcmp(args.back(), "&") == 0)
-            {
-                args.pop_back();
-                background = true;
-            }
+        *newline = '\0';
+        if (newline > start && newline[-1] == '\r')
+            newline[-1] = '\0';
+        pos = newline - buffer.data() + (newline < buffer.data() + len ? 1 : 0);
+        execute_line(start, parsed);
+        notify_jobs(false);
+    }
+    fflush(stdout);
+    return shell_last_status;
+}
 
-            args.push_back(nullptr);
-            handle_redirection_and_execute(args, background);
-        }
+/**
+ * @brief Runs the commands given with `jam -c`, one line at a time.
+ * @param commands Command text; may hold several lines.
+ * @return Exit status of the last command.
+ */
+int run_command_string(const char *commands)
+{
+    TokenizedLine parsed;
+    string text = commands;
+    char *line = text.data();
+    while (line && !shell_exit_requested)
+    {
+        char *newline = strchr(line, '\n');
+        if (newline)
+            *newline = '\0';
+        execute_line(line, parsed);
+        line = newline ? newline + 1 : nullptr;
     }
+    fflush(stdout);
+    return shell_last_status;
 }
 
 // -------------------- Task 8: Main Entry --------------------
 
 /**
  * @brief Main function for JAM Shell.
+ *
+ * Usage:
+ *   jam                 Interactive REPL (raw batch mode if stdin is not a terminal)
+ *   jam -c "<cmds>"     Run the given commands and exit
+ *   jam <file>          Run a command script and exit
+ *   jam -s              Read commands from stdin in batch mode
+ *   jam --builtins      Print the builtin registry for the GUI
+ *
+ * Batch modes skip readline, the banner, the prompt and history, and exit
+ * with the status of the last command.
+ *
  * @param argc Argument count.
  * @param argv Argument vector.
  * @return Exit code.
@@ -504,10 +369,48 @@ void run_shell_loop()
 
 int main(int argc, char *argv[])
 {
+    // Wildcard matches and ls output are sorted like the user's other tools.
+    setlocale(LC_COLLATE, "");
+
+    if (argc > 1 && strcmp(argv[1], "--builtins") == 0)
+    {
+        print_builtin_list();
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        if (argc < 3)
+        {
+            cerr << "jam: -c: option requires an argument\n";
+            return 2;
+        }
+        init_job_control(false);
+        return run_command_string(argv[2]);
+    }
+    if (argc > 1 && strcmp(argv[1], "-s") != 0)
+    {
+        int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            perror(argv[1]);
+            return 127;
+        }
+        init_job_control(false);
+        int status = run_batch(fd);
+        close(fd);
+        return status;
+    }
+    if (argc > 1 || !isatty(STDIN_FILENO))
+    {
+        init_job_control(false);
+        return run_batch(STDIN_FILENO);
+    }
+
+    init_job_control(true);
     show_banner();
     load_history();
     run_shell_loop();
     save_history();
-    return 0;
+    return shell_last_status;
 }
-
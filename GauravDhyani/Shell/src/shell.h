@@ -0,0 +1,19 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include "tokenizer.h"
+#include "wildcard.h"
+
+extern std::unordered_map<std::string, std::string> aliases;
+
+int handle_redirection_and_execute(const ShellToken *tokens, size_t count, bool background);
+int run_command(const ShellToken *tokens, size_t count, bool background, GlobCache &globs);
+int execute_line(char *line, TokenizedLine &parsed);
+
+extern int shell_last_status;
+
+#endif // SHELL_H
@@ -0,0 +1,185 @@
+#include "timing.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "jobs.h"
+#include "shell.h"
+
+// -------------------------
+// Threshold Mode
+// -------------------------
+
+// Commands slower than this are reported after they finish; < 0 is off.
+static double slow_threshold_ms = -1;
+
+/**
+ * @brief Whether every command is being timed for the threshold report.
+ */
+bool slow_command_reporting()
+{
+    return slow_threshold_ms >= 0;
+}
+
+// -------------------------
+// Measurement
+// -------------------------
+
+static double seconds(const struct timeval &tv)
+{
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * @brief Subtracts the counters of `before` from `after` in place.
+ */
+static void subtract_usage(struct rusage &after, const struct rusage &before)
+{
+    timersub(&after.ru_utime, &before.ru_utime, &after.ru_utime);
+    timersub(&after.ru_stime, &before.ru_stime, &after.ru_stime);
+    after.ru_minflt -= before.ru_minflt;
+    after.ru_majflt -= before.ru_majflt;
+    after.ru_nvcsw -= before.ru_nvcsw;
+    after.ru_nivcsw -= before.ru_nivcsw;
+}
+
+/**
+ * @brief Starts measuring a command.
+ */
+CostMeter start_measurement()
+{
+    CostMeter meter;
+    getrusage(RUSAGE_SELF, &meter.self);
+    meter.children = waited_child_usage(true);
+    meter.start = std::chrono::steady_clock::now();
+    return meter;
+}
+
+/**
+ * @brief Finishes a measurement started with start_measurement().
+ *
+ * The cost is the shell's own usage across the command (getrusage
+ * RUSAGE_SELF, for builtins and in-process commands) plus that of every
+ * process it waited for, collected per process with wait4() by the job
+ * table. CPU times, context switches and page faults are summed; max RSS
+ * is that of the largest process; the shell's own peak counts when the
+ * command started no processes or the peak grew during it.
+ */
+CommandCost finish_measurement(const CostMeter &meter)
+{
+    CommandCost cost;
+    cost.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meter.start).count();
+    struct rusage children = waited_child_usage(false);
+    struct rusage self;
+    getrusage(RUSAGE_SELF, &self);
+    subtract_usage(children, meter.children);
+
+    bool ran_in_shell = children.ru_maxrss == 0 || self.ru_maxrss > meter.self.ru_maxrss;
+    long self_peak = ran_in_shell ? self.ru_maxrss : 0;
+    subtract_usage(self, meter.self);
+    cost.user_s = seconds(self.ru_utime) + seconds(children.ru_utime);
+    cost.sys_s = seconds(self.ru_stime) + seconds(children.ru_stime);
+    cost.max_rss_mib = std::max(self_peak, children.ru_maxrss) / 1024.0;
+    cost.voluntary_switches = self.ru_nvcsw + children.ru_nvcsw;
+    cost.involuntary_switches = self.ru_nivcsw + children.ru_nivcsw;
+    cost.minor_faults = self.ru_minflt + children.ru_minflt;
+    cost.major_faults = self.ru_majflt + children.ru_majflt;
+    return cost;
+}
+
+/**
+ * @brief Runs one command and reports what it cost.
+ *
+ * @param tokens     Command tokens, without the "jtime" prefix.
+ * @param count      Number of tokens.
+ * @param background Whether the command was followed by "&" (then only
+ *                   the launch is measured).
+ * @param globs      Directory listings of the current line.
+ * @param always     Report even when under the slow-command threshold.
+ * @return Exit status of the command.
+ */
+int time_command(const ShellToken *tokens, size_t count, bool background, GlobCache &globs, bool always)
+{
+    CostMeter meter = start_measurement();
+    int status = run_command(tokens, count, background, globs);
+    CommandCost cost = finish_measurement(meter);
+
+    if (!always && (cost.wall_ms < slow_threshold_ms || tokens[0].text == "jtime"))
+        return status;
+
+    if (!always)
+    {
+        std::string command;
+        for (size_t i = 0; i < count; ++i)
+            command += (i ? " " : "") + std::string(tokens[i].text);
+        fprintf(stderr, "jtime: %.3f s real, %.3f s user, %.3f s sys, %.1f MiB max RSS: %s\n",
+                cost.wall_ms / 1000, cost.user_s, cost.sys_s, cost.max_rss_mib, command.c_str());
+        return status;
+    }
+
+    fprintf(stderr, "real      %.3f s\n", cost.wall_ms / 1000);
+    fprintf(stderr, "user      %.3f s\n", cost.user_s);
+    fprintf(stderr, "sys       %.3f s\n", cost.sys_s);
+    fprintf(stderr, "max rss   %.1f MiB\n", cost.max_rss_mib);
+    fprintf(stderr, "ctx sw    %ld voluntary, %ld involuntary\n", cost.voluntary_switches, cost.involuntary_switches);
+    fprintf(stderr, "faults    %ld minor, %ld major\n", cost.minor_faults, cost.major_faults);
+    return status;
+}
+
+// -------------------------
+// jtime Builtin
+// -------------------------
+
+/**
+ * @brief Handles `jtime -t <ms>|off`, `jtime` and `jtime <cmd...>`.
+ *
+ * A command line that starts with jtime is timed by the shell before it
+ * gets here (see run_command()), so pipes and redirections are part of
+ * the measurement. This handler sees a command only when jtime is itself
+ * a stage of a pipeline or runs in the background.
+ */
+int handle_jtime_command(int token_count, char *tokens[])
+{
+    if (token_count == 1)
+    {
+        if (slow_command_reporting())
+            printf("Reporting commands slower than %g ms\n", slow_threshold_ms);
+        else
+            printf("Slow-command reporting is off\n");
+        return 0;
+    }
+
+    if (strcmp(tokens[1], "-t") == 0)
+    {
+        if (token_count != 3)
+        {
+            std::cerr << "Usage: jtime -t <ms>|off\n";
+            return 2;
+        }
+        if (strcmp(tokens[2], "off") == 0)
+        {
+            slow_threshold_ms = -1;
+            return 0;
+        }
+        char *end;
+        double ms = strtod(tokens[2], &end);
+        if (*end != '\0' || ms < 0)
+        {
+            std::cerr << "jtime: invalid threshold: " << tokens[2] << "\n";
+            return 2;
+        }
+        slow_threshold_ms = ms;
+        return 0;
+    }
+
+    std::vector<ShellToken> command;
+    for (int i = 1; i < token_count; ++i)
+        command.push_back({tokens[i], 0});
+    GlobCache globs;
+    return time_command(command.data(), command.size(), false, globs, true);
+}
@@ -0,0 +1,35 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <cstddef>
+#include <chrono>
+#include <sys/resource.h>
+#include "tokenizer.h"
+#include "wildcard.h"
+
+// Resources used by one command.
+struct CommandCost {
+    double wall_ms = 0;
+    double user_s = 0;
+    double sys_s = 0;
+    double max_rss_mib = 0;
+    long voluntary_switches = 0;
+    long involuntary_switches = 0;
+    long minor_faults = 0;
+    long major_faults = 0;
+};
+
+// Starting point of a measurement.
+struct CostMeter {
+    struct rusage self;
+    struct rusage children;
+    std::chrono::steady_clock::time_point start;
+};
+
+CostMeter start_measurement();
+CommandCost finish_measurement(const CostMeter &meter);
+int time_command(const ShellToken *tokens, size_t count, bool background, GlobCache &globs, bool always);
+bool slow_command_reporting();
+int handle_jtime_command(int token_count, char *tokens[]);
+
+#endif // TIMING_H
@@ -0,0 +1,372 @@
+#include "tokenizer.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <unistd.h>
+#include "shell.h"
+
+#define TOKEN_MAX_ALIAS_DEPTH 16
+#define TOKEN_GLOB_CHARS "*?[]{},\\" // Escaped in a glob pattern when quoted
+
+// -------------------------
+// Scanner State
+// -------------------------
+
+struct ScanState {
+    TokenizedLine &out;
+    int last_status;
+    bool command_position = true;              // Next word may be an alias
+    std::vector<std::string_view> alias_stack; // Aliases being expanded (no self-recursion)
+};
+
+// The word currently being assembled, either in place in the line buffer
+// or, once an expansion no longer fits there, at the end of the arena.
+struct WordState {
+    bool active = false;
+    bool in_arena = false;
+    bool has_var = false;
+    size_t start = 0;   // Offset of the word in the line buffer or the arena
+    unsigned flags = 0;
+    std::vector<size_t> quoted; // Offsets in the word of quoted characters special to globbing
+};
+
+/**
+ * @brief Splits one source string into tokens, expanding as it goes.
+ *
+ * Words are unquoted in place: removing quotes and escapes only ever
+ * shrinks a word, so the write position never passes the read position and
+ * the NUL terminator can replace the separator that ended the word. A $VAR
+ * value is also copied in place when it is no longer than the text it
+ * replaces; otherwise the word moves to the arena. Alias values are scanned
+ * recursively with every word going to the arena.
+ *
+ * @param st    Shared scanner state.
+ * @param src   Text to scan.
+ * @param n     Length of src.
+ * @param buf   Writable alias of src for in-place words, or nullptr.
+ * @param depth Alias nesting depth.
+ * @return false (after printing an error) on unterminated quotes.
+ */
+static bool scan(ScanState &st, const char *src, size_t n, char *buf, int depth)
+{
+    TokenizedLine &out = st.out;
+    WordState word;
+    size_t w = 0; // In-place write position (never past the read position)
+    char quote = 0;
+
+    auto begin = [&]() {
+        if (word.active)
+            return;
+        word = WordState();
+        word.active = true;
+        word.in_arena = buf == nullptr;
+        word.start = word.in_arena ? out.arena.size() : w;
+        if (depth > 0)
+            word.flags |= TOKEN_EXPANDED;
+    };
+    auto put = [&](char c) {
+        begin();
+        if (word.in_arena)
+            out.arena.push_back(c);
+        else
+            buf[w++] = c;
+    };
+    auto length = [&]() { return (word.in_arena ? out.arena.size() : w) - word.start; };
+    // Records the last `len` characters of the word as quoted, so a
+    // wildcard among them is matched literally.
+    auto mark_quoted = [&](size_t len) {
+        const char *end = word.in_arena ? out.arena.data() + out.arena.size() : buf + w;
+        for (size_t i = len; i > 0; --i)
+        {
+            if (end[-i] && strchr(TOKEN_GLOB_CHARS, end[-i]))
+                word.quoted.push_back(length() - i);
+        }
+    };
+    auto put_quoted = [&](char c) {
+        put(c);
+        mark_quoted(1);
+    };
+    auto append = [&](const char *value, size_t len, size_t read_pos) {
+        begin();
+        if (!word.in_arena && w + len <= read_pos)
+        {
+            memcpy(buf + w, value, len);
+            w += len;
+            return;
+        }
+        if (!word.in_arena)
+        {
+            size_t offset = out.arena.size();
+            out.arena.append(buf + word.start, w - word.start);
+            w = word.start;
+            word.start = offset;
+            word.in_arena = true;
+        }
+        out.arena.append(value, len);
+    };
+
+    auto finish = [&]() -> bool {
+        if (!word.active)
+            return true;
+        word.active = false;
+
+        size_t len;
+        if (word.in_arena)
+        {
+            len = out.arena.size() - word.start;
+            out.arena.push_back('\0');
+        }
+        else
+        {
+            len = w - word.start;
+            buf[w++] = '\0';
+        }
+        const char *text = word.in_arena ? out.arena.data() + word.start : buf + word.start;
+
+        // An unquoted expansion of an unset variable leaves no word behind.
+        if (len == 0 && !(word.flags & TOKEN_QUOTED))
+        {
+            if (word.in_arena)
+                out.arena.resize(word.start);
+            return true;
+        }
+
+        if (st.command_position && !(word.flags & TOKEN_QUOTED) && !word.has_var &&
+            !aliases.empty() && depth < TOKEN_MAX_ALIAS_DEPTH)
+        {
+            auto it = aliases.find(std::string(text, len));
+            bool expanding = false;
+            for (auto name : st.alias_stack)
+                expanding |= it != aliases.end() && name == it->first;
+            if (it != aliases.end() && !expanding)
+            {
+                if (word.in_arena)
+                    out.arena.resize(word.start);
+                st.alias_stack.push_back(it->first);
+                bool ok = scan(st, it->second.data(), it->second.size(), nullptr, depth + 1);
+                st.alias_stack.pop_back();
+                return ok;
+            }
+        }
+
+        st.command_position = false;
+        if ((word.flags & TOKEN_GLOB) && !word.quoted.empty())
+        {
+            out.pattern_spans.emplace_back(out.tokens.size(), out.patterns.size());
+            size_t q = 0;
+            for (size_t i = 0; i < len; ++i)
+            {
+                if (q < word.quoted.size() && word.quoted[q] == i)
+                {
+                    out.patterns.push_back('\\');
+                    q++;
+                }
+                out.patterns.push_back(text[i]);
+            }
+            out.patterns.push_back('\0');
+        }
+        if (word.in_arena)
+        {
+            // The arena may still grow; the view is set once the line is done.
+            out.arena_spans.emplace_back(out.tokens.size(), word.start);
+            out.tokens.push_back({std::string_view(), word.flags});
+        }
+        else
+        {
+            out.tokens.push_back({std::string_view(text, len), word.flags});
+        }
+        return true;
+    };
+
+    auto expand = [&](size_t r) -> size_t {
+        size_t p = r + 1;
+        std::string name, number;
+        size_t end;
+        if (p < n && src[p] == '{')
+        {
+            const char *close = static_cast<const char *>(memchr(src + p, '}', n - p));
+            if (!close)
+            {
+                put('$');
+                return r;
+            }
+            end = close - src + 1;
+            name.assign(src + p + 1, close);
+        }
+        else if (p < n && (src[p] == '?' || src[p] == '$'))
+        {
+            end = p + 1;
+            number = std::to_string(src[p] == '?' ? st.last_status : static_cast<int>(getpid()));
+        }
+        else if (p < n && (isalpha(static_cast<unsigned char>(src[p])) || src[p] == '_'))
+        {
+            end = p;
+            while (end < n && (isalnum(static_cast<unsigned char>(src[end])) || src[end] == '_'))
+                end++;
+            name.assign(src + p, end - p);
+        }
+        else
+        {
+            put('$');
+            return r;
+        }
+
+        begin();
+        word.has_var = true;
+        word.flags |= TOKEN_EXPANDED;
+        const char *value = number.empty() ? getenv(name.c_str()) : number.c_str();
+        if (value)
+        {
+            append(value, strlen(value), end);
+            if (quote)
+                mark_quoted(strlen(value));
+        }
+        return end - 1;
+    };
+
+    for (size_t r = 0; r < n; ++r)
+    {
+        char c = src[r];
+        if (quote == '\'')
+        {
+            if (c == '\'')
+                quote = 0;
+            else
+                put_quoted(c);
+            continue;
+        }
+        if (quote == '"')
+        {
+            if (c == '"')
+                quote = 0;
+            else if (c == '\\' && r + 1 < n && strchr("\\\"$`", src[r + 1]))
+                put_quoted(src[++r]);
+            else if (c == '$')
+                r = expand(r);
+            else
+                put_quoted(c);
+            continue;
+        }
+
+        switch (c)
+        {
+        case ' ':
+        case '\t':
+        case '\n':
+            if (!finish())
+                return false;
+            break;
+        case '\'':
+        case '"':
+            begin();
+            word.flags |= TOKEN_QUOTED;
+            quote = c;
+            break;
+        case '\\':
+            if (r + 1 < n)
+            {
+                begin();
+                word.flags |= TOKEN_QUOTED;
+                put_quoted(src[++r]);
+            }
+            break;
+        case '$':
+            r = expand(r);
+            break;
+        case '#':
+            if (word.active)
+                put(c);
+            else
+                r = n; // Comment to end of line
+            break;
+        case '|':
+        case '&':
+        case ';':
+        case '<':
+        case '>':
+        {
+            if (!finish())
+                return false;
+            const char *op = c == '|' ? "|" : c == '&' ? "&" : c == ';' ? ";" : c == '<' ? "<" : ">";
+            if (c == '>' && r + 1 < n && src[r + 1] == '>')
+            {
+                op = ">>";
+                r++;
+            }
+            out.tokens.push_back({op, TOKEN_OPERATOR});
+            st.command_position = c == '|' || c == '&' || c == ';';
+            if ((c == '&' || c == ';') && depth == 0)
+            {
+                // Stop so the command runs before the rest is expanded ($? etc.).
+                out.rest = buf + r + 1;
+                return true;
+            }
+            break;
+        }
+        case '*':
+        case '?':
+        case '[':
+        case '{':
+            begin();
+            word.flags |= TOKEN_GLOB;
+            put(c);
+            break;
+        default:
+            put(c);
+        }
+    }
+
+    if (quote)
+    {
+        std::cerr << "jam: syntax error: unterminated " << (quote == '"' ? "double" : "single") << " quote\n";
+        return false;
+    }
+    return finish();
+}
+
+// -------------------------
+// Public Interface
+// -------------------------
+
+/**
+ * @brief Tokenizes a command line in a single pass.
+ *
+ * Handles single and double quotes, backslash escapes, `#` comments, the
+ * operators | & ; < > >> (with or without surrounding spaces), $NAME,
+ * ${NAME}, $? and $$ expansion, and alias substitution for words in
+ * command position. Expansions are not re-split into words. There is no
+ * limit on line length or token count.
+ *
+ * Tokenizing stops after the first ";" or "&" so that the command before
+ * it can run before the rest of the line is expanded; `out.rest` then
+ * points at the remainder, which the caller passes back in.
+ *
+ * The line is rewritten in place, and tokens point into it (or into
+ * `out.arena` for words that grew through expansion), so both must
+ * outlive the tokens.
+ *
+ * @param line        Mutable, NUL-terminated command line (or a `rest`).
+ * @param out         Receives the tokens; reuse it across lines.
+ * @param last_status Value substituted for $?.
+ * @return true on success; false (tokens cleared) on a syntax error.
+ */
+bool tokenize_line(char *line, TokenizedLine &out, int last_status)
+{
+    out.tokens.clear();
+    out.arena.clear();
+    out.arena_spans.clear();
+    out.patterns.clear();
+    out.pattern_spans.clear();
+    out.rest = nullptr;
+
+    ScanState st{out, last_status, true, {}};
+    bool ok = scan(st, line, strlen(line), line, 0);
+    for (const auto &[index, offset] : out.arena_spans)
+        out.tokens[index].text = std::string_view(out.arena.data() + offset);
+    for (const auto &[index, offset] : out.pattern_spans)
+        out.tokens[index].pattern = std::string_view(out.patterns.data() + offset);
+    if (!ok)
+        out.tokens.clear();
+    return ok;
+}
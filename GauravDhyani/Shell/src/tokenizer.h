@@ -0,0 +1,40 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Per-token flags recorded while tokenizing.
+enum ShellTokenFlags : unsigned {
+    TOKEN_QUOTED = 1u << 0,   // Some part was quoted or escaped
+    TOKEN_GLOB = 1u << 1,     // Has an unquoted *, ?, [ or {
+    TOKEN_OPERATOR = 1u << 2, // Unquoted |, &, ;, <, > or >>
+    TOKEN_EXPANDED = 1u << 3, // Contains a $VAR expansion or came from an alias
+};
+
+// One shell word. `text.data()` is always NUL-terminated, so it can be
+// passed straight to exec or to builtins as a C string.
+struct ShellToken {
+    std::string_view text;
+    unsigned flags;
+    std::string_view pattern = {}; // For a TOKEN_GLOB word with quoted parts: the word with those
+                                   // parts' wildcard characters backslash-escaped, as for expand_glob()
+};
+
+// Tokens of one command line plus the storage they point into. Reusing the
+// same object across lines keeps its capacity, so a line that needs no
+// expansion is tokenized without allocating.
+struct TokenizedLine {
+    std::vector<ShellToken> tokens;
+    std::string arena;                               // Words rewritten by expansion
+    std::vector<std::pair<size_t, size_t>> arena_spans; // (token, arena offset) fixed up after the pass
+    std::string patterns;                            // Escaped glob patterns of partly quoted words
+    std::vector<std::pair<size_t, size_t>> pattern_spans; // (token, patterns offset)
+    char *rest = nullptr;                            // Unscanned text after ";" or "&", if any
+};
+
+bool tokenize_line(char *line, TokenizedLine &out, int last_status = 0);
+
+#endif // TOKENIZER_H
@@ -0,0 +1,501 @@
+#include "walk.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "wildcard.h"
+
+#define WALK_IGNORE_MAX_BYTES (1 << 20) // Larger ignore files are read only this far
+
+// -------------------------
+// Ignore Rules
+// -------------------------
+
+// One line of an ignore file, classified so that the common forms ("build",
+// "*.o") are a string compare rather than a glob match.
+struct IgnorePattern {
+    enum Kind : uint8_t {
+        Name,     // No wildcards, no '/': the entry's name equals text
+        Suffix,   // "*" followed by a plain suffix
+        NameGlob, // Wildcards but no '/': text is matched against the name
+        PathGlob, // Contains '/': parts are matched against the path below the rules' directory
+    } kind = Name;
+    std::string text;
+    std::vector<std::string> parts;
+    bool negate = false;   // Leading '!': re-includes what an earlier pattern excluded
+    bool dir_only = false; // Trailing '/': matches directories only
+};
+
+struct IgnoreRules {
+    IgnoreChain parent;
+    size_t prefix = 0; // Bytes of a walk path in front of the part below the walk's root
+    std::string lead;  // Path from this directory down to the walk's root, for rules above it
+    std::vector<IgnorePattern> patterns;
+};
+
+static const char *const ignore_file_names[] = {".gitignore", ".jamignore"};
+
+/**
+ * @brief Returns how many bytes of a walk path name the directory dir.
+ */
+static size_t prefix_length(const std::string &dir)
+{
+    return dir.empty() || dir.back() == '/' ? dir.size() : dir.size() + 1;
+}
+
+/**
+ * @brief Joins a directory and an entry name with one '/'.
+ */
+std::string join_path(const std::string &dir, const std::string &name)
+{
+    if (dir.empty())
+        return name;
+    return dir.back() == '/' ? dir + name : dir + "/" + name;
+}
+
+/**
+ * @brief Parses one line of a .gitignore file.
+ *
+ * Follows gitignore(5): blank lines and '#' comments are skipped, '!'
+ * negates, a trailing '/' restricts the pattern to directories, and a
+ * pattern with a '/' anywhere else is anchored to the file's directory
+ * (where "**" matches any number of directories); without one it matches
+ * the name at any depth.
+ *
+ * @return false if the line holds no pattern.
+ */
+static bool parse_ignore_line(std::string line, IgnorePattern &pattern)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+    while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\'))
+        line.pop_back();
+    if (line.empty() || line[0] == '#')
+        return false;
+    if (line[0] == '!')
+    {
+        pattern.negate = true;
+        line.erase(0, 1);
+    }
+    else if (line[0] == '\\' && (line[1] == '!' || line[1] == '#'))
+        line.erase(0, 1);
+    while (!line.empty() && line.back() == '/')
+    {
+        pattern.dir_only = true;
+        line.pop_back();
+    }
+    if (line.empty())
+        return false;
+
+    if (line.find('/') != std::string::npos)
+    {
+        pattern.kind = IgnorePattern::PathGlob;
+        size_t start = 0;
+        while (start <= line.size())
+        {
+            size_t slash = line.find('/', start);
+            if (slash == std::string::npos)
+                slash = line.size();
+            if (slash > start)
+                pattern.parts.push_back(line.substr(start, slash - start));
+            start = slash + 1;
+        }
+        return !pattern.parts.empty();
+    }
+
+    size_t wild = line.find_first_of("*?[\\");
+    if (wild == std::string::npos)
+        pattern.kind = IgnorePattern::Name;
+    else if (line.find_first_of("*?[", 0) == std::string::npos)
+    {
+        // Only backslash escapes: the name with them removed.
+        pattern.kind = IgnorePattern::Name;
+        std::string plain;
+        for (size_t i = 0; i < line.size(); ++i)
+            if (line[i] != '\\' || ++i < line.size())
+                plain.push_back(line[i]);
+        line = plain;
+    }
+    else if (line[0] == '*' && line.find_first_of("*?[\\", 1) == std::string::npos)
+    {
+        pattern.kind = IgnorePattern::Suffix;
+        line.erase(0, 1);
+    }
+    else
+        pattern.kind = IgnorePattern::NameGlob;
+    pattern.text = std::move(line);
+    return true;
+}
+
+/**
+ * @brief Matches path components against pattern parts, "**" matching any number of them.
+ */
+static bool match_parts(const std::string *pat, size_t pat_count, const char *const *parts, size_t count)
+{
+    for (; pat_count > 0; ++pat, --pat_count, ++parts, --count)
+    {
+        if (*pat == "**")
+        {
+            if (pat_count == 1)
+                return count > 0; // "dir/**" matches what is inside dir, not dir itself
+            for (size_t skip = 0; skip <= count; ++skip)
+            {
+                if (match_parts(pat + 1, pat_count - 1, parts + skip, count - skip))
+                    return true;
+            }
+            return false;
+        }
+        if (count == 0 || !wildcard_match(pat->c_str(), *parts))
+            return false;
+    }
+    return count == 0;
+}
+
+/**
+ * @brief Reads the ignore files of an open directory and chains their patterns to parent.
+ *
+ * A directory without ignore files shares its parent's chain, so the
+ * chain only grows where there are rules and each file is parsed once
+ * per walk.
+ *
+ * @param dirfd  The directory.
+ * @param prefix Bytes of a walk path in front of the part below it, or
+ *               below the walk's root for a directory above the root.
+ * @param lead   For a directory above the walk's root, the path from it to the root plus '/'.
+ * @param parent Rules of the directories above.
+ * @param stamp  If not null, receives what the ignore files looked like.
+ */
+static IgnoreChain load_rules_at(int dirfd, size_t prefix, const std::string &lead, const IgnoreChain &parent,
+                                 IgnoreStamp *stamp)
+{
+    std::vector<IgnorePattern> patterns;
+    uint64_t hash = 1469598103934665603ULL;
+    bool any = false;
+    struct timespec newest = {};
+    for (const char *file_name : ignore_file_names)
+    {
+        int fd = openat(dirfd, file_name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            close(fd);
+            continue;
+        }
+        std::string text(std::min<off_t>(st.st_size, WALK_IGNORE_MAX_BYTES), '\0');
+        ssize_t got = read(fd, text.data(), text.size());
+        close(fd);
+        text.resize(got > 0 ? got : 0);
+
+        any = true;
+        const int64_t fields[] = {int64_t(st.st_ino), int64_t(st.st_size), st.st_mtim.tv_sec, st.st_mtim.tv_nsec};
+        for (int64_t field : fields)
+        {
+            hash ^= uint64_t(field);
+            hash *= 1099511628211ULL;
+        }
+        if (st.st_mtim.tv_sec > newest.tv_sec ||
+            (st.st_mtim.tv_sec == newest.tv_sec && st.st_mtim.tv_nsec > newest.tv_nsec))
+            newest = st.st_mtim;
+
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos)
+                end = text.size();
+            IgnorePattern pattern;
+            if (parse_ignore_line(text.substr(start, end - start), pattern))
+                patterns.push_back(std::move(pattern));
+            start = end + 1;
+        }
+    }
+    if (stamp)
+    {
+        stamp->hash = any ? hash : 0;
+        stamp->newest = newest;
+    }
+    if (patterns.empty())
+        return parent;
+    auto rules = std::make_shared<IgnoreRules>();
+    rules->parent = parent;
+    rules->prefix = prefix;
+    rules->lead = lead;
+    rules->patterns = std::move(patterns);
+    return rules;
+}
+
+/**
+ * @brief Loads a directory's ignore files on top of the rules above it.
+ * @param dir    Directory, as the walk names it.
+ * @param parent Rules of the directories above.
+ * @param stamp  If not null, receives what the ignore files looked like.
+ * @return The chain that applies inside dir.
+ */
+IgnoreChain load_ignore_rules(const std::string &dir, const IgnoreChain &parent, IgnoreStamp *stamp)
+{
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (stamp)
+            *stamp = {};
+        return parent;
+    }
+    IgnoreChain rules = load_rules_at(fd, prefix_length(dir), "", parent, stamp);
+    close(fd);
+    return rules;
+}
+
+/**
+ * @brief Whether the rules exclude a path.
+ *
+ * The nearest directory's rules are checked first and, within a file, the
+ * last matching pattern decides, as in git.
+ *
+ * @param rules  Chain in force in the path's directory.
+ * @param path   Path as the walk names it.
+ * @param is_dir Whether the path is a directory.
+ */
+bool is_ignored(const IgnoreChain &rules, const std::string &path, bool is_dir)
+{
+    const char *name = path.c_str() + (path.rfind('/') + 1);
+    size_t name_length = path.c_str() + path.size() - name;
+    thread_local std::string scratch;
+    thread_local std::vector<const char *> parts;
+
+    for (const IgnoreRules *node = rules.get(); node; node = node->parent.get())
+    {
+        bool split = false;
+        for (auto it = node->patterns.rbegin(); it != node->patterns.rend(); ++it)
+        {
+            const IgnorePattern &pattern = *it;
+            if (pattern.dir_only && !is_dir)
+                continue;
+            bool hit = false;
+            switch (pattern.kind)
+            {
+            case IgnorePattern::Name:
+                hit = pattern.text.size() == name_length && memcmp(pattern.text.data(), name, name_length) == 0;
+                break;
+            case IgnorePattern::Suffix:
+                hit = pattern.text.size() <= name_length &&
+                      memcmp(pattern.text.data(), name + name_length - pattern.text.size(), pattern.text.size()) == 0;
+                break;
+            case IgnorePattern::NameGlob:
+                hit = wildcard_match(pattern.text.c_str(), name);
+                break;
+            case IgnorePattern::PathGlob:
+                if (!split)
+                {
+                    // The path below this directory, cut into NUL-terminated components.
+                    scratch.assign(node->lead);
+                    scratch.append(path, std::min(node->prefix, path.size()), std::string::npos);
+                    parts.clear();
+                    parts.push_back(scratch.c_str());
+                    for (char &c : scratch)
+                    {
+                        if (c == '/')
+                        {
+                            c = '\0';
+                            parts.push_back(&c + 1);
+                        }
+                    }
+                    split = true;
+                }
+                hit = match_parts(pattern.parts.data(), pattern.parts.size(), parts.data(), parts.size());
+                break;
+            }
+            if (hit)
+                return !pattern.negate;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Starts a walk at root, with the ignore rules of the directories above it.
+ *
+ * As in git, the ignore files of every directory from the top of the
+ * enclosing work tree (the nearest ancestor with a .git) down to root
+ * apply, so a walk started in a subdirectory prunes the same paths as one
+ * started at the top. Outside a work tree nothing above root applies.
+ *
+ * @param root   Directory to walk, as the walk names it.
+ * @param policy Without ignore_files, no rules are loaded.
+ * @param stamp  If not null, receives what the ignore files above root looked like.
+ */
+WalkDir walk_root(const std::string &root, const WalkPolicy &policy, IgnoreStamp *stamp)
+{
+    WalkDir dir{root, nullptr};
+    if (stamp)
+        *stamp = {};
+    char resolved[PATH_MAX];
+    struct stat st;
+    if (!policy.ignore_files || !realpath(root.empty() ? "." : root.c_str(), resolved) ||
+        lstat(join_path(resolved, ".git").c_str(), &st) == 0)
+        return dir;
+
+    std::string here = resolved;
+    std::vector<std::string> above; // Nearest first
+    bool in_tree = false;
+    while (!in_tree && here != "/")
+    {
+        size_t slash = here.rfind('/');
+        here = slash == 0 ? "/" : here.substr(0, slash);
+        above.push_back(here);
+        in_tree = lstat(join_path(here, ".git").c_str(), &st) == 0;
+    }
+    if (!in_tree)
+        return dir;
+
+    uint64_t hash = 1469598103934665603ULL;
+    bool any = false;
+    std::string below = resolved;
+    for (auto it = above.rbegin(); it != above.rend(); ++it)
+    {
+        int fd = open(it->c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        std::string lead = below.substr(prefix_length(*it)) + "/";
+        IgnoreStamp found;
+        dir.rules = load_rules_at(fd, prefix_length(root), lead, dir.rules, &found);
+        close(fd);
+        if (!found.hash)
+            continue;
+        any = true;
+        hash = (hash ^ found.hash) * 1099511628211ULL;
+        if (stamp && (found.newest.tv_sec > stamp->newest.tv_sec ||
+                      (found.newest.tv_sec == stamp->newest.tv_sec && found.newest.tv_nsec > stamp->newest.tv_nsec)))
+            stamp->newest = found.newest;
+    }
+    if (stamp)
+        stamp->hash = any ? hash : 0;
+    return dir;
+}
+
+// -------------------------
+// Directory Listing
+// -------------------------
+
+// Record layout of the getdents64 system call.
+struct WalkDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * @brief Lists a directory with getdents64, applying the policy.
+ *
+ * Types come from d_type; an entry is only stat'ed (relative to the open
+ * directory) when the filesystem does not report its type, or when flags
+ * ask for a directory's mtime or a symlink's target. Symlinks to
+ * directories are never reported as directories, so walks do not follow
+ * them. Entries that vanish while listing are dropped.
+ *
+ * @param dir     Directory and the rules in force above it.
+ * @param policy  What to leave out.
+ * @param flags   WalkListFlags.
+ * @param listing Receives the entries and the rules for dir's subdirectories.
+ * @return false if the directory could not be read (listing.error says why);
+ *         entries read before a failure are kept.
+ */
+bool read_directory(const WalkDir &dir, const WalkPolicy &policy, unsigned flags, DirListing &listing)
+{
+    listing.entries.clear();
+    listing.rules = dir.rules;
+    listing.error = 0;
+    int fd = open(dir.path.empty() ? "." : dir.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        listing.error = errno;
+        return false;
+    }
+    if (policy.ignore_files && !(flags & WALK_KEEP_RULES))
+        listing.rules = load_rules_at(fd, prefix_length(dir.path), "", dir.rules, nullptr);
+
+    std::string path; // Entry path for the ignore rules
+    alignas(WalkDirent64) char buf[32768];
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0)
+    {
+        for (long offset = 0; offset < n;)
+        {
+            auto *raw = reinterpret_cast<WalkDirent64 *>(buf + offset);
+            offset += raw->d_reclen;
+            const char *name = raw->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            if (name[0] == '.' && !policy.hidden)
+                continue;
+            if (policy.ignore_files && strcmp(name, ".git") == 0)
+                continue;
+
+            WalkEntry entry;
+            entry.type = raw->d_type;
+            struct stat st;
+            if (entry.type == DT_UNKNOWN || (entry.type == DT_DIR && (flags & WALK_DIR_MTIMES)))
+            {
+                if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                    continue;
+                entry.type = IFTODT(st.st_mode);
+                if (entry.type == DT_DIR)
+                    entry.mtime = st.st_mtim;
+            }
+            if (entry.type == DT_LNK && (flags & WALK_LINKED_FILES) && fstatat(fd, name, &st, 0) == 0 &&
+                S_ISREG(st.st_mode))
+                entry.type = DT_REG;
+
+            entry.name = name;
+            if (listing.rules)
+            {
+                path = join_path(dir.path, entry.name);
+                if (is_ignored(listing.rules, path, entry.type == DT_DIR))
+                    continue;
+            }
+            listing.entries.push_back(std::move(entry));
+        }
+    }
+    if (n < 0)
+        listing.error = errno;
+    close(fd);
+    return n == 0;
+}
+
+/**
+ * @brief Walks a tree depth first, calling visit for every entry the policy keeps.
+ *
+ * Unreadable directories are reported themselves but not entered, so a
+ * walk of a tree with EACCES holes carries on past them.
+ *
+ * @param root   Directory to walk; entries are named root + "/" + ...
+ * @param policy What to leave out.
+ * @param visit  Called as visit(path, entry).
+ */
+void walk_tree(const std::string &root, const WalkPolicy &policy, const WalkVisitor &visit)
+{
+    std::vector<WalkDir> stack;
+    stack.push_back(walk_root(root, policy, nullptr));
+    DirListing listing;
+    while (!stack.empty())
+    {
+        WalkDir dir = std::move(stack.back());
+        stack.pop_back();
+        read_directory(dir, policy, 0, listing);
+        for (const WalkEntry &entry : listing.entries)
+        {
+            std::string path = join_path(dir.path, entry.name);
+            visit(path, entry);
+            if (entry.type == DT_DIR)
+                stack.push_back({std::move(path), listing.rules});
+        }
+    }
+}
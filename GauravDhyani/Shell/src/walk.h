@@ -0,0 +1,64 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a directory walk leaves out. sgown and locate share one policy so
+// that both prune .git, build output and the like the same way.
+struct WalkPolicy {
+    bool hidden = false;       // Include names starting with '.'
+    bool ignore_files = true;  // Skip .git and whatever .gitignore/.jamignore exclude
+};
+
+// The ignore patterns of one directory, linked to those of the directories
+// above it within the walk.
+struct IgnoreRules;
+using IgnoreChain = std::shared_ptr<const IgnoreRules>;
+
+// Identifies the ignore files a directory had when its rules were loaded.
+struct IgnoreStamp {
+    uint64_t hash = 0;              // 0 when the directory has none
+    struct timespec newest = {};    // Latest mtime among them
+};
+
+// A directory to list, as the walk names it, and the rules in force above it.
+struct WalkDir {
+    std::string path;
+    IgnoreChain rules;
+};
+
+// One entry that passed the policy.
+struct WalkEntry {
+    std::string name;
+    unsigned char type = 0;         // DT_REG, DT_DIR, DT_LNK or another DT_* value
+    struct timespec mtime = {};     // Directories only, with WALK_DIR_MTIMES
+};
+
+// A directory's entries and the rules that apply inside it.
+struct DirListing {
+    std::vector<WalkEntry> entries;
+    IgnoreChain rules;
+    int error = 0;                  // errno if the directory could not be read
+};
+
+enum WalkListFlags : unsigned {
+    WALK_LINKED_FILES = 1, // Report symlinks to regular files as DT_REG
+    WALK_DIR_MTIMES = 2,   // Fill in mtime for directories
+    WALK_KEEP_RULES = 4,   // dir.rules already include the directory's own ignore files
+};
+
+using WalkVisitor = std::function<void(const std::string &path, const WalkEntry &entry)>;
+
+std::string join_path(const std::string &dir, const std::string &name);
+WalkDir walk_root(const std::string &root, const WalkPolicy &policy, IgnoreStamp *stamp);
+IgnoreChain load_ignore_rules(const std::string &dir, const IgnoreChain &parent, IgnoreStamp *stamp);
+bool is_ignored(const IgnoreChain &rules, const std::string &path, bool is_dir);
+bool read_directory(const WalkDir &dir, const WalkPolicy &policy, unsigned flags, DirListing &listing);
+void walk_tree(const std::string &root, const WalkPolicy &policy, const WalkVisitor &visit);
+
+#endif // WALK_H
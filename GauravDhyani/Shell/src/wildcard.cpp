@@ -0,0 +1,607 @@
+#include "wildcard.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define GLOB_MAX_BRACE_WORDS 65536    // Cap on words produced by one brace expression
+#define GLOB_RACY_NS 10000000L        // A listing younger than this past its mtime is re-read
+
+// -------------------------
+// Directory Listings
+// -------------------------
+
+// Record layout of the getdents64 system call.
+struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static bool same_time(const struct timespec &a, const struct timespec &b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+/**
+ * @brief Returns a directory's entries, reading it with getdents64 on a miss.
+ *
+ * A listing already read or checked in the current generation is returned
+ * as is. Otherwise it is reused while the directory's mtime is unchanged. As
+ * in git's index, a listing read within GLOB_RACY_NS of that mtime is not
+ * trusted, since a later change in the same timestamp tick would leave the
+ * mtime as it was.
+ *
+ * @param cache Listings of the current command line.
+ * @param dir   Directory path ("." for the working directory).
+ * @return Listing; `valid` is false if the directory cannot be read.
+ */
+static const GlobListing &list_directory(GlobCache &cache, const std::string &dir)
+{
+    if (dir[0] != '/' && cache.cwd_generation != cache.generation)
+    {
+        char cwd[PATH_MAX];
+        cache.cwd = getcwd(cwd, sizeof(cwd)) ? cwd : "";
+        cache.cwd_generation = cache.generation;
+    }
+    GlobListing &listing = cache.listings[dir[0] == '/' || cache.cwd.empty() ? dir : cache.cwd + "/" + dir];
+    if (listing.checked == cache.generation)
+        return listing;
+    listing.checked = cache.generation;
+
+    struct stat st;
+    if (listing.valid && stat(dir.c_str(), &st) == 0 && same_time(st.st_mtim, listing.mtime))
+    {
+        long long age = (listing.read_at.tv_sec - listing.mtime.tv_sec) * 1000000000LL +
+                        (listing.read_at.tv_nsec - listing.mtime.tv_nsec);
+        if (age >= GLOB_RACY_NS)
+            return listing;
+    }
+
+    listing.valid = false;
+    listing.entries.clear();
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return listing;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return listing;
+    }
+    clock_gettime(CLOCK_REALTIME, &listing.read_at);
+    listing.mtime = st.st_mtim;
+
+    alignas(LinuxDirent64) char buf[32768];
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0)
+    {
+        for (long offset = 0; offset < n;)
+        {
+            auto *entry = reinterpret_cast<LinuxDirent64 *>(buf + offset);
+            offset += entry->d_reclen;
+            const char *name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            listing.entries.push_back({name, entry->d_type});
+        }
+    }
+    close(fd);
+    listing.valid = n == 0;
+    return listing;
+}
+
+/**
+ * @brief Whether an entry is a directory, following symlinks if asked.
+ */
+static bool entry_is_dir(const GlobEntry &entry, const std::string &path, bool follow_links)
+{
+    if (entry.type == DT_DIR)
+        return true;
+    if (entry.type != DT_UNKNOWN && (entry.type != DT_LNK || !follow_links))
+        return false;
+    struct stat st;
+    int rc = follow_links ? stat(path.c_str(), &st) : lstat(path.c_str(), &st);
+    return rc == 0 && S_ISDIR(st.st_mode);
+}
+
+// -------------------------
+// Pattern Matching
+// -------------------------
+
+/**
+ * @brief Matches one character against a bracket expression.
+ *
+ * Supports negation with ! or ^, ranges and the [:class:] names.
+ *
+ * @param p   Points at the '['; advanced past the closing ']' on success.
+ * @param c   Character to test.
+ * @param hit Receives whether c is in the set.
+ * @return false if the expression is unterminated (then '[' is literal).
+ */
+static bool match_bracket(const char *&p, unsigned char c, bool &hit)
+{
+    const char *q = p + 1;
+    bool negate = *q == '!' || *q == '^';
+    if (negate)
+        q++;
+
+    hit = false;
+    bool first = true;
+    for (; *q && (*q != ']' || first); first = false)
+    {
+        if (q[0] == '[' && q[1] == ':')
+        {
+            const char *close = strstr(q + 2, ":]");
+            if (close)
+            {
+                std::string name(q + 2, close);
+                static const struct { const char *name; int (*test)(int); } classes[] = {
+                    {"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum}, {"upper", isupper},
+                    {"lower", islower}, {"space", isspace}, {"punct", ispunct}, {"xdigit", isxdigit},
+                };
+                for (const auto &cls : classes)
+                {
+                    if (name == cls.name && cls.test(c))
+                        hit = true;
+                }
+                q = close + 2;
+                continue;
+            }
+        }
+        unsigned char lo = *q, hi = lo;
+        if (q[1] == '-' && q[2] && q[2] != ']')
+        {
+            hi = q[2];
+            q += 2;
+        }
+        if (c >= lo && c <= hi)
+            hit = true;
+        q++;
+    }
+    if (*q != ']')
+        return false;
+    hit ^= negate;
+    p = q + 1;
+    return true;
+}
+
+/**
+ * @brief Matches a file name against one path component of a pattern.
+ *
+ * A backslash makes the next character literal. Iterative, with
+ * backtracking only to the most recent '*', so the cost is linear in
+ * practice and never exponential.
+ */
+bool wildcard_match(const char *pat, const char *name)
+{
+    const char *star_pat = nullptr, *star_name = nullptr;
+    while (*name)
+    {
+        if (*pat == '*')
+        {
+            star_pat = ++pat;
+            star_name = name;
+            continue;
+        }
+        if (*pat == '\\' && pat[1])
+        {
+            if (pat[1] == *name)
+            {
+                pat += 2;
+                name++;
+                continue;
+            }
+        }
+        else if (*pat == '?')
+        {
+            pat++;
+            name++;
+            continue;
+        }
+        else if (*pat == '[')
+        {
+            const char *next = pat;
+            bool hit;
+            if (match_bracket(next, *name, hit))
+            {
+                if (hit)
+                {
+                    pat = next;
+                    name++;
+                    continue;
+                }
+            }
+            else if (*name == '[')
+            {
+                pat++;
+                name++;
+                continue;
+            }
+        }
+        else if (*pat == *name)
+        {
+            pat++;
+            name++;
+            continue;
+        }
+        if (!star_pat)
+            return false;
+        pat = star_pat;
+        name = ++star_name;
+    }
+    while (*pat == '*')
+        pat++;
+    return *pat == '\0';
+}
+
+/**
+ * @brief Whether a path component contains an unescaped *, ? or terminated [...].
+ */
+static bool component_has_wildcards(std::string_view part)
+{
+    for (size_t i = 0; i < part.size(); ++i)
+    {
+        if (part[i] == '\\')
+            i++;
+        else if (part[i] == '*' || part[i] == '?')
+            return true;
+        else if (part[i] == '[' && part.find(']', i + 2) != std::string_view::npos)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Finds the first occurrence of `c` not escaped by a backslash.
+ */
+static size_t find_unescaped(std::string_view word, char c, size_t from = 0)
+{
+    for (size_t i = from; i < word.size(); ++i)
+    {
+        if (word[i] == '\\')
+            i++;
+        else if (word[i] == c)
+            return i;
+    }
+    return std::string_view::npos;
+}
+
+/**
+ * @brief Removes the backslashes that escape characters of a pattern.
+ */
+static std::string unescape(std::string_view word)
+{
+    std::string text;
+    text.reserve(word.size());
+    for (size_t i = 0; i < word.size(); ++i)
+    {
+        if (word[i] == '\\' && i + 1 < word.size())
+            i++;
+        text.push_back(word[i]);
+    }
+    return text;
+}
+
+// -------------------------
+// Brace Expansion
+// -------------------------
+
+/**
+ * @brief Expands the first brace expression of a word, recursively.
+ *
+ * Handles lists ({a,b,c}, nested) and ranges ({1..10}, {01..10}, {a..e}). Braces
+ * without a top-level comma or range, such as jparallel's {} and {.},
+ * are left as they are, as are escaped braces and commas.
+ */
+static void expand_braces(const std::string &word, std::vector<std::string> &out)
+{
+    for (size_t open = find_unescaped(word, '{'); open != std::string::npos; open = find_unescaped(word, '{', open + 1))
+    {
+        std::vector<size_t> commas;
+        size_t close = std::string::npos;
+        int depth = 0;
+        for (size_t i = open; i < word.size() && close == std::string::npos; ++i)
+        {
+            if (word[i] == '\\')
+                i++;
+            else if (word[i] == '{')
+                depth++;
+            else if (word[i] == '}' && --depth == 0)
+                close = i;
+            else if (word[i] == ',' && depth == 1)
+                commas.push_back(i);
+        }
+        if (close == std::string::npos)
+            return out.push_back(word);
+
+        std::string prefix = word.substr(0, open), suffix = word.substr(close + 1);
+        std::vector<std::string> items;
+        if (!commas.empty())
+        {
+            size_t start = open + 1;
+            commas.push_back(close);
+            for (size_t comma : commas)
+            {
+                items.push_back(word.substr(start, comma - start));
+                start = comma + 1;
+            }
+        }
+        else
+        {
+            std::string body = word.substr(open + 1, close - open - 1);
+            size_t dots = body.find("..");
+            if (dots == std::string::npos || dots == 0 || dots + 2 >= body.size())
+                continue;
+            std::string lo = body.substr(0, dots), hi = body.substr(dots + 2);
+            char *end_lo, *end_hi;
+            long a = strtol(lo.c_str(), &end_lo, 10), b = strtol(hi.c_str(), &end_hi, 10);
+            if (*end_lo == '\0' && *end_hi == '\0')
+            {
+                if (std::labs(b - a) >= GLOB_MAX_BRACE_WORDS)
+                    continue;
+                // A leading zero on either end pads every number to the longer end ({01..10}).
+                auto zero_padded = [](const std::string &n) {
+                    size_t digits = n[0] == '-' || n[0] == '+' ? 1 : 0;
+                    return n.size() > digits + 1 && n[digits] == '0';
+                };
+                int width = zero_padded(lo) || zero_padded(hi) ? static_cast<int>(std::max(lo.size(), hi.size())) : 0;
+                for (long v = a;; v += a <= b ? 1 : -1)
+                {
+                    char number[32];
+                    snprintf(number, sizeof(number), "%0*ld", width, v);
+                    items.push_back(number);
+                    if (v == b)
+                        break;
+                }
+            }
+            else if (lo.size() == 1 && hi.size() == 1 && isalpha(static_cast<unsigned char>(lo[0])) &&
+                     isalpha(static_cast<unsigned char>(hi[0])))
+            {
+                for (char c = lo[0];; c += lo[0] <= hi[0] ? 1 : -1)
+                {
+                    items.push_back(std::string(1, c));
+                    if (c == hi[0])
+                        break;
+                }
+            }
+            else
+            {
+                continue;
+            }
+        }
+
+        for (const auto &item : items)
+        {
+            if (out.size() >= GLOB_MAX_BRACE_WORDS)
+                break;
+            expand_braces(prefix + item + suffix, out);
+        }
+        return;
+    }
+    out.push_back(word);
+}
+
+// -------------------------
+// Path Expansion
+// -------------------------
+
+/**
+ * @brief Adds every file and directory below `prefix` (for a final "**").
+ *
+ * Symlinks to directories are never descended into; they are listed as
+ * directories only if `list_links` is set.
+ */
+static void collect_tree(GlobCache &cache, const std::string &prefix, bool dir_only, bool list_links,
+                         std::vector<std::string> &out)
+{
+    // Map elements stay put when the cache rehashes, so the listing can be
+    // walked while subdirectories are added.
+    const GlobListing &listing = list_directory(cache, prefix.empty() ? "." : prefix);
+    for (const auto &entry : listing.entries)
+    {
+        if (entry.name[0] == '.')
+            continue;
+        std::string path = prefix + entry.name;
+        bool is_dir = entry_is_dir(entry, path, false);
+        if (!dir_only || is_dir || (list_links && entry.type == DT_LNK && entry_is_dir(entry, path, true)))
+            out.push_back(dir_only ? path + "/" : path);
+        if (is_dir)
+            collect_tree(cache, path + "/", dir_only, list_links, out);
+    }
+}
+
+/**
+ * @brief Matches the path components from `index` on below `prefix`.
+ *
+ * @param parts    Pattern split at '/'.
+ * @param index    Component to match next.
+ * @param prefix   Path matched so far, ending in '/' (or empty).
+ * @param dir_only The pattern ended in '/'.
+ * @param cache    Directory listings.
+ * @param out      Receives matching paths.
+ */
+static void match_path(const std::vector<std::string> &parts, size_t index, const std::string &prefix,
+                       bool dir_only, GlobCache &cache, std::vector<std::string> &out)
+{
+    const std::string &part = parts[index];
+    bool last = index + 1 == parts.size();
+
+    if (part == "**")
+    {
+        if (last)
+        {
+            // As in bash, a trailing "**" also matches the directory it starts from.
+            struct stat st;
+            if (!prefix.empty() && stat(prefix.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+                out.push_back(prefix);
+            return collect_tree(cache, prefix, dir_only, true, out);
+        }
+        match_path(parts, index + 1, prefix, dir_only, cache, out);
+        std::vector<std::string> dirs;
+        collect_tree(cache, prefix, true, false, dirs);
+        for (const auto &dir : dirs)
+            match_path(parts, index + 1, dir, dir_only, cache, out);
+        return;
+    }
+
+    if (!component_has_wildcards(part))
+    {
+        std::string path = prefix + unescape(part);
+        if (!last)
+            return match_path(parts, index + 1, path + "/", dir_only, cache, out);
+        struct stat st;
+        bool exists = dir_only ? stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode) : lstat(path.c_str(), &st) == 0;
+        if (exists)
+            out.push_back(dir_only ? path + "/" : path);
+        return;
+    }
+
+    const GlobListing &listing = list_directory(cache, prefix.empty() ? "." : prefix);
+    std::vector<std::string> subdirs;
+    for (const auto &entry : listing.entries)
+    {
+        if (entry.name[0] == '.' && part[0] != '.')
+            continue;
+        if (!wildcard_match(part.c_str(), entry.name.c_str()))
+            continue;
+        std::string path = prefix + entry.name;
+        if (last && !dir_only)
+            out.push_back(path);
+        else if (entry_is_dir(entry, path, true))
+            (last ? out : subdirs).push_back(path + "/");
+    }
+    for (const auto &dir : subdirs)
+        match_path(parts, index + 1, dir, dir_only, cache, out);
+}
+
+// -------------------------
+// Public Interface
+// -------------------------
+
+/**
+ * @brief Whether a word would change under expand_glob().
+ */
+bool has_wildcards(std::string_view word)
+{
+    if (component_has_wildcards(word))
+        return true;
+    size_t open = find_unescaped(word, '{');
+    return open != std::string_view::npos && find_unescaped(word, '}', open) != std::string_view::npos &&
+           (find_unescaped(word, ',', open) != std::string_view::npos ||
+            word.find("..", open) != std::string_view::npos);
+}
+
+/**
+ * @brief Expands braces and then *, ?, [...] and ** in one word.
+ *
+ * Each brace alternative is matched separately and its matches are sorted
+ * by the user's collation, as in other shells; an alternative without
+ * matches is kept literally. Hidden entries only match a component that
+ * starts with '.', and "." and ".." never match. "**" matches any number
+ * of directories, without following symlinks. A backslash makes the next
+ * character literal; it is removed from words kept as they are.
+ *
+ * @param pattern Word to expand.
+ * @param cache   Directory listings, shared across the command line.
+ * @param out     Receives the resulting words.
+ * @return Number of paths found on disk.
+ */
+size_t expand_glob(std::string_view pattern, GlobCache &cache, std::vector<std::string> &out)
+{
+    std::vector<std::string> alternatives;
+    expand_braces(std::string(pattern), alternatives);
+
+    size_t found = 0;
+    for (const auto &word : alternatives)
+    {
+        if (!component_has_wildcards(word))
+        {
+            out.push_back(unescape(word));
+            continue;
+        }
+
+        std::vector<std::string> parts;
+        std::string prefix = word[0] == '/' ? "/" : "";
+        bool dir_only = word.back() == '/';
+        for (size_t start = 0; start < word.size();)
+        {
+            size_t slash = word.find('/', start);
+            if (slash == std::string::npos)
+                slash = word.size();
+            if (slash > start)
+                parts.push_back(word.substr(start, slash - start));
+            start = slash + 1;
+        }
+
+        std::vector<std::string> matches;
+        match_path(parts, 0, prefix, dir_only, cache, matches);
+        std::sort(matches.begin(), matches.end(),
+                  [](const std::string &a, const std::string &b) { return strcoll(a.c_str(), b.c_str()) < 0; });
+        matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+        if (matches.empty())
+        {
+            out.push_back(unescape(word));
+            continue;
+        }
+        found += matches.size();
+        out.insert(out.end(), std::make_move_iterator(matches.begin()), std::make_move_iterator(matches.end()));
+    }
+    return found;
+}
+
+/**
+ * @brief Expands the wildcard words of one command.
+ *
+ * Only words the tokenizer flagged TOKEN_GLOB (an unquoted *, ?, [ or {)
+ * are expanded, through their escaped `pattern` if parts of them were
+ * quoted. A redirection target is expanded only if it yields a single word.
+ *
+ * @param tokens Command tokens.
+ * @param count  Number of tokens.
+ * @param cache  Directory listings of the current line.
+ * @param out    Receives the expanded tokens; they point into out.words
+ *               or into the original tokens.
+ */
+void expand_wildcards(const ShellToken *tokens, size_t count, GlobCache &cache, ExpandedCommand &out)
+{
+    out.tokens.clear();
+    out.words.clear();
+
+    // Words are stored first and the tokens built afterwards, since the
+    // vector may reallocate (moving short strings) while it grows.
+    std::vector<std::pair<size_t, size_t>> spans(count, {SIZE_MAX, 0}); // (first word, word count)
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned flags = tokens[i].flags;
+        std::string_view pattern = tokens[i].pattern.empty() ? tokens[i].text : tokens[i].pattern;
+        if (!(flags & TOKEN_GLOB) || (flags & TOKEN_OPERATOR) || !has_wildcards(pattern))
+            continue;
+        size_t first = out.words.size();
+        expand_glob(pattern, cache, out.words);
+        bool redirect_target = i > 0 && (tokens[i - 1].flags & TOKEN_OPERATOR) && tokens[i - 1].text[0] != '|';
+        if (redirect_target && out.words.size() - first != 1)
+            out.words.resize(first);
+        else
+            spans[i] = {first, out.words.size() - first};
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (spans[i].first == SIZE_MAX)
+        {
+            out.tokens.push_back(tokens[i]);
+            continue;
+        }
+        for (size_t w = spans[i].first; w < spans[i].first + spans[i].second; ++w)
+            out.tokens.push_back({out.words[w], (tokens[i].flags & ~TOKEN_GLOB) | TOKEN_EXPANDED});
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef WILDCARD_H
+#define WILDCARD_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <ctime>
+#include "tokenizer.h"
+
+// One directory entry as returned by getdents64.
+struct GlobEntry {
+    std::string name;
+    unsigned char type; // DT_* value; DT_UNKNOWN on filesystems without d_type
+};
+
+// A directory listing and the mtime it was read at.
+struct GlobListing {
+    struct timespec mtime = {};
+    struct timespec read_at = {};
+    bool valid = false; // false if the directory could not be opened
+    unsigned long checked = 0; // GlobCache::generation the mtime was last checked in
+    std::vector<GlobEntry> entries;
+};
+
+// Directory listings shared by every pattern of one command line, keyed by
+// absolute directory path, so a `cd` earlier on the line is seen. A listing
+// is reused while the directory's mtime is unchanged, so commands earlier on
+// the line that create files are seen too. The caller bumps `generation`
+// after running each command; within one generation a listing is reused
+// without checking the mtime again.
+struct GlobCache {
+    std::unordered_map<std::string, GlobListing> listings;
+    unsigned long generation = 1;
+    std::string cwd;                 // Working directory as of cwd_generation
+    unsigned long cwd_generation = 0;
+};
+
+// Tokens of one command after wildcard expansion and the storage for the
+// words that expansion produced.
+struct ExpandedCommand {
+    std::vector<ShellToken> tokens;
+    std::vector<std::string> words;
+};
+
+bool has_wildcards(std::string_view word);
+bool wildcard_match(const char *pat, const char *name);
+size_t expand_glob(std::string_view pattern, GlobCache &cache, std::vector<std::string> &out);
+void expand_wildcards(const ShellToken *tokens, size_t count, GlobCache &cache, ExpandedCommand &out);
+
+#endif // WILDCARD_H